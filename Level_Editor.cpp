@@ -1,696 +1,8415 @@
-// ============================================================================
-// 2D Level Editor (Implementation)
-// Programmed by Francois Lamini
-// ============================================================================
-
-#include "Level_Editor.h"
-
-Codeloader::cLevel_Editor* editor = NULL;
-
-bool On_Process();
-bool On_Key_Process();
-Codeloader::cArray<std::string> Get_Backgrounds(Codeloader::cAllegro_IO* allegro, int width, int height);
-Codeloader::cArray<std::string> Get_Music_Tracks(Codeloader::cAllegro_IO* allegro);
-
-// ****************************************************************************
-// Program Entry Point
-// ****************************************************************************
-
-int main(int argc, char** argv) {
-  try {
-    Codeloader::cArray<std::string> param_names;
-    param_names.Add("level");
-    Codeloader::cParameters params(argc, argv, param_names);
-    Codeloader::cConfig config("Config");
-    int width = config.Get_Property("width");
-    int height = config.Get_Property("height");
-    Codeloader::cAllegro_IO allegro("Level Editor :: " + params["level"].string, width, height + 32, 2, "Game"); // Add space for HUD.
-    allegro.Set_FPS(60); // Set frame rate!
-    allegro.Load_Resources_From_Files();
-    Codeloader::cArray<std::string> backgrounds = Get_Backgrounds(&allegro, width, height);
-    Codeloader::cArray<std::string> music_tracks = Get_Music_Tracks(&allegro);
-    editor = new Codeloader::cLevel_Editor(params["level"].string, config, &allegro, backgrounds, music_tracks);
-    allegro.Process_Messages(On_Process, On_Key_Process);
-    delete editor;
-  }
-  catch (Codeloader::cError error) {
-    error.Print();
-  }
-  return 0;
-}
-
-/**
- * Processes the level editor loop. 
- */
-bool On_Process() {
-  editor->Process();
-  return false;
-}
-
-/**
- * Processes a key to quit the editor. 
- */
-bool On_Key_Process() {
-  return false;
-}
-
-// ****************************************************************************
-// Utility Routines
-// ****************************************************************************
-
-/**
- * Gets the list of backgrounds from the resources loaded.
- * @param allegro The Allegro I/O control.
- * @param width The width of the screen.
- * @param height The height of the screen.
- * @return The list of backgrounds.
- */
-Codeloader::cArray<std::string> Get_Backgrounds(Codeloader::cAllegro_IO* allegro, int width, int height) {
-  int image_count = allegro->images.Count(); 
-  Codeloader::cArray<std::string> backgrounds;
-  for (int image_index = 0; image_index < image_count; image_index++) {
-    std::string image = allegro->images.keys[image_index];
-    if (image.find("_Bkg") == (image.length() - 4)) {
-      int bkg_width = allegro->Get_Image_Width(image);
-      int bkg_height = allegro->Get_Image_Height(image);
-      Codeloader::Check_Condition((bkg_width == width), "Background " + image + " is not the width of the screen.");
-      Codeloader::Check_Condition((bkg_height == height), "Background " + image + " is not the height of the screen.");
-      std::string background = image.substr(0, image.length() - 4);
-      backgrounds.Add(background);
-    }
-  }
-  return backgrounds;
-}
-
-/**
- * Gets the list of music track from the resources loaded.
- * @param allegro The Allegro I/O control.
- * @return The list of music tracks. 
- */
-Codeloader::cArray<std::string> Get_Music_Tracks(Codeloader::cAllegro_IO* allegro) {
-  Codeloader::cArray<std::string> music_tracks;
-  int track_count = allegro->tracks.Count();
-  for (int track_index = 0; track_index < track_count; track_index++) {
-    music_tracks.Add(allegro->tracks.keys[track_index]);
-  }
-  return music_tracks;
-}
-
-// ****************************************************************************
-// 2D Level Editor
-// ****************************************************************************
-
-namespace Codeloader {
-
-  /**
-   * Creates a new level editor.
-   * @param name The name of the level to load.
-   * @param config The config parser.
-   * @param io The I/O control.
-   * @param backgrounds The list of backgrounds provided to the editor.
-   * @param music_tracks The list of music tracks provided to the editor.
-   * @throws An error if the sprite palette could not be loaded.
-   */
-  cLevel_Editor::cLevel_Editor(std::string name, cConfig& config, cIO_Control* io, cArray<std::string> backgrounds, cArray<std::string> music_tracks) {
-    this->io = io;
-    this->level_name = name;
-    this->sel_sprite = NO_VALUE_FOUND;
-    this->sel_level = NO_VALUE_FOUND;
-    this->scroll_x = 0;
-    this->scroll_y = 0;
-    this->timer = 0;
-    this->backgrounds = backgrounds;
-    Check_Condition((this->backgrounds.Count() > 0), "No backgrounds loaded!");
-    this->background = this->backgrounds[0];
-    this->music_tracks = music_tracks;
-    Check_Condition((this->music_tracks.Count() > 0), "No music tracks defined.");
-    this->music_track = this->music_tracks[0];
-    cArray<std::string> layers = Parse_Sausage_Text(config.Get_Text_Property("layers"), ",");
-    int layer_count = layers.Count();
-    Check_Condition((layer_count > 0), "No layers defined!");
-    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
-      std::string layer = layers[layer_index];
-      this->layers[layer] = tObject_List();
-    }
-    this->sel_layer = layers[0]; // Set to lowest layer.
-    std::string palette = config.Get_Text_Property("palette");
-    this->Load_Sprite_Palette(palette);
-    this->Load_Level(name);
-  }
-
-  /**
-   * Frees the level editor. Any maintenance is done here. 
-   */
-  cLevel_Editor::~cLevel_Editor() {
-    this->Save_Level(this->level_name);
-  }
-
-  /**
-   * Loads the sprite palette.
-   * @param name The name of the sprite palette.
-   */
-  void cLevel_Editor::Load_Sprite_Palette(std::string name) {
-    cFile palette_file(name + ".txt");
-    palette_file.Read();
-    while (palette_file.Has_More_Lines()) {
-      std::string sprite_name = palette_file.Get_Line();
-      tObject sprite;
-      palette_file >>= sprite;
-      this->Destar_Sprite(sprite); // Important because properties can be starred from object catalog.
-      Check_Condition(sprite.Does_Key_Exist("name"), "No sprite name present.");
-      Check_Condition(sprite.Does_Key_Exist("layer"), "No layer present.");
-      Check_Condition(sprite.Does_Key_Exist("x"), "No x coordinate.");
-      Check_Condition(sprite.Does_Key_Exist("y"), "No y coordinate.");
-      Check_Condition(sprite.Does_Key_Exist("size-x"), "No size x specifier.");
-      Check_Condition(sprite.Does_Key_Exist("size-y"), "No size y specifier.");
-      Check_Condition(sprite.Does_Key_Exist("icon"), "No icon present.");
-      this->sprite_palette[sprite_name] = sprite;
-    }
-    Check_Condition((this->sprite_palette.Count() > 0), "No sprites in palette!");
-    this->sel_sprite_type = this->sprite_palette.keys[0];
-  }
-
-  /**
-   * Loads a level.
-   * @param name The name of the level.
-   */
-  void cLevel_Editor::Load_Level(std::string name) {
-    cFile level_file(name + ".map");
-    try {
-      level_file.Read();
-      tObject meta_data;
-      level_file >>= meta_data;
-      Check_Condition(meta_data.Does_Key_Exist("background"), "No background property.");
-      this->background = meta_data["background"].string;
-      Check_Condition(meta_data.Does_Key_Exist("music-track"), "No music track property.");
-      this->music_track = meta_data["music-track"].string;
-      while (level_file.Has_More_Lines()) {
-        tObject sprite;
-        level_file >>= sprite;
-        Check_Condition(sprite.Does_Key_Exist("name"), "No sprite name present.");
-        Check_Condition(sprite.Does_Key_Exist("layer"), "No layer present.");
-        Check_Condition(sprite.Does_Key_Exist("x"), "No x coordinate.");
-        Check_Condition(sprite.Does_Key_Exist("y"), "No y coordinate.");
-        Check_Condition(sprite.Does_Key_Exist("size-x"), "No size x specifier.");
-        Check_Condition(sprite.Does_Key_Exist("size-y"), "No size y specifier.");
-        Check_Condition(sprite.Does_Key_Exist("icon"), "No icon present.");
-        std::string layer = sprite["layer"].string;
-        Check_Condition(this->layers.Does_Key_Exist(layer), "Layer " + layer + " does not exist in layers.");
-        this->layers[layer].Add(sprite);
-      }
-    }
-    catch (cError error) {
-      error.Print();
-    }
-  }
-
-  /**
-   * Saves a level to a file.
-   * @param name The name of the level.
-   */
-  void cLevel_Editor::Save_Level(std::string name) {
-    cFile level_file(name + ".map");
-    tObject meta_data;
-    meta_data["background"].Set_String(this->background);
-    meta_data["music-track"].Set_String(this->music_track);
-    level_file.Add(meta_data);
-    int layer_count = this->layers.Count();
-    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
-      std::string layer = this->layers.keys[layer_index];
-      int sprite_count = this->layers[layer].Count();
-      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
-        tObject& sprite = this->layers[layer][sprite_index];
-        level_file.Add(sprite);
-      }
-    }
-    level_file.Write();
-  }
-
-  /**
-   * Handles the key processing in the editor. 
-   */
-  void cLevel_Editor::Process_Keys() {
-    if (this->timer == 0) {
-      sSignal key = this->io->Read_Key();
-      if (this->sel_sprite == NO_VALUE_FOUND) {
-        if (key.code == eSIGNAL_LEFT) {
-          this->scroll_x -= 20;
-          this->Set_Timer(); // Pause keyboard.
-        }
-        else if (key.code == eSIGNAL_RIGHT) {
-          this->scroll_x += 20;
-          this->Set_Timer();
-        }
-        if (key.code == eSIGNAL_UP) {
-          this->scroll_y -= 20;
-          this->Set_Timer();
-        }
-        else if (key.code == eSIGNAL_DOWN) {
-          this->scroll_y += 20;
-          this->Set_Timer();
-        }
-        // Select layer.
-        if (key.code == 'z') {
-          this->Select_Layer(-1);
-          this->Set_Timer();
-        }
-        else if (key.code == 'x') {
-          this->Select_Layer(1);
-          this->Set_Timer();
-        }
-        // Select sprite type.
-        if (key.code == 'c') {
-          this->Select_Sprite_Type(-1);
-          this->Set_Timer();
-        }
-        else if (key.code == 'v') {
-          this->Select_Sprite_Type(1);
-          this->Set_Timer();
-        }
-        // Select background.
-        if (key.code == 'b') {
-          this->Select_Background(-1);
-          this->Set_Timer();
-        }
-        else if (key.code == 'n') {
-          this->Select_Background(1);
-          this->Set_Timer();
-        }
-        // Select music track.
-        if (key.code == 'm') {
-          this->Select_Music_Track(-1);
-          this->io->Silence();
-          this->Set_Timer();
-        }
-        else if (key.code == ',') {
-          this->Select_Music_Track(1);
-          this->io->Silence();
-          this->Set_Timer();
-        }
-        // Play/stop music track.
-        if (key.code == 'p') {
-          this->io->Play_Music(this->music_track);
-        }
-        else if (key.code == 's') {
-          this->io->Silence();
-        }
-      }
-      else { // Sprite is selected.
-        tObject& sprite = this->layers[this->sel_layer][this->sel_sprite];
-        // Nudge sprite.
-        if (key.code == eSIGNAL_LEFT) {
-          sprite["x"].number--;
-          this->Set_Timer();
-        }
-        else if (key.code == eSIGNAL_RIGHT) {
-          sprite["x"].number++;
-          this->Set_Timer();
-        }
-        if (key.code == eSIGNAL_UP) {
-          sprite["y"].number--;
-          this->Set_Timer();
-        }
-        else if (key.code == eSIGNAL_DOWN) {
-          sprite["y"].number++;
-          this->Set_Timer();
-        }
-        // Sizing of sprite.
-        if (key.code == 'i') {
-          if (sprite["size-y"].number > 1) {
-            sprite["size-y"].number--;
-          }
-          this->Set_Timer();
-        }
-        else if (key.code == 'j') {
-          if (sprite["size-x"].number > 1) {
-            sprite["size-x"].number--;
-          }
-          this->Set_Timer();
-        }
-        else if (key.code == 'm') {
-          sprite["size-y"].number++;
-          this->Set_Timer();
-        }
-        else if (key.code == 'l') {
-          sprite["size-x"].number++;
-          this->Set_Timer();
-        }
-        // Deleting of sprite.
-        if (key.code == eSIGNAL_DELETE) {
-          this->layers[this->sel_layer].Remove(this->sel_sprite);
-          this->sel_sprite = NO_VALUE_FOUND;
-        }
-        // Choosing sprite pointer level.
-        if (sprite.Does_Key_Exist("pointer-level")) {
-          cArray<std::string> level_list = this->Get_Level_List();
-          int level_count = level_list.Count();
-          int limit = level_count - 1;
-          if (key.code == 'z') {
-            this->sel_level--;
-            if (this->sel_level < 0) {
-              this->sel_level = limit;
-            }
-            sprite["pointer-level"].Set_String(level_list[this->sel_level]);
-          }
-          else if (key.code == 'x') {
-            this->sel_level++;
-            if (this->sel_level > limit) {
-              this->sel_level = 0;
-            }
-            sprite["pointer-level"].Set_String(level_list[this->sel_level]);
-          }
-        }
-      }
-    }
-  }
-
-  /**
-   * Processes the mouse for the editor. 
-   */
-  void cLevel_Editor::Process_Mouse() {
-    sSignal mouse = this->io->Read_Signal();
-    if (mouse.code == eSIGNAL_MOUSE) {
-      if (mouse.button == eBUTTON_LEFT) {
-        if (this->sel_sprite == NO_VALUE_FOUND) { // No sprite selected?
-          this->sel_sprite = Select_Sprite(mouse.coords);
-          if (this->sel_sprite == NO_VALUE_FOUND) {
-            this->sel_sprite = this->Create_Sprite(mouse.coords); // Create a new sprite.
-          }
-          if (this->sel_sprite != NO_VALUE_FOUND) {
-            tObject& sprite = this->layers[this->sel_layer][this->sel_sprite];
-            if (sprite.Does_Key_Exist("pointer-level")) {
-              this->sel_level = this->Find_Selected_Level_Index(sprite["pointer-level"].string);
-              if (this->sel_level == NO_VALUE_FOUND) {
-                this->sel_level = 0;
-                sprite["pointer-level"].Set_String("None");
-              }
-            }
-            else {
-              this->sel_level = NO_VALUE_FOUND;
-            }
-          }
-        }
-      }
-      else if (mouse.button == eBUTTON_RIGHT) {
-        this->sel_sprite = NO_VALUE_FOUND;
-      }
-      else { // No button pressed.
-        if (this->sel_sprite != NO_VALUE_FOUND) {
-          tObject& sprite = this->layers[this->sel_layer][this->sel_sprite];
-          sprite["x"].Set_Number(mouse.coords.x + this->scroll_x);
-          sprite["y"].Set_Number(mouse.coords.y + this->scroll_y);
-        }
-      }
-    }
-  }
-
-  /**
-   * Sets the timer for the keyboard. 
-   */
-  void cLevel_Editor::Set_Timer() {
-    this->timer = 60 / 5;
-  }
-
-  /**
-   * Selects a layer given a direction.
-   * @param direction The direction to select the layer from. 
-   */
-  void cLevel_Editor::Select_Layer(int direction) {
-    int layer_count = this->layers.Count();
-    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
-      std::string layer = this->layers.keys[layer_index];
-      if (this->sel_layer == layer) {
-        int next_layer = layer_index + direction;
-        if (next_layer < 0) {
-          next_layer = layer_count - 1;
-        }
-        if (next_layer == layer_count) {
-          next_layer = 0;
-        }
-        this->sel_layer = this->layers.keys[next_layer];
-        break;
-      }
-    }
-  }
-
-  /**
-   * Determines if a sprite was select and which one was.
-   * @param coords The coordinates of the mouse.
-   * @return The index of the sprite selected or NO_VALUE_FOUND. 
-   */
-  int cLevel_Editor::Select_Sprite(sPoint coords) {
-    int sel_sprite = NO_VALUE_FOUND;
-    int sprite_count = this->layers[this->sel_layer].Count();
-    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
-      tObject& sprite = this->layers[this->sel_layer][sprite_index];
-      if (sprite["layer"].string == this->sel_layer) { // Make sure the sprite is in the correct layer.
-        sRectangle bump_map;
-        bump_map.left = sprite["x"].number - this->scroll_x;
-        bump_map.top = sprite["y"].number - this->scroll_y;
-        bump_map.right = bump_map.left + this->io->Get_Image_Width(sprite["icon"].string) - 1 - this->scroll_x;
-        bump_map.bottom = bump_map.top + this->io->Get_Image_Height(sprite["icon"].string) - 1 - this->scroll_y;
-        if (Is_Point_In_Box(coords, bump_map)) {
-          sel_sprite = sprite_index;
-          break;
-        }
-      }
-    }
-    return sel_sprite;
-  }
-
-  /**
-   * Creates a new sprite.
-   * @param coords The mouse coordinates where to lay down the sprite.
-   * @return The index of the new sprite.
-   */
-  int cLevel_Editor::Create_Sprite(sPoint coords) {
-    int sel_sprite = NO_VALUE_FOUND;
-    tObject& sprite = this->sprite_palette[this->sel_sprite_type];
-    if (sprite["layer"].string == this->sel_layer) {
-      sprite["x"].Set_Number(this->scroll_x + coords.x);
-      sprite["y"].Set_Number(this->scroll_y + coords.y);
-      this->layers[this->sel_layer].Add(sprite);
-      sel_sprite = this->layers[this->sel_layer].Count() - 1;
-    }
-    return sel_sprite;
-  }
-
-  /**
-   * Selects a sprite type.
-   * @param direction The direction to select the sprite in. 
-   */
-  void cLevel_Editor::Select_Sprite_Type(int direction) {
-    int sprite_count = this->sprite_palette.Count();
-    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
-      std::string sprite = this->sprite_palette.keys[sprite_index];
-      if (this->sel_sprite_type == sprite) {
-        int next_sprite = sprite_index + direction;
-        if (next_sprite < 0) {
-          next_sprite = sprite_count - 1;
-        }
-        if (next_sprite == sprite_count) {
-          next_sprite = 0;
-        }
-        this->sel_sprite_type = this->sprite_palette.keys[next_sprite];
-        break;
-      }
-    }
-  }
-
-  /**
-   * Selects a background.
-   * @param direction The direction to select the background in. 
-   */
-  void cLevel_Editor::Select_Background(int direction) {
-    int background_count = this->backgrounds.Count();
-    for (int background_index = 0; background_index < background_count; background_index++) {
-      std::string background = this->backgrounds[background_index];
-      if (this->background == background) {
-        int next_background = background_index + direction;
-        if (next_background < 0) {
-          next_background = background_count - 1;
-        }
-        if (next_background == background_count) {
-          next_background = 0;
-        }
-        this->background = this->backgrounds[next_background];
-        break;
-      }
-    }
-  }
-
-  /**
-   * Selects a music track.
-   * @param direction The direction to select the music track in. 
-   */
-  void cLevel_Editor::Select_Music_Track(int direction) {
-    int track_count = this->music_tracks.Count();
-    for (int track_index = 0; track_index < track_count; track_index++) {
-      std::string music_track = this->music_tracks[track_index];
-      if (this->music_track == music_track) {
-        int next_track = track_index + direction;
-        if (next_track < 0) {
-          next_track = track_count - 1;
-        }
-        if (next_track == track_count) {
-          next_track = 0;
-        }
-        this->music_track = this->music_tracks[next_track];
-        break;
-      }
-    }
-  }
-
-  /**
-   * Renders the level.
-   */
-  void cLevel_Editor::Render() {
-    // Color background white.
-    this->io->Color(255, 255, 255);
-    // Draw the background.
-    int bkg_width = this->io->Get_Image_Width(this->background + "_Bkg");
-    int bkg_height = this->io->Get_Image_Height(this->background + "_Bkg");
-    this->io->Draw_Image(this->background + "_Bkg", 0, 0, bkg_width, bkg_height, 0, false, false);
-    // Draw the sprites.
-    int layer_count = this->layers.Count();
-    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
-      std::string layer = this->layers.keys[layer_index];
-      int sprite_count = this->layers[layer].Count();
-      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
-        tObject& sprite = this->layers[layer][sprite_index];
-        int x = sprite["x"].number;
-        int y = sprite["y"].number;
-        int size_x = sprite["size-x"].number;
-        int size_y = sprite["size-y"].number;
-        int sprite_width = this->io->Get_Image_Width(sprite["icon"].string);
-        int sprite_height = this->io->Get_Image_Height(sprite["icon"].string);
-        for (int sprite_y = 0; sprite_y < size_y; sprite_y++) {
-          for (int sprite_x = 0; sprite_x < size_x; sprite_x++) {
-            this->io->Draw_Image(sprite["icon"].string, x + (sprite_x * sprite_width) - this->scroll_x, y + (sprite_y * sprite_height) - this->scroll_y, sprite_width, sprite_height, 0, false, false);
-          }
-        }
-      }
-      // Render level console.
-      this->io->Box(0, bkg_height, bkg_width, 32, 255, 255, 255); // Render white box.
-      tObject& sprite_entry = this->sprite_palette[this->sel_sprite_type];
-      this->io->Draw_Image(sprite_entry["icon"].string, 5, bkg_height + 5, 20, 20, 0, false, false);
-      this->io->Output_Text(sprite_entry["layer"].string, 30, bkg_height + 3, 0, 0, 0); // Output the name of the layer that the sprite is on.
-      int text_width = this->io->Get_Text_Width("Layer: " + this->sel_layer);
-      int text_height = this->io->Get_Text_Height("Layer: " + this->sel_layer);
-      this->io->Output_Text("Layer: " + this->sel_layer, bkg_width - 5 - text_width, bkg_height + 3, 0, 0, 0);
-      if (this->sel_sprite != NO_VALUE_FOUND) {
-        tObject& sprite = this->layers[this->sel_layer][this->sel_sprite];
-        if (sprite.Does_Key_Exist("pointer-level")) {
-          int x = sprite["x"].number;
-          int y = sprite["y"].number;
-          this->io->Output_Text("Points to: " + sprite["pointer-level"].string, x - this->scroll_x, y - text_height - this->scroll_y, 0, 255, 0);
-        }
-      }
-      // Render debug log.
-      while (this->debug_log.Count() > 0) {
-        sDebug_Entry debug_entry = this->debug_log.Shift();
-        int text_height = this->io->Get_Text_Height(debug_entry.text);
-        this->io->Output_Text(debug_entry.text, debug_entry.x * text_height, debug_entry.y * text_height, 0, 0, 0);
-      }
-    }
-  }
-
-  /**
-   * Processes the level editor. 
-   */
-  void cLevel_Editor::Process() {
-    if (this->timer > 0) {
-      this->timer--;
-    }
-    this->Process_Keys();
-    this->Process_Mouse();
-    this->Render();
-    this->io->Refresh();
-  }
-
-  /**
-   * Destars starred sprite properties.
-   * @param sprite The sprite properties to destar.
-   */
-  void cLevel_Editor::Destar_Sprite(tObject& sprite) {
-    int prop_count = sprite.Count();
-    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
-      Check_Condition((sprite.keys[prop_index].length() > 0), "Key is NULL.");
-      if (sprite.keys[prop_index][0] == '*') {
-        sprite.keys[prop_index] = sprite.keys[prop_index].substr(1); // Destar the key.
-      }
-    }
-  }
-
-  /**
-   * Prints an object.
-   * @param object The object to print. 
-   */
-  void cLevel_Editor::Print_Object(tObject& object) {
-    int prop_count = object.Count();
-    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
-      std::string property = object.keys[prop_index];
-      cValue& value = object[property];
-      if (value.type == eVALUE_NUMBER) {
-        std::cout << property << "=" << Number_To_Text(value.number) << std::endl;
-      }
-      else if (value.type == eVALUE_STRING) {
-        std::cout << property << "=" << value.string << std::endl;
-      }
-    }
-  }
-
-  /**
-   * Prints a debug statement on the screen.
-   * @param text The text to print.
-   * @param x The x coordinate. (Coordinates are in text coordinates.)
-   * @param y The y coordinate.
-   */
-  void cLevel_Editor::Debug(std::string text, int x, int y) {
-    sDebug_Entry debug_entry;
-    debug_entry.text = text;
-    debug_entry.x = x;
-    debug_entry.y = y;
-    this->debug_log.Add(debug_entry);
-  }
-
-  /**
-   * Gets the list of levels.
-   * @return The list of levels without the extension.
-   */
-  cArray<std::string> cLevel_Editor::Get_Level_List() {
-    cArray<std::string> level_list;
-    cArray<std::string> files = this->io->Get_File_List(this->io->Get_Current_Folder());
-    int file_count = files.Count();
-    level_list.Add("None"); // Add no level option.
-    for (int file_index = 0; file_index < file_count; file_index++) {
-      std::string file = files[file_index];
-      std::string ext = this->io->Get_File_Extension(file);
-      if (ext == "map") {
-        std::string level = this->io->Get_File_Title(file);
-        level_list.Add(level);
-      }
-    }
-    return level_list;
-  }
-
-  /**
-   * Finds the selected level index given the name.
-   * @param name The name of the level.
-   * @return The index of the level or NO_VALUE_FOUND if the level wasn't found.
-   */
-  int cLevel_Editor::Find_Selected_Level_Index(std::string name) {
-    int selected_level = NO_VALUE_FOUND;
-    cArray<std::string> level_list = this->Get_Level_List();
-    int level_count = level_list.Count();
-    for (int level_index = 0; level_index < level_count; level_index++) {
-      std::string level = level_list[level_index];
-      if (level == name) {
-        selected_level = level_index;
-        break;
-      }
-    }
-    return selected_level;
-  }
-
-}
+// ============================================================================
+// 2D Level Editor (Implementation)
+// Programmed by Francois Lamini
+// ============================================================================
+
+#include "Level_Editor.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+Codeloader::cLevel_Editor* editor = NULL;
+
+bool On_Process();
+bool On_Key_Process();
+Codeloader::cArray<std::string> Get_Backgrounds(Codeloader::cAllegro_IO* allegro, int width, int height);
+Codeloader::cArray<std::string> Get_Music_Tracks(Codeloader::cAllegro_IO* allegro);
+void Convert_Level(Codeloader::cConfig& config, std::string input, std::string output);
+void Run_Benchmark(Codeloader::cConfig& config, std::vector<int> sprite_counts);
+void Benchmark_Level(Codeloader::cConfig& config, int sprite_count);
+void Generate_Levels(Codeloader::cConfig& config, std::string name, Codeloader::tObject& options);
+int Validate_Project(Codeloader::cConfig& config, std::string folder, Codeloader::tObject& options);
+void Bake_Levels(Codeloader::cConfig& config, std::string folder, Codeloader::tObject& options);
+int Lint_Levels(Codeloader::cConfig& config, std::string folder, Codeloader::tObject& options);
+void Chunk_Level(Codeloader::cConfig& config, std::string name, int chunk_size);
+Codeloader::cArray<std::string> Get_Atlas_Images(std::string palette, Codeloader::cArray<std::string>& backgrounds);
+void Parse_Options(int argc, char** argv, int first, Codeloader::tObject& options);
+std::string Get_Option(Codeloader::tObject& options, std::string name, std::string default_value);
+void Report_Throughput(std::string name, double time, int sprite_count, std::string file);
+void Report_Times(std::string name, std::vector<double>& times);
+void Report_Phases(Codeloader::cProfiler& profiler, int frame_count);
+double Get_Time();
+
+// ****************************************************************************
+// Program Entry Point
+// ****************************************************************************
+
+int main(int argc, char** argv) {
+  int exit_code = 0;
+  try {
+    std::string mode = (argc > 1) ? argv[1] : "";
+    if (mode == "--convert") {
+      Codeloader::Check_Condition((argc == 4), "Usage: Level_Editor --convert <input> <output>");
+      Codeloader::cConfig config("Config");
+      Convert_Level(config, argv[2], argv[3]);
+    }
+    else if (mode == "--benchmark") {
+      std::vector<int> sprite_counts;
+      for (int arg_index = 2; arg_index < argc; arg_index++) {
+        sprite_counts.push_back(std::atoi(argv[arg_index]));
+      }
+      if (sprite_counts.size() == 0) {
+        sprite_counts.push_back(1000);
+        sprite_counts.push_back(10000);
+        sprite_counts.push_back(100000);
+        sprite_counts.push_back(1000000);
+      }
+      Codeloader::cConfig config("Config");
+      Run_Benchmark(config, sprite_counts);
+    }
+    else if (mode == "--generate") {
+      Codeloader::Check_Condition((argc >= 3), "Usage: Level_Editor --generate <level> [sprites=<count>] [pattern=uniform|clustered|horizontal] [max-size=<tiles>] [mix=<layer>:<weight>,...] [levels=<count>] [links=<rate>] [seed=<seed>] [format=text|binary|both]");
+      Codeloader::tObject options;
+      Parse_Options(argc, argv, 3, options);
+      Codeloader::cConfig config("Config");
+      Generate_Levels(config, argv[2], options);
+    }
+    else if (mode == "--validate") {
+      Codeloader::Check_Condition((argc >= 3), "Usage: Level_Editor --validate <folder> [start=<level>,...] [threads=<count>]");
+      Codeloader::tObject options;
+      Parse_Options(argc, argv, 3, options);
+      Codeloader::cConfig config("Config");
+      exit_code = (Validate_Project(config, argv[2], options) > 0) ? 1 : 0;
+    }
+    else if (mode == "--bake") {
+      Codeloader::Check_Condition((argc >= 3), "Usage: Level_Editor --bake <folder> [level=<level>]");
+      Codeloader::tObject options;
+      Parse_Options(argc, argv, 3, options);
+      Codeloader::cConfig config("Config");
+      Bake_Levels(config, argv[2], options);
+    }
+    else if (mode == "--lint") {
+      Codeloader::Check_Condition((argc >= 3), "Usage: Level_Editor --lint <folder> [level=<level>] [limit=<count>]");
+      Codeloader::tObject options;
+      Parse_Options(argc, argv, 3, options);
+      Codeloader::cConfig config("Config");
+      exit_code = (Lint_Levels(config, argv[2], options) > 0) ? 1 : 0;
+    }
+    else if (mode == "--chunk") {
+      Codeloader::Check_Condition(((argc == 3) || (argc == 4)), "Usage: Level_Editor --chunk <level> [<chunk size>]");
+      Codeloader::cConfig config("Config");
+      Chunk_Level(config, argv[2], (argc == 4) ? std::atoi(argv[3]) : STREAM_CHUNK_SIZE);
+    }
+    else if (mode == "--atlas") {
+      Codeloader::cConfig config("Config");
+      int width = config.Get_Property("width");
+      int height = config.Get_Property("height");
+      Codeloader::cAllegro_Tiled_IO allegro("Level Editor :: Atlas", width, height + 32, 2, "Game");
+      allegro.Scan_Resources();
+      Codeloader::cArray<std::string> backgrounds = Get_Backgrounds(&allegro, width, height);
+      allegro.Load_Atlas(Get_Atlas_Images(config.Get_Text_Property("palette"), backgrounds), ATLAS_NAME, true);
+      std::cout << "Packed " << allegro.atlas_pages.size() << " atlas pages." << std::endl;
+    }
+    else {
+      Codeloader::cArray<std::string> param_names;
+      param_names.Add("level");
+      Codeloader::cParameters params(argc, argv, param_names);
+      Codeloader::cConfig config("Config");
+      int width = config.Get_Property("width");
+      int height = config.Get_Property("height");
+      Codeloader::cAllegro_Tiled_IO allegro("Level Editor :: " + params["level"].string, width, height + 32, 2, "Game"); // Add space for HUD.
+      allegro.Set_FPS(60); // Set frame rate!
+      allegro.Scan_Resources(); // Images and music are loaded when they are needed.
+      Codeloader::cArray<std::string> backgrounds = Get_Backgrounds(&allegro, width, height);
+      Codeloader::cArray<std::string> music_tracks = Get_Music_Tracks(&allegro);
+      allegro.Load_Atlas(Get_Atlas_Images(config.Get_Text_Property("palette"), backgrounds), ATLAS_NAME, false);
+      editor = new Codeloader::cLevel_Editor(params["level"].string, config, &allegro, backgrounds, music_tracks);
+      allegro.Start_Loading(editor->level.images.names.strings); // Images in the level first.
+      allegro.Process_Messages(On_Process, On_Key_Process);
+      delete editor;
+    }
+  }
+  catch (Codeloader::cError error) {
+    error.Print();
+    exit_code = 1;
+  }
+  return exit_code;
+}
+
+/**
+ * Processes the level editor loop. 
+ */
+bool On_Process() {
+  editor->Process();
+  return false;
+}
+
+/**
+ * Processes a key to quit the editor. 
+ */
+bool On_Key_Process() {
+  return false;
+}
+
+// ****************************************************************************
+// Utility Routines
+// ****************************************************************************
+
+/**
+ * Gets the list of backgrounds from the resources loaded.
+ * @param allegro The Allegro I/O control.
+ * @param width The width of the screen.
+ * @param height The height of the screen.
+ * @return The list of backgrounds.
+ */
+Codeloader::cArray<std::string> Get_Backgrounds(Codeloader::cAllegro_IO* allegro, int width, int height) {
+  int image_count = allegro->images.Count(); 
+  Codeloader::cArray<std::string> backgrounds;
+  for (int image_index = 0; image_index < image_count; image_index++) {
+    std::string image = allegro->images.keys[image_index];
+    if (image.find("_Bkg") == (image.length() - 4)) {
+      int bkg_width = allegro->Get_Image_Width(image);
+      int bkg_height = allegro->Get_Image_Height(image);
+      Codeloader::Check_Condition((bkg_width == width), "Background " + image + " is not the width of the screen.");
+      Codeloader::Check_Condition((bkg_height == height), "Background " + image + " is not the height of the screen.");
+      std::string background = image.substr(0, image.length() - 4);
+      backgrounds.Add(background);
+    }
+  }
+  return backgrounds;
+}
+
+/**
+ * Gets the list of music track from the resources loaded.
+ * @param allegro The Allegro I/O control.
+ * @return The list of music tracks. 
+ */
+Codeloader::cArray<std::string> Get_Music_Tracks(Codeloader::cAllegro_IO* allegro) {
+  Codeloader::cArray<std::string> music_tracks;
+  int track_count = allegro->tracks.Count();
+  for (int track_index = 0; track_index < track_count; track_index++) {
+    music_tracks.Add(allegro->tracks.keys[track_index]);
+  }
+  return music_tracks;
+}
+
+/**
+ * Gets the images that go in the atlas. These are the icons of the sprite
+ * palette and the backgrounds.
+ * @param palette The name of the sprite palette.
+ * @param backgrounds The list of backgrounds.
+ * @return The names of the images.
+ * @throws An error if the palette could not be read.
+ */
+Codeloader::cArray<std::string> Get_Atlas_Images(std::string palette, Codeloader::cArray<std::string>& backgrounds) {
+  Codeloader::cArray<std::string> images;
+  std::vector<std::string> names;
+  Codeloader::cFile palette_file(palette + ".txt");
+  palette_file.Read();
+  while (palette_file.Has_More_Lines()) {
+    palette_file.Get_Line(); // Sprite type.
+    Codeloader::tObject sprite;
+    palette_file >>= sprite;
+    Codeloader::Destar_Sprite(sprite);
+    if (sprite.Does_Key_Exist("icon")) {
+      names.push_back(sprite["icon"].string);
+    }
+  }
+  int bkg_count = backgrounds.Count();
+  for (int bkg_index = 0; bkg_index < bkg_count; bkg_index++) {
+    names.push_back(backgrounds[bkg_index] + "_Bkg");
+  }
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+  int name_count = names.size();
+  for (int name_index = 0; name_index < name_count; name_index++) {
+    images.Add(names[name_index]);
+  }
+  return images;
+}
+
+/**
+ * Converts a level between the text and binary formats. The format of the
+ * input is detected and the output is written in the other format.
+ * @param config The config parser.
+ * @param input The name of the level file to convert.
+ * @param output The name of the converted level file.
+ * @throws An error if the level could not be converted.
+ */
+void Convert_Level(Codeloader::cConfig& config, std::string input, std::string output) {
+  Codeloader::cLevel level;
+  level.Setup(Codeloader::Parse_Sausage_Text(config.Get_Text_Property("layers"), ","), NULL);
+  level.Load_Templates(config.Get_Text_Property("palette"));
+  level.Load(input);
+  level.format = (level.format == Codeloader::eLEVEL_TEXT) ? Codeloader::eLEVEL_BINARY : Codeloader::eLEVEL_TEXT;
+  level.Save(output);
+  std::cout << "Converted " << input << " to " << output << "." << std::endl;
+}
+
+/**
+ * Splits a level into chunks so the editor can stream it.
+ * @param config The config parser.
+ * @param name The name of the level.
+ * @param chunk_size The width and height of a chunk in pixels.
+ * @throws An error if the level could not be split.
+ */
+void Chunk_Level(Codeloader::cConfig& config, std::string name, int chunk_size) {
+  Codeloader::cLevel level;
+  level.Setup(Codeloader::Parse_Sausage_Text(config.Get_Text_Property("layers"), ","), NULL);
+  level.Load_Templates(config.Get_Text_Property("palette"));
+  level.Load(name + ".map");
+  Codeloader::cLevel_Stream stream;
+  stream.Write_World(level, name, chunk_size);
+  std::cout << "Split " << name << " into " << stream.chunks.size() << " chunks of " << chunk_size << " pixels." << std::endl;
+}
+
+/**
+ * Runs the benchmark on levels of different sizes.
+ * @param config The config parser.
+ * @param sprite_counts The number of sprites in each level.
+ * @throws An error if a level could not be benchmarked.
+ */
+void Run_Benchmark(Codeloader::cConfig& config, std::vector<int> sprite_counts) {
+  int level_count = sprite_counts.size();
+  std::cout << std::fixed << std::setprecision(4);
+  for (int level_index = 0; level_index < level_count; level_index++) {
+    Benchmark_Level(config, sprite_counts[level_index]);
+  }
+}
+
+/**
+ * Benchmarks a synthetic level. The level is saved and loaded in both
+ * formats and then edited with scripted input on a headless I/O control.
+ * The level goes under a name no level in the folder has and its files
+ * are removed afterwards.
+ * @param config The config parser.
+ * @param sprite_count The number of sprites in the level.
+ * @throws An error if the level could not be benchmarked.
+ */
+void Benchmark_Level(Codeloader::cConfig& config, int sprite_count) {
+  std::string name = "Benchmark";
+  std::string level_name;
+  int suffix = 0;
+  bool taken = true;
+  while (taken) {
+    level_name = name + "_" + Codeloader::Number_To_Text(suffix);
+    std::ifstream level_file((level_name + ".map").c_str());
+    std::ifstream journal_file((level_name + ".map.journal").c_str());
+    taken = level_file.is_open() || journal_file.is_open();
+    suffix++;
+  }
+  std::string file = level_name + ".map";
+  int width = config.Get_Property("width");
+  int height = config.Get_Property("height");
+  Codeloader::cArray<std::string> layers = Codeloader::Parse_Sausage_Text(config.Get_Text_Property("layers"), ",");
+  std::cout << "Level of " << sprite_count << " sprites on " << layers.Count() << " layers:" << std::endl;
+  {
+    Codeloader::cLevel level;
+    level.Setup(layers, NULL);
+    level.Load_Templates(config.Get_Text_Property("palette"));
+    Codeloader::cLevel_Generator generator(config);
+    generator.sprite_count = sprite_count;
+    generator.seed = BENCHMARK_SEED;
+    generator.background = name;
+    generator.music_track = name;
+    generator.Load_Palette(config.Get_Text_Property("palette"));
+    std::vector<std::string> level_names(1, level_name);
+    generator.Generate(level, level_names, 0);
+    level.format = Codeloader::eLEVEL_TEXT;
+    double start = Get_Time();
+    level.Save(file);
+    Report_Throughput("Save text", Get_Time() - start, sprite_count, file);
+    Codeloader::cLevel text_level;
+    text_level.Setup(layers, NULL);
+    text_level.Load_Templates(config.Get_Text_Property("palette"));
+    start = Get_Time();
+    text_level.Load(file);
+    Report_Throughput("Load text", Get_Time() - start, sprite_count, file);
+    level.format = Codeloader::eLEVEL_BINARY;
+    start = Get_Time();
+    level.Save(file);
+    Report_Throughput("Save binary", Get_Time() - start, sprite_count, file);
+    Codeloader::cLevel binary_level;
+    binary_level.Setup(layers, NULL);
+    binary_level.Load_Templates(config.Get_Text_Property("palette"));
+    start = Get_Time();
+    binary_level.Load(file);
+    Report_Throughput("Load binary", Get_Time() - start, sprite_count, file);
+  }
+  Codeloader::cHeadless_IO headless(width, height + 32, 16, true);
+  headless.Add_Image(name + "_Bkg", width, height);
+  Codeloader::cArray<std::string> backgrounds;
+  backgrounds.Add(name);
+  Codeloader::cArray<std::string> music_tracks;
+  music_tracks.Add(name);
+  std::remove((file + ".journal").c_str()); // Start from the level just saved.
+  std::vector<double> key_times;
+  std::vector<double> mouse_times;
+  std::vector<double> render_times;
+  {
+    Codeloader::cLevel_Editor editor(level_name, config, &headless, backgrounds, music_tracks);
+    editor.Set_Layer(editor.level.Find_Layer(editor.sel_sprite_layer)); // Layer the palette sprite goes on.
+    int center_x = width / 2;
+    int center_y = height / 2;
+    for (int frame_index = 0; frame_index < BENCHMARK_FRAMES; frame_index++) {
+      int step = frame_index % 150;
+      if (step < 50) { // Scroll across.
+        headless.Add_Key(Codeloader::eSIGNAL_RIGHT);
+        headless.Add_Signal(NO_VALUE_FOUND, center_x, center_y);
+      }
+      else if (step == 50) { // Select or lay down a sprite.
+        headless.Add_Key(NO_VALUE_FOUND);
+        headless.Add_Signal(Codeloader::eBUTTON_LEFT, center_x, center_y);
+      }
+      else if (step < 100) { // Drag it.
+        headless.Add_Key(NO_VALUE_FOUND);
+        headless.Add_Signal(NO_VALUE_FOUND, center_x + step - 50, center_y + step - 50);
+      }
+      else if (step == 100) { // Drop it.
+        headless.Add_Key(NO_VALUE_FOUND);
+        headless.Add_Signal(Codeloader::eBUTTON_RIGHT, center_x, center_y);
+      }
+      else if (step == 119) { // Box select the screen and nudge the group.
+        headless.Add_Key(Codeloader::eSIGNAL_DOWN);
+        headless.Add_Signal(NO_VALUE_FOUND, 0, 0);
+      }
+      else if (step == 120) {
+        headless.Add_Key('g');
+        headless.Add_Signal(NO_VALUE_FOUND, width - 1, height - 1);
+      }
+      else if (step == 121) {
+        headless.Add_Key('g');
+        headless.Add_Signal(NO_VALUE_FOUND, width - 1, height - 1);
+      }
+      else if (step < 125) {
+        headless.Add_Key(Codeloader::eSIGNAL_RIGHT);
+        headless.Add_Signal(NO_VALUE_FOUND, width - 1, height - 1);
+      }
+      else if (step == 125) {
+        headless.Add_Key(NO_VALUE_FOUND);
+        headless.Add_Signal(Codeloader::eBUTTON_RIGHT, center_x, center_y);
+      }
+      else { // Scroll down.
+        headless.Add_Key(Codeloader::eSIGNAL_DOWN);
+        headless.Add_Signal(NO_VALUE_FOUND, center_x, center_y);
+      }
+    }
+    headless.Reset_Counts();
+    editor.profiler.Start_Trace(); // For the times and counts of each phase.
+    for (int frame_index = 0; frame_index < BENCHMARK_FRAMES; frame_index++) {
+      editor.Poll_Input();
+      editor.Process_Input();
+      double input_done = Get_Time();
+      editor.Render();
+      double render_done = Get_Time();
+      headless.Refresh();
+      key_times.push_back(editor.profiler.phases[Codeloader::ePHASE_KEYS].frame.time); // Split out of the input time.
+      mouse_times.push_back(editor.profiler.phases[Codeloader::ePHASE_MOUSE].frame.time);
+      render_times.push_back(render_done - input_done);
+      editor.profiler.End_Frame();
+    }
+    Report_Times("Process_Keys", key_times);
+    Report_Times("Process_Mouse", mouse_times);
+    Report_Times("Render", render_times);
+    std::cout << "  Draws per frame: " << (headless.draw_count / BENCHMARK_FRAMES) << ", pixels per frame: " << (headless.pixel_count / BENCHMARK_FRAMES) << std::endl;
+    Report_Phases(editor.profiler, BENCHMARK_FRAMES);
+  }
+  std::remove(file.c_str());
+  std::remove((file + ".journal").c_str());
+}
+
+/**
+ * Generates synthetic levels from the sprite palette. With more than one
+ * level the levels are numbered and pipes link between them. In both
+ * formats the binary levels go in the folder <name>_binary under the same
+ * names so their links still hold.
+ * @param config The config parser.
+ * @param name The name of the level.
+ * @param options The generator options by name.
+ * @throws An error if the levels could not be generated.
+ */
+void Generate_Levels(Codeloader::cConfig& config, std::string name, Codeloader::tObject& options) {
+  Codeloader::cLevel_Generator generator(config);
+  generator.sprite_count = std::atoi(Get_Option(options, "sprites", "1000").c_str());
+  generator.pattern = Get_Option(options, "pattern", "uniform");
+  generator.max_size = std::atoi(Get_Option(options, "max-size", "4").c_str());
+  generator.link_rate = std::atof(Get_Option(options, "links", "0.5").c_str());
+  generator.seed = std::atoi(Get_Option(options, "seed", "1").c_str());
+  generator.background = Get_Option(options, "background", generator.background);
+  generator.music_track = Get_Option(options, "music-track", generator.music_track);
+  if (options.Does_Key_Exist("mix")) {
+    generator.Set_Mix(options["mix"].string);
+  }
+  generator.Load_Palette(config.Get_Text_Property("palette"));
+  int level_count = std::atoi(Get_Option(options, "levels", "1").c_str());
+  std::string format = Get_Option(options, "format", "text");
+  Codeloader::Check_Condition(((format == "text") || (format == "binary") || (format == "both")), "Format " + format + " is not text, binary, or both.");
+  std::vector<std::string> level_names;
+  for (int level_index = 0; level_index < level_count; level_index++) {
+    level_names.push_back((level_count > 1) ? name + "_" + Codeloader::Number_To_Text(level_index) : name);
+  }
+  std::string binary_folder = name + "_binary";
+  if (format == "both") { // An existing folder is fine.
+#ifdef _WIN32
+    CreateDirectoryA(binary_folder.c_str(), NULL);
+#else
+    mkdir(binary_folder.c_str(), 0755);
+#endif
+  }
+  for (int level_index = 0; level_index < level_count; level_index++) {
+    Codeloader::cLevel level;
+    level.Setup(generator.layers, NULL);
+    level.Load_Templates(config.Get_Text_Property("palette"));
+    generator.Generate(level, level_names, level_index);
+    std::string level_name = level_names[level_index];
+    level.format = (format == "binary") ? Codeloader::eLEVEL_BINARY : Codeloader::eLEVEL_TEXT;
+    level.Save(level_name + ".map");
+    if (format == "both") {
+      level.format = Codeloader::eLEVEL_BINARY;
+      std::string::size_type slash = level_name.find_last_of("/\\"); // The folder sits next to the levels.
+      level.Save(binary_folder + "/" + level_name.substr((slash == std::string::npos) ? 0 : (slash + 1)) + ".map");
+    }
+    std::cout << "Generated " << level_name << " with " << generator.sprite_count << " sprites." << std::endl;
+  }
+}
+
+/**
+ * Checks the links between all levels in a folder. Every level is loaded with
+ * the same rules the editor uses and the problems are listed.
+ * @param config The config parser.
+ * @param folder The folder holding the levels.
+ * @param options The validator options by name.
+ * @return The number of problems found.
+ * @throws An error if the folder could not be read.
+ */
+int Validate_Project(Codeloader::cConfig& config, std::string folder, Codeloader::tObject& options) {
+  Codeloader::cProject_Validator validator(config, folder);
+  int thread_count = std::atoi(Get_Option(options, "threads", "0").c_str());
+  if (thread_count > 0) {
+    validator.thread_count = thread_count;
+  }
+  std::vector<std::string> starts;
+  if (options.Does_Key_Exist("start")) {
+    Codeloader::cArray<std::string> start_list = Codeloader::Parse_Sausage_Text(options["start"].string, ",");
+    int start_count = start_list.Count();
+    for (int start_index = 0; start_index < start_count; start_index++) {
+      starts.push_back(start_list[start_index]);
+    }
+  }
+  double start_time = Get_Time();
+  int problem_count = validator.Validate(starts);
+  double time = Get_Time() - start_time;
+  std::cout << "Checked " << validator.reports.size() << " levels on " << validator.thread_count << " threads in " << time << " ms: " << problem_count << " problems." << std::endl;
+  return problem_count;
+}
+
+/**
+ * Bakes the levels in a folder for the game.
+ * @param config The config parser.
+ * @param folder The folder holding the levels.
+ * @param options The baker options by name.
+ * @throws An error if a level could not be baked.
+ */
+void Bake_Levels(Codeloader::cConfig& config, std::string folder, Codeloader::tObject& options) {
+  Codeloader::cLevel_Baker baker;
+  baker.Setup(config, folder);
+  std::vector<std::string> names;
+  if (options.Does_Key_Exist("level")) {
+    names.push_back(options["level"].string);
+  }
+  else {
+    Codeloader::cProject_Validator validator(config, folder);
+    validator.List_Levels();
+    int report_count = validator.reports.size();
+    for (int report_index = 0; report_index < report_count; report_index++) {
+      names.push_back(validator.reports[report_index].name);
+    }
+  }
+  double start_time = Get_Time();
+  int name_count = names.size();
+  for (int name_index = 0; name_index < name_count; name_index++) {
+    baker.Bake(names[name_index]);
+  }
+  std::cout << "Baked " << name_count << " levels in " << (Get_Time() - start_time) << " ms." << std::endl;
+}
+
+/**
+ * Lints the levels in a folder for stacked duplicates and sprites that
+ * overlap where they should not. Levels that do not load are reported and
+ * skipped.
+ * @param config The config parser.
+ * @param folder The folder holding the levels.
+ * @param options The linter options by name.
+ * @return The number of problems found.
+ * @throws An error if the folder could not be read.
+ */
+int Lint_Levels(Codeloader::cConfig& config, std::string folder, Codeloader::tObject& options) {
+  Codeloader::cLevel_Linter linter;
+  linter.Setup(config);
+  std::vector<std::string> names;
+  if (options.Does_Key_Exist("level")) {
+    names.push_back(options["level"].string);
+  }
+  else {
+    Codeloader::cProject_Validator validator(config, folder);
+    validator.List_Levels();
+    int report_count = validator.reports.size();
+    for (int report_index = 0; report_index < report_count; report_index++) {
+      names.push_back(validator.reports[report_index].name);
+    }
+  }
+  int limit = std::atoi(Get_Option(options, "limit", "20").c_str());
+  Codeloader::cArray<std::string> layers = Codeloader::Parse_Sausage_Text(config.Get_Text_Property("layers"), ",");
+  std::string palette = config.Get_Text_Property("palette");
+  std::unordered_map<std::string, Codeloader::sImage> image_sizes;
+  int problem_count = 0;
+  double lint_time = 0.0;
+  int name_count = names.size();
+  for (int name_index = 0; name_index < name_count; name_index++) {
+    std::string name = names[name_index];
+    Codeloader::cLevel level;
+    bool loaded = true;
+    try {
+      level.Setup(layers, NULL);
+      level.images.file_sizes = &image_sizes; // Size every icon so sprites cover their tiles.
+      level.Load_Templates(palette);
+      level.Load(folder + "/" + name + ".map");
+    }
+    catch (Codeloader::cError error) {
+      std::cout << name << ": " << error.message << std::endl;
+      problem_count++;
+      loaded = false;
+    }
+    if (loaded) {
+      double start_time = Get_Time();
+      int issue_count = linter.Lint(level);
+      lint_time += Get_Time() - start_time;
+      for (int issue_index = 0; (issue_index < issue_count) && (issue_index < limit); issue_index++) {
+        std::cout << name << ": " << linter.Describe(level, linter.issues[issue_index]) << std::endl;
+      }
+      if (issue_count > limit) {
+        std::cout << name << ": " << (issue_count - limit) << " more problems." << std::endl;
+      }
+      problem_count += issue_count;
+    }
+  }
+  std::cout << "Linted " << name_count << " levels in " << lint_time << " ms: " << problem_count << " problems." << std::endl;
+  return problem_count;
+}
+
+/**
+ * Parses the options given on the command line as name=value.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @param first The index of the first option.
+ * @param options The options by name.
+ * @throws An error if an option is not of the form name=value.
+ */
+void Parse_Options(int argc, char** argv, int first, Codeloader::tObject& options) {
+  for (int arg_index = first; arg_index < argc; arg_index++) {
+    std::string option = argv[arg_index];
+    std::string::size_type equals = option.find('=');
+    Codeloader::Check_Condition((equals != std::string::npos), "Option " + option + " is not of the form name=value.");
+    options[option.substr(0, equals)].Set_String(option.substr(equals + 1));
+  }
+}
+
+/**
+ * Gets an option given on the command line.
+ * @param options The options by name.
+ * @param name The name of the option.
+ * @param default_value The value to use if the option was not given.
+ * @return The value of the option.
+ */
+std::string Get_Option(Codeloader::tObject& options, std::string name, std::string default_value) {
+  std::string value = default_value;
+  if (options.Does_Key_Exist(name)) {
+    value = options[name].string;
+  }
+  return value;
+}
+
+/**
+ * Reports how fast a level was read or written.
+ * @param name The name of the measurement.
+ * @param time The time taken in milliseconds.
+ * @param sprite_count The number of sprites in the level.
+ * @param file The name of the level file.
+ */
+void Report_Throughput(std::string name, double time, int sprite_count, std::string file) {
+  std::ifstream level_file(file.c_str(), std::ios::binary | std::ios::ate);
+  double megabytes = (double)level_file.tellg() / (1024 * 1024);
+  double seconds = std::max(time / 1000, 0.000001);
+  std::cout << "  " << name << ": " << time << " ms, " << (int)(sprite_count / seconds) << " sprites/s, " << (megabytes / seconds) << " MB/s" << std::endl;
+}
+
+/**
+ * Reports the median and 99th percentile of frame times.
+ * @param name The name of the measurement.
+ * @param times The times in milliseconds. They are sorted.
+ */
+void Report_Times(std::string name, std::vector<double>& times) {
+  std::sort(times.begin(), times.end());
+  int time_count = times.size();
+  if (time_count > 0) {
+    double p50 = times[(time_count * 50) / 100];
+    double p99 = times[std::min((time_count * 99) / 100, time_count - 1)];
+    std::cout << "  " << name << ": p50 " << p50 << " ms, p99 " << p99 << " ms" << std::endl;
+  }
+}
+
+/**
+ * Reports the time and counts per frame of each phase in a trace.
+ * @param profiler The profiler holding the trace.
+ * @param frame_count The number of frames traced.
+ */
+void Report_Phases(Codeloader::cProfiler& profiler, int frame_count) {
+  int phase_count = profiler.phases.size();
+  std::vector<Codeloader::sProfile_Sample> totals(phase_count, Codeloader::sProfile_Sample());
+  int event_count = profiler.trace.size();
+  for (int event_index = 0; event_index < event_count; event_index++) {
+    Codeloader::sTrace_Event& event = profiler.trace[event_index];
+    Codeloader::sProfile_Sample& total = totals[event.phase];
+    total.time += event.sample.time;
+    total.draw_count += event.sample.draw_count;
+    total.visit_count += event.sample.visit_count;
+    total.cull_count += event.sample.cull_count;
+  }
+  for (int phase_index = 0; phase_index < phase_count; phase_index++) {
+    Codeloader::sProfile_Sample& total = totals[phase_index];
+    if (total.time > 0) {
+      std::cout << "  " << profiler.phases[phase_index].name << ": " << (total.time / frame_count) << " ms, " << (total.draw_count / frame_count) << " draws, " << (total.visit_count / frame_count) << " sprites, " << (total.cull_count / frame_count) << " culled" << std::endl;
+    }
+  }
+}
+
+/**
+ * Gets the time from a steady clock.
+ * @return The time in milliseconds.
+ */
+double Get_Time() {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ****************************************************************************
+// 2D Level Editor
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates a new level editor.
+   * @param name The name of the level to load.
+   * @param config The config parser.
+   * @param io The I/O control.
+   * @param backgrounds The list of backgrounds provided to the editor.
+   * @param music_tracks The list of music tracks provided to the editor.
+   * @throws An error if the sprite palette could not be loaded.
+   */
+  cLevel_Editor::cLevel_Editor(std::string name, cConfig& config, cIO_Control* io, cArray<std::string> backgrounds, cArray<std::string> music_tracks) {
+    this->io = io;
+    this->tiled_io = dynamic_cast<cTiled_IO*>(io); // Draws runs of tiles in one call if the control can.
+    this->level_name = name;
+    this->sel_sprite = NO_VALUE_FOUND;
+    this->sel_level = NO_VALUE_FOUND;
+    this->pick_all_layers = false;
+    this->select_mode = eSELECT_NONE;
+    this->selection_label_count = NO_VALUE_FOUND;
+    this->problem_label_count = NO_VALUE_FOUND;
+    this->mouse_coords.x = 0;
+    this->mouse_coords.y = 0;
+    this->scroll_x = 0;
+    this->scroll_y = 0;
+    this->input_source = dynamic_cast<cInput_Source*>(io); // Controls with an input thread fill the queue themselves.
+    if (this->input_source) {
+      this->input_source->Start_Input(&this->input);
+    }
+    this->held_key = NO_VALUE_FOUND;
+    this->repeat_time = 0;
+    this->repeat_delay = config.Get_Property("key-repeat-delay");
+    this->repeat_interval = config.Get_Property("key-repeat-interval");
+    this->autosave_interval = config.Get_Property("autosave") * 60; // Seconds to frames.
+    this->autosave_timer = this->autosave_interval;
+    this->journal.limit = config.Get_Property("journal-limit");
+    this->history.limit = (long long)config.Get_Property("undo-memory") * 1024; // Kilobytes to bytes.
+    this->streaming = false;
+    this->stream_radius = config.Get_Property("stream-radius");
+    this->level_index.Setup(io, config.Get_Property("level-poll") * 60); // Seconds to frames.
+    this->screen_width = config.Get_Property("width");
+    this->screen_height = config.Get_Property("height");
+    cArray<std::string> layers = Parse_Sausage_Text(config.Get_Text_Property("layers"), ",");
+    this->level.Setup(layers, io);
+    this->layer_caches.resize(this->level.layers.size());
+    this->profiler.Add_Phase("Frame"); // In the order of the phases.
+    this->profiler.Add_Phase("Input");
+    this->profiler.Add_Phase("Keys");
+    this->profiler.Add_Phase("Mouse");
+    this->profiler.Add_Phase("HUD");
+    this->profiler.Add_Phase("Debug Log");
+    this->profiler.Add_Phase("Refresh");
+    this->profiler.Add_Phase("Lint");
+    for (int layer_index = 0; layer_index < layers.Count(); layer_index++) {
+      this->profiler.Add_Phase("Layer " + layers[layer_index]);
+    }
+    this->show_profile = (config.Get_Property("profile") != 0);
+    this->baker.Setup(config, ".");
+    this->linter.Setup(config);
+    this->show_lint = (config.Get_Property("lint") != 0);
+    this->lint_generation = NO_VALUE_FOUND;
+    this->profiler.enabled = this->show_profile;
+    this->backgrounds = backgrounds;
+    Check_Condition((this->backgrounds.Count() > 0), "No backgrounds loaded!");
+    this->Set_Background(this->backgrounds[0]);
+    this->music_tracks = music_tracks;
+    Check_Condition((this->music_tracks.Count() > 0), "No music tracks defined.");
+    this->level.music_track = this->music_tracks[0];
+    this->Set_Layer(0); // Set to lowest layer.
+    std::string palette = config.Get_Text_Property("palette");
+    this->Load_Sprite_Palette(palette);
+    this->Load_Level(name);
+    this->autosaver.Start();
+  }
+
+  /**
+   * Frees the level editor. Any maintenance is done here. 
+   */
+  cLevel_Editor::~cLevel_Editor() {
+    if (this->input_source) {
+      this->input_source->Stop_Input(); // The queue goes away with the editor.
+    }
+    this->Autosave();
+    if (this->streaming) {
+      this->stream.Close(); // Let the chunks finish saving.
+    }
+    else if ((this->journal.entry_count > 0) || !this->journal.base_exists) {
+      this->Compact_Level(); // Leave a complete level for the game.
+    }
+    this->autosaver.Stop(); // Let the queued saves finish.
+  }
+
+  /**
+   * Loads the sprite palette.
+   * @param name The name of the sprite palette.
+   */
+  void cLevel_Editor::Load_Sprite_Palette(std::string name) {
+    cFile palette_file(name + ".txt");
+    palette_file.Read();
+    while (palette_file.Has_More_Lines()) {
+      std::string sprite_name = palette_file.Get_Line();
+      tObject sprite;
+      palette_file >>= sprite;
+      Destar_Sprite(sprite); // Important because properties can be starred from object catalog.
+      this->level.Check_Sprite(sprite);
+      this->level.images.Resolve(sprite["icon"].string);
+      this->level.strings.Intern(sprite["name"].string);
+      this->level.Add_Template(sprite);
+      this->sprite_palette[sprite_name] = sprite;
+    }
+    Check_Condition((this->sprite_palette.Count() > 0), "No sprites in palette!");
+    this->Set_Sprite_Type(this->sprite_palette.keys[0]);
+  }
+
+  /**
+   * Loads a level in either the text or binary format. A level that was
+   * split into chunks is streamed in around the view instead. If the world
+   * file cannot be read the level file is loaded as usual.
+   * @param name The name of the level.
+   */
+  void cLevel_Editor::Load_Level(std::string name) {
+    std::ifstream world_file((name + ".world").c_str());
+    if (world_file.is_open()) {
+      world_file.close();
+      try {
+        this->stream.Open(name, this->level, this->stream_radius);
+        this->streaming = true; // Chunks are saved in place of a journal.
+      }
+      catch (cError error) {
+        error.Print();
+      }
+    }
+    if (!this->streaming) {
+      try {
+        this->level.Load(name + ".map");
+      }
+      catch (cError error) {
+        error.Print();
+      }
+      try {
+        this->journal.Open(name + ".map.journal", name + ".map", this->level); // Recover edits that were not compacted.
+      }
+      catch (cError error) {
+        error.Print();
+      }
+      this->level.journal = &this->journal;
+    }
+    this->level.history = &this->history;
+    this->Set_Background(this->level.background);
+  }
+
+  /**
+   * Saves a level to a file. The level is saved in the format it was loaded in.
+   * @param name The name of the level.
+   */
+  void cLevel_Editor::Save_Level(std::string name) {
+    if (this->streaming) {
+      this->stream.Flush(this->level);
+    }
+    else {
+      this->level.Save(name + ".map");
+    }
+  }
+
+  /**
+   * Saves the edits made since the last save by appending them to the journal
+   * in the background. Once the journal grows past its limit the level is
+   * compacted into the level file.
+   */
+  void cLevel_Editor::Autosave() {
+    if (this->streaming) {
+      this->stream.Flush(this->level); // Only the chunks that changed are written.
+    }
+    else {
+      std::string text = this->journal.Flush();
+      if (text.length() > 0) {
+        this->autosaver.Append(this->journal.name, text);
+      }
+      if (this->journal.Needs_Compaction()) {
+        this->Compact_Level();
+      }
+    }
+  }
+
+  /**
+   * Writes the whole level to the level file and starts a new journal. A
+   * snapshot of the sprite arrays is taken here and the autosaver writes it
+   * out on its own thread so the frame is not held up.
+   */
+  void cLevel_Editor::Compact_Level() {
+    cLevel* snapshot = new cLevel();
+    this->level.Snapshot(*snapshot);
+    this->autosaver.Save(snapshot, this->journal.base_name, this->journal.name);
+    this->journal.entry_count = 0;
+    this->journal.base_exists = true;
+  }
+
+  /**
+   * Handles a key press in the editor.
+   * @param key The key that was pressed.
+   */
+  void cLevel_Editor::Process_Key(sSignal key) {
+    if (this->selection.size() > 0) {
+      this->Process_Selection_Keys(key);
+    }
+    else if (this->sel_sprite == NO_VALUE_FOUND) {
+      if (key.code == eSIGNAL_LEFT) {
+        this->scroll_x -= 20;
+      }
+      else if (key.code == eSIGNAL_RIGHT) {
+        this->scroll_x += 20;
+      }
+      if (key.code == eSIGNAL_UP) {
+        this->scroll_y -= 20;
+      }
+      else if (key.code == eSIGNAL_DOWN) {
+        this->scroll_y += 20;
+      }
+      // Select sprites in a box or lasso.
+      if (key.code == 'g') {
+        if (this->select_mode == eSELECT_BOX) {
+          sPoint corner = this->Get_Level_Coords(this->mouse_coords);
+          sRectangle area;
+          area.left = std::min(this->select_anchor.x, corner.x);
+          area.top = std::min(this->select_anchor.y, corner.y);
+          area.right = std::max(this->select_anchor.x, corner.x);
+          area.bottom = std::max(this->select_anchor.y, corner.y);
+          this->Select_Box(area);
+        }
+        else {
+          this->select_mode = eSELECT_BOX;
+          this->select_anchor = this->Get_Level_Coords(this->mouse_coords);
+        }
+      }
+      else if (key.code == 'h') {
+        if (this->select_mode == eSELECT_LASSO) {
+          this->Select_Lasso();
+        }
+        else {
+          this->select_mode = eSELECT_LASSO;
+          this->lasso.clear();
+          this->lasso.push_back(this->Get_Level_Coords(this->mouse_coords));
+        }
+      }
+      // Pick from all layers or just the selected one.
+      if (key.code == 'a') {
+        this->pick_all_layers = !this->pick_all_layers;
+        this->Set_Layer(this->sel_layer);
+      }
+      // Select layer.
+      if (key.code == 'z') {
+        this->Select_Layer(-1);
+      }
+      else if (key.code == 'x') {
+        this->Select_Layer(1);
+      }
+      // Select sprite type.
+      if (key.code == 'c') {
+        this->Select_Sprite_Type(-1);
+      }
+      else if (key.code == 'v') {
+        this->Select_Sprite_Type(1);
+      }
+      // Select background.
+      if (key.code == 'b') {
+        this->Select_Background(-1);
+      }
+      else if (key.code == 'n') {
+        this->Select_Background(1);
+      }
+      // Select music track.
+      if (key.code == 'm') {
+        this->Select_Music_Track(-1);
+        this->io->Silence();
+      }
+      else if (key.code == ',') {
+        this->Select_Music_Track(1);
+        this->io->Silence();
+      }
+      // Play/stop music track.
+      if (key.code == 'p') {
+        this->io->Play_Music(this->level.music_track);
+      }
+      else if (key.code == 's') {
+        this->io->Silence();
+      }
+    }
+    else { // Sprite is selected.
+      cSprite_Store& store = this->level.layers[this->sel_layer];
+      int sprite = this->sel_sprite;
+      int x = store.x[sprite];
+      int y = store.y[sprite];
+      int size_x = store.size_x[sprite];
+      int size_y = store.size_y[sprite];
+      // Nudge sprite.
+      if (key.code == eSIGNAL_LEFT) {
+        x--;
+      }
+      else if (key.code == eSIGNAL_RIGHT) {
+        x++;
+      }
+      if (key.code == eSIGNAL_UP) {
+        y--;
+      }
+      else if (key.code == eSIGNAL_DOWN) {
+        y++;
+      }
+      // Sizing of sprite.
+      if (key.code == 'i') {
+        if (size_y > 1) {
+          size_y--;
+        }
+      }
+      else if (key.code == 'j') {
+        if (size_x > 1) {
+          size_x--;
+        }
+      }
+      else if (key.code == 'm') {
+        size_y++;
+      }
+      else if (key.code == 'l') {
+        size_x++;
+      }
+      if ((x != store.x[sprite]) || (y != store.y[sprite])) {
+        this->level.Move_Sprite(this->sel_layer, sprite, x, y);
+      }
+      if ((size_x != store.size_x[sprite]) || (size_y != store.size_y[sprite])) {
+        this->level.Resize_Sprite(this->sel_layer, sprite, size_x, size_y);
+      }
+      // Deleting of sprite.
+      if (key.code == eSIGNAL_DELETE) {
+        this->level.Remove_Sprite(this->sel_layer, sprite);
+        this->sel_sprite = NO_VALUE_FOUND;
+      }
+      // Choosing sprite pointer level.
+      else if (store.Has_Property(sprite, "pointer-level")) {
+        cArray<std::string>& level_list = this->Get_Level_List();
+        int level_count = level_list.Count();
+        int limit = level_count - 1;
+        if (key.code == 'z') {
+          this->sel_level--;
+          if (this->sel_level < 0) {
+            this->sel_level = limit;
+          }
+          cValue pointer_level;
+          pointer_level.Set_String(level_list[this->sel_level]);
+          this->level.Set_Sprite_Property(this->sel_layer, sprite, "pointer-level", pointer_level);
+        }
+        else if (key.code == 'x') {
+          this->sel_level++;
+          if (this->sel_level > limit) {
+            this->sel_level = 0;
+          }
+          cValue pointer_level;
+          pointer_level.Set_String(level_list[this->sel_level]);
+          this->level.Set_Sprite_Property(this->sel_layer, sprite, "pointer-level", pointer_level);
+        }
+      }
+    }
+    // Save the level now.
+    if (key.code == 'w') {
+      this->Autosave();
+    }
+    // Show the profiler and trace frames.
+    if (key.code == 'f') {
+      this->show_profile = !this->show_profile;
+    }
+    // Show the sprites that are stacked or overlap where they should not.
+    if (key.code == 'o') {
+      this->show_lint = !this->show_lint;
+      this->lint_generation = NO_VALUE_FOUND;
+    }
+    // Bake the level for the game.
+    if (key.code == 'e') {
+      this->Bake_Level();
+    }
+    if (key.code == 't') {
+      if (this->profiler.tracing) {
+        this->profiler.Save_Trace(this->level_name + ".trace.json");
+      }
+      else {
+        this->profiler.Start_Trace();
+      }
+    }
+    // Undo and redo.
+    if (key.code == 'u') {
+      this->Undo(true);
+    }
+    else if (key.code == 'r') {
+      this->Undo(false);
+    }
+  }
+
+  /**
+   * Processes a mouse signal for the editor.
+   * @param mouse The mouse signal.
+   */
+  void cLevel_Editor::Process_Mouse(sSignal mouse) {
+    if (mouse.code == eSIGNAL_MOUSE) {
+      this->mouse_coords = mouse.coords;
+    }
+    if ((mouse.code == eSIGNAL_MOUSE) && ((this->select_mode != eSELECT_NONE) || (this->selection.size() > 0))) {
+      if (mouse.button == eBUTTON_RIGHT) { // Cancel the selection.
+        this->Clear_Selection();
+      }
+      else if ((mouse.button != eBUTTON_LEFT) && (this->select_mode == eSELECT_LASSO)) {
+        sPoint point = this->Get_Level_Coords(mouse.coords);
+        sPoint& last_point = this->lasso.back();
+        if ((point.x != last_point.x) || (point.y != last_point.y)) {
+          this->lasso.push_back(point);
+        }
+      }
+    }
+    else if (mouse.code == eSIGNAL_MOUSE) {
+      if ((mouse.button == eBUTTON_LEFT) || (mouse.button == eBUTTON_RIGHT)) {
+        this->history.Seal(); // Each drag is its own change.
+      }
+      if (mouse.button == eBUTTON_LEFT) {
+        if (this->sel_sprite == NO_VALUE_FOUND) { // No sprite selected?
+          this->sel_sprite = Select_Sprite(mouse.coords);
+          if (this->sel_sprite == NO_VALUE_FOUND) {
+            this->sel_sprite = this->Create_Sprite(mouse.coords); // Create a new sprite.
+          }
+          if (this->sel_sprite != NO_VALUE_FOUND) {
+            cSprite_Store& store = this->level.layers[this->sel_layer];
+            if (store.Has_Property(this->sel_sprite, "pointer-level")) {
+              cValue pointer_level = store.Get_Property(this->sel_sprite, "pointer-level");
+              this->sel_level = this->Find_Selected_Level_Index(pointer_level.string);
+              if (this->sel_level == NO_VALUE_FOUND) {
+                this->sel_level = 0;
+                pointer_level.Set_String("None");
+                this->level.Set_Sprite_Property(this->sel_layer, this->sel_sprite, "pointer-level", pointer_level);
+              }
+            }
+            else {
+              this->sel_level = NO_VALUE_FOUND;
+            }
+          }
+        }
+      }
+      else if (mouse.button == eBUTTON_RIGHT) {
+        this->sel_sprite = NO_VALUE_FOUND;
+      }
+      else { // No button pressed.
+        if (this->sel_sprite != NO_VALUE_FOUND) {
+          cSprite_Store& store = this->level.layers[this->sel_layer];
+          int x = mouse.coords.x + this->scroll_x;
+          int y = mouse.coords.y + this->scroll_y;
+          if ((store.x[this->sel_sprite] != x) || (store.y[this->sel_sprite] != y)) {
+            this->level.Move_Sprite(this->sel_layer, this->sel_sprite, x, y);
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * Reads input from a control that has no input queue of its own. Such a
+   * control gives at most one key and one mouse signal per frame, and each
+   * key it gives counts as a single press.
+   */
+  void cLevel_Editor::Poll_Input() {
+    if (!this->input_source) {
+      double time = this->input.Get_Time();
+      sInput_Event event;
+      event.time = time;
+      event.signal = this->io->Read_Key();
+      if (event.signal.code != NO_VALUE_FOUND) {
+        event.type = eINPUT_KEY_DOWN;
+        this->input.Push(event);
+        event.type = eINPUT_KEY_UP;
+        this->input.Push(event);
+      }
+      event.signal = this->io->Read_Signal();
+      if (event.signal.code == eSIGNAL_MOUSE) {
+        event.type = eINPUT_MOUSE;
+        this->input.Push(event);
+      }
+    }
+  }
+
+  /**
+   * Handles all input that came in since the last frame in the order it came
+   * in. A held key repeats after the repeat delay and then at the repeat
+   * interval, going by the time of the input and not the frame rate.
+   */
+  void cLevel_Editor::Process_Input() {
+    sInput_Event event;
+    while (this->input.Pop(event)) {
+      if (event.type == eINPUT_KEY_DOWN) {
+        cProfile_Scope keys_scope(this->profiler, ePHASE_KEYS);
+        this->Process_Key(event.signal);
+        this->held_key = event.signal.code;
+        this->repeat_time = event.time + this->repeat_delay;
+      }
+      else if (event.type == eINPUT_KEY_UP) {
+        if (event.signal.code == this->held_key) {
+          this->held_key = NO_VALUE_FOUND;
+        }
+      }
+      else if (event.type == eINPUT_MOUSE) {
+        cProfile_Scope mouse_scope(this->profiler, ePHASE_MOUSE);
+        this->Process_Mouse(event.signal);
+      }
+    }
+    if ((this->held_key != NO_VALUE_FOUND) && (this->repeat_interval > 0)) {
+      double time = this->input.Get_Time();
+      if (time >= this->repeat_time) {
+        sSignal key;
+        key.code = this->held_key;
+        key.coords = this->mouse_coords;
+        key.button = NO_VALUE_FOUND;
+        cProfile_Scope keys_scope(this->profiler, ePHASE_KEYS);
+        this->Process_Key(key);
+        this->repeat_time += this->repeat_interval;
+        if (this->repeat_time <= time) { // Behind after a slow frame so wait a full interval instead of catching up.
+          this->repeat_time = time + this->repeat_interval;
+        }
+      }
+    }
+  }
+
+  /**
+   * Selects a layer given a direction.
+   * @param direction The direction to select the layer from. 
+   */
+  void cLevel_Editor::Select_Layer(int direction) {
+    int layer_count = this->level.layers.size();
+    int next_layer = this->sel_layer + direction;
+    if (next_layer < 0) {
+      next_layer = layer_count - 1;
+    }
+    if (next_layer == layer_count) {
+      next_layer = 0;
+    }
+    this->Set_Layer(next_layer);
+  }
+
+  /**
+   * Determines if a sprite was select and which one was. The topmost sprite
+   * in draw order under the mouse is picked. When picking from all layers the
+   * layer of the sprite becomes the selected layer.
+   * @param coords The coordinates of the mouse.
+   * @return The index of the sprite selected or NO_VALUE_FOUND. 
+   */
+  int cLevel_Editor::Select_Sprite(sPoint coords) {
+    int sel_sprite = NO_VALUE_FOUND;
+    sPoint point;
+    point.x = coords.x + this->scroll_x;
+    point.y = coords.y + this->scroll_y;
+    if (this->pick_all_layers) {
+      for (int layer_index = this->level.layers.size() - 1; layer_index >= 0; layer_index--) { // Top layer first.
+        sel_sprite = this->level.layers[layer_index].grid.Pick(point);
+        if (sel_sprite != NO_VALUE_FOUND) {
+          this->Set_Layer(layer_index);
+          break;
+        }
+      }
+    }
+    else {
+      sel_sprite = this->level.layers[this->sel_layer].grid.Pick(point);
+    }
+    return sel_sprite;
+  }
+
+  /**
+   * Creates a new sprite.
+   * @param coords The mouse coordinates where to lay down the sprite.
+   * @return The index of the new sprite.
+   */
+  int cLevel_Editor::Create_Sprite(sPoint coords) {
+    int sel_sprite = NO_VALUE_FOUND;
+    if (this->sel_sprite_layer == this->level.layers[this->sel_layer].layer) {
+      tObject& sprite = this->sprite_palette[this->sel_sprite_type];
+      sprite["x"].Set_Number(this->scroll_x + coords.x);
+      sprite["y"].Set_Number(this->scroll_y + coords.y);
+      sel_sprite = this->level.Add_Sprite(this->sel_layer, sprite);
+    }
+    return sel_sprite;
+  }
+
+  /**
+   * Selects a sprite type.
+   * @param direction The direction to select the sprite in. 
+   */
+  void cLevel_Editor::Select_Sprite_Type(int direction) {
+    int sprite_count = this->sprite_palette.Count();
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+      std::string sprite = this->sprite_palette.keys[sprite_index];
+      if (this->sel_sprite_type == sprite) {
+        int next_sprite = sprite_index + direction;
+        if (next_sprite < 0) {
+          next_sprite = sprite_count - 1;
+        }
+        if (next_sprite == sprite_count) {
+          next_sprite = 0;
+        }
+        this->Set_Sprite_Type(this->sprite_palette.keys[next_sprite]);
+        break;
+      }
+    }
+  }
+
+  /**
+   * Selects a background.
+   * @param direction The direction to select the background in. 
+   */
+  void cLevel_Editor::Select_Background(int direction) {
+    int background_count = this->backgrounds.Count();
+    for (int background_index = 0; background_index < background_count; background_index++) {
+      std::string background = this->backgrounds[background_index];
+      if (this->level.background == background) {
+        int next_background = background_index + direction;
+        if (next_background < 0) {
+          next_background = background_count - 1;
+        }
+        if (next_background == background_count) {
+          next_background = 0;
+        }
+        this->Set_Background(this->backgrounds[next_background]);
+        break;
+      }
+    }
+  }
+
+  /**
+   * Selects a music track.
+   * @param direction The direction to select the music track in. 
+   */
+  void cLevel_Editor::Select_Music_Track(int direction) {
+    int track_count = this->music_tracks.Count();
+    for (int track_index = 0; track_index < track_count; track_index++) {
+      std::string music_track = this->music_tracks[track_index];
+      if (this->level.music_track == music_track) {
+        int next_track = track_index + direction;
+        if (next_track < 0) {
+          next_track = track_count - 1;
+        }
+        if (next_track == track_count) {
+          next_track = 0;
+        }
+        this->level.Set_Music_Track(this->music_tracks[next_track]);
+        break;
+      }
+    }
+  }
+
+  /**
+   * Renders the level.
+   */
+  void cLevel_Editor::Render() {
+    // Color background white.
+    this->io->Color(255, 255, 255);
+    // Draw the background.
+    sImage& bkg_image = this->level.images.Get(this->background_image);
+    int bkg_width = bkg_image.width;
+    int bkg_height = bkg_image.height;
+    this->io->Draw_Image(bkg_image.name, 0, 0, bkg_width, bkg_height, 0, false, false);
+    // Draw the sprites that are in view.
+    sRectangle view;
+    view.left = this->scroll_x;
+    view.top = this->scroll_y;
+    view.right = this->scroll_x + this->screen_width - 1;
+    view.bottom = this->scroll_y + this->screen_height - 1;
+    int layer_count = this->level.layers.size();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      cProfile_Scope layer_scope(this->profiler, ePHASE_LAYER + layer_index);
+      cLayer_Cache& cache = this->layer_caches[layer_index];
+      cache.Update(this->level.layers[layer_index], view);
+      cache.Draw(this->io, this->tiled_io, this->level.images, view);
+      this->profiler.Count(ePHASE_LAYER + layer_index, cache.draw_count, cache.visit_count, cache.cull_count);
+    }
+    {
+      cProfile_Scope hud_scope(this->profiler, ePHASE_HUD);
+      // Render level console.
+      this->io->Box(0, bkg_height, bkg_width, 32, 255, 255, 255); // Render white box.
+      this->io->Draw_Image(this->level.images.Get(this->sel_sprite_icon).name, 5, bkg_height + 5, 20, 20, 0, false, false);
+      this->io->Output_Text(this->sel_sprite_layer, 30, bkg_height + 3, 0, 0, 0); // Output the name of the layer that the sprite is on.
+      int text_width = this->layer_label_width;
+      int text_height = this->layer_label_height;
+      this->io->Output_Text(this->layer_label, bkg_width - 5 - text_width, bkg_height + 3, 0, 0, 0);
+      int draw_count = 4;
+      if (this->sel_sprite != NO_VALUE_FOUND) {
+        cSprite_Store& store = this->level.layers[this->sel_layer];
+        if (store.Has_Property(this->sel_sprite, "pointer-level")) {
+          int x = store.x[this->sel_sprite];
+          int y = store.y[this->sel_sprite];
+          cValue& pointer_level = store.Get_Property(this->sel_sprite, "pointer-level");
+          if (this->pointer_label.empty() || (pointer_level.type != this->pointer_level.type) || (pointer_level.string != this->pointer_level.string) || (pointer_level.number != this->pointer_level.number)) { // Only build the label when the level changes.
+            this->pointer_level = pointer_level;
+            this->pointer_label = "Points to: " + this->level.Format_Value(pointer_level);
+          }
+          this->io->Output_Text(this->pointer_label, x - this->scroll_x, y - text_height - this->scroll_y, 0, 255, 0);
+          draw_count++;
+        }
+      }
+      // Mark the selected sprites that are in view.
+      int selection_count = this->selection.size();
+      if (selection_count > 0) {
+        cSprite_Store& store = this->level.layers[this->sel_layer];
+        for (int selection_index = 0; selection_index < selection_count; selection_index++) {
+          int sprite = this->selection[selection_index];
+          int x = store.x[sprite] - this->scroll_x;
+          int y = store.y[sprite] - this->scroll_y;
+          if ((x >= 0) && (x < this->screen_width) && (y >= 0) && (y < this->screen_height)) {
+            this->io->Box(x, y, 4, 4, 255, 0, 0);
+            draw_count++;
+          }
+        }
+        if (selection_count != this->selection_label_count) {
+          this->selection_label_count = selection_count;
+          this->selection_label = "Selected: " + Number_To_Text(selection_count);
+        }
+        this->io->Output_Text(this->selection_label, bkg_width / 2, bkg_height + 3, 255, 0, 0);
+        draw_count++;
+      }
+      // Mark the box or lasso being drawn.
+      if (this->select_mode == eSELECT_BOX) { // The box runs from the anchor to the mouse until the second press.
+        int anchor_x = this->select_anchor.x - this->scroll_x;
+        int anchor_y = this->select_anchor.y - this->scroll_y;
+        int left = std::min(anchor_x, this->mouse_coords.x);
+        int top = std::min(anchor_y, this->mouse_coords.y);
+        int width = std::max(anchor_x, this->mouse_coords.x) - left + 1;
+        int height = std::max(anchor_y, this->mouse_coords.y) - top + 1;
+        this->io->Box(anchor_x - 2, anchor_y - 2, 5, 5, 0, 0, 255);
+        this->io->Box(left, top, width, 1, 0, 0, 255);
+        this->io->Box(left, top + height - 1, width, 1, 0, 0, 255);
+        this->io->Box(left, top, 1, height, 0, 0, 255);
+        this->io->Box(left + width - 1, top, 1, height, 0, 0, 255);
+        draw_count += 5;
+      }
+      else if (this->select_mode == eSELECT_LASSO) {
+        int point_count = this->lasso.size();
+        for (int point_index = 0; point_index < point_count; point_index++) {
+          this->io->Box(this->lasso[point_index].x - this->scroll_x, this->lasso[point_index].y - this->scroll_y, 2, 2, 0, 0, 255);
+        }
+        draw_count += point_count;
+      }
+      if (this->show_lint) {
+        draw_count += this->Render_Lint(view);
+        int problem_count = this->linter.issues.size();
+        if (problem_count != this->problem_label_count) {
+          this->problem_label_count = problem_count;
+          this->problem_label = "Problems: " + Number_To_Text(problem_count);
+        }
+        this->io->Output_Text(this->problem_label, bkg_width / 2, bkg_height + 17, 255, 128, 0);
+        draw_count++;
+      }
+      this->profiler.Count(ePHASE_HUD, draw_count, 0, 0);
+    }
+    {
+      cProfile_Scope debug_scope(this->profiler, ePHASE_DEBUG_LOG);
+      // Render debug log.
+      int draw_count = this->debug_log.Count();
+      while (this->debug_log.Count() > 0) {
+        sDebug_Entry debug_entry = this->debug_log.Shift();
+        int text_height = this->io->Get_Text_Height(debug_entry.text);
+        this->io->Output_Text(debug_entry.text, debug_entry.x * text_height, debug_entry.y * text_height, 0, 0, 0);
+      }
+      this->profiler.Count(ePHASE_DEBUG_LOG, draw_count, 0, 0);
+    }
+  }
+
+  /**
+   * Outlines the sprites in view that the linter flagged.
+   * @param view The area of the level in view.
+   * @return The number of draws.
+   */
+  int cLevel_Editor::Render_Lint(sRectangle view) {
+    int draw_count = 0;
+    std::vector<int> sprites;
+    int layer_count = std::min(this->level.layers.size(), this->linter.flags.size());
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      cSprite_Store& store = this->level.layers[layer_index];
+      std::vector<char>& flags = this->linter.flags[layer_index];
+      store.grid.Query(view, sprites);
+      int sprite_count = sprites.size();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        int sprite = sprites[sprite_index];
+        if ((sprite < (int)flags.size()) && flags[sprite]) { // Streamed sprites may come in between runs.
+          sRectangle bounds = store.Get_Bounds(sprite);
+          int x = bounds.left - this->scroll_x;
+          int y = bounds.top - this->scroll_y;
+          int width = bounds.right - bounds.left + 1;
+          int height = bounds.bottom - bounds.top + 1;
+          this->io->Box(x, y, width, 2, 255, 128, 0);
+          this->io->Box(x, y + height - 2, width, 2, 255, 128, 0);
+          this->io->Box(x, y, 2, height, 255, 128, 0);
+          this->io->Box(x + width - 2, y, 2, height, 255, 128, 0);
+          draw_count += 4;
+        }
+      }
+    }
+    return draw_count;
+  }
+
+  /**
+   * Saves the level and bakes it for the game. Streamed levels are only
+   * partly in memory so they are not baked.
+   */
+  void cLevel_Editor::Bake_Level() {
+    if (this->streaming) {
+      std::cout << "Streamed level " << this->level_name << " cannot be baked." << std::endl;
+    }
+    else {
+      this->Autosave(); // Links are resolved against the saved levels.
+      this->baker.entries.clear();
+      try {
+        this->baker.Bake_Level(this->level, this->level_name);
+        std::cout << "Baked " << this->level_name << "." << std::endl;
+      }
+      catch (cError error) {
+        error.Print();
+      }
+    }
+  }
+
+  /**
+   * Renders the profiler overlay. Each phase shows its average time and
+   * counts over the last frames.
+   */
+  void cLevel_Editor::Render_Profile() {
+    int phase_count = this->profiler.phases.size();
+    int line_height = this->io->Get_Text_Height("0");
+    this->io->Box(0, 0, this->screen_width, (phase_count + 1) * line_height, 0, 0, 0);
+    for (int phase_index = 0; phase_index < phase_count; phase_index++) {
+      sProfile_Sample average = this->profiler.Get_Average(phase_index);
+      std::ostringstream line;
+      line << std::fixed << std::setprecision(3) << this->profiler.phases[phase_index].name << ": " << average.time << " ms, " << average.draw_count << " draws, " << average.visit_count << " sprites, " << average.cull_count << " culled";
+      this->io->Output_Text(line.str(), 5, phase_index * line_height, 255, 255, 0);
+    }
+    this->io->Output_Text(this->profiler.tracing ? "Tracing (t to save)" : "t to trace", 5, phase_count * line_height, 255, 255, 0);
+  }
+
+  /**
+   * Processes the level editor. 
+   */
+  void cLevel_Editor::Process() {
+    this->profiler.Begin(ePHASE_FRAME);
+    if (this->autosave_interval > 0) {
+      this->autosave_timer--;
+      if (this->autosave_timer <= 0) {
+        this->Autosave();
+        this->autosave_timer = this->autosave_interval;
+      }
+    }
+    this->level_index.Poll();
+    if (this->streaming) {
+      sRectangle view;
+      view.left = this->scroll_x;
+      view.top = this->scroll_y;
+      view.right = this->scroll_x + this->screen_width - 1;
+      view.bottom = this->scroll_y + this->screen_height - 1;
+      std::vector<std::vector<int> > dropped;
+      if (this->stream.Update(this->level, view, dropped)) { // Sprites were dropped so indices moved.
+        this->Drop_Sprites(dropped);
+      }
+    }
+    {
+      cProfile_Scope input_scope(this->profiler, ePHASE_INPUT);
+      this->Poll_Input();
+      this->Process_Input();
+    }
+    if (this->show_lint && (this->level.generation != this->lint_generation)) { // Lint again after each edit.
+      cProfile_Scope lint_scope(this->profiler, ePHASE_LINT);
+      this->linter.Lint(this->level);
+      this->lint_generation = this->level.generation;
+    }
+    this->Render();
+    if (this->show_profile) {
+      this->Render_Profile();
+    }
+    {
+      cProfile_Scope refresh_scope(this->profiler, ePHASE_REFRESH);
+      this->io->Refresh();
+    }
+    this->profiler.End(ePHASE_FRAME);
+    this->profiler.End_Frame();
+  }
+
+  /**
+   * Prints an object.
+   * @param object The object to print. 
+   */
+  void cLevel_Editor::Print_Object(tObject& object) {
+    int prop_count = object.Count();
+    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+      std::string property = object.keys[prop_index];
+      cValue& value = object[property];
+      if (value.type == eVALUE_NUMBER) {
+        std::cout << property << "=" << Number_To_Text(value.number) << std::endl;
+      }
+      else if (value.type == eVALUE_STRING) {
+        std::cout << property << "=" << value.string << std::endl;
+      }
+    }
+  }
+
+  /**
+   * Prints a debug statement on the screen.
+   * @param text The text to print.
+   * @param x The x coordinate. (Coordinates are in text coordinates.)
+   * @param y The y coordinate.
+   */
+  void cLevel_Editor::Debug(std::string text, int x, int y) {
+    sDebug_Entry debug_entry;
+    debug_entry.text = text;
+    debug_entry.x = x;
+    debug_entry.y = y;
+    this->debug_log.Add(debug_entry);
+  }
+
+  /**
+   * Gets the list of levels from the level index.
+   * @return The list of levels without the extension, after the no level option.
+   */
+  cArray<std::string>& cLevel_Editor::Get_Level_List() {
+    return this->level_index.levels;
+  }
+
+  /**
+   * Finds the selected level index given the name.
+   * @param name The name of the level.
+   * @return The index of the level or NO_VALUE_FOUND if the level wasn't found.
+   */
+  int cLevel_Editor::Find_Selected_Level_Index(std::string name) {
+    return this->level_index.Find(name);
+  }
+
+  /**
+   * Handles the keys while a group of sprites is selected. Changes are made
+   * to the whole group at once.
+   * @param key The key that was pressed.
+   */
+  void cLevel_Editor::Process_Selection_Keys(sSignal key) {
+    int offset_x = 0;
+    int offset_y = 0;
+    int grow_x = 0;
+    int grow_y = 0;
+    // Nudge sprites.
+    if (key.code == eSIGNAL_LEFT) {
+      offset_x = -1;
+    }
+    else if (key.code == eSIGNAL_RIGHT) {
+      offset_x = 1;
+    }
+    if (key.code == eSIGNAL_UP) {
+      offset_y = -1;
+    }
+    else if (key.code == eSIGNAL_DOWN) {
+      offset_y = 1;
+    }
+    // Sizing of sprites.
+    if (key.code == 'i') {
+      grow_y = -1;
+    }
+    else if (key.code == 'j') {
+      grow_x = -1;
+    }
+    else if (key.code == 'm') {
+      grow_y = 1;
+    }
+    else if (key.code == 'l') {
+      grow_x = 1;
+    }
+    if ((offset_x != 0) || (offset_y != 0)) {
+      this->level.Move_Sprites(this->sel_layer, this->selection, offset_x, offset_y);
+    }
+    if ((grow_x != 0) || (grow_y != 0)) {
+      this->level.Resize_Sprites(this->sel_layer, this->selection, grow_x, grow_y);
+    }
+    // Deleting of sprites.
+    if (key.code == eSIGNAL_DELETE) {
+      this->level.Remove_Sprites(this->sel_layer, this->selection);
+      this->Clear_Selection();
+    }
+    // Moving sprites to another layer.
+    else if ((key.code == 'z') || (key.code == 'x')) {
+      int layer_count = this->level.layers.size();
+      int new_layer = (this->sel_layer + ((key.code == 'z') ? -1 : 1) + layer_count) % layer_count;
+      this->level.Change_Layer(this->sel_layer, this->selection, new_layer);
+      this->Set_Layer(new_layer); // The selection follows the sprites.
+    }
+  }
+
+  /**
+   * Selects the sprites on the selected layer that overlap a box.
+   * @param area The box in level coordinates.
+   */
+  void cLevel_Editor::Select_Box(sRectangle area) {
+    this->select_mode = eSELECT_NONE;
+    this->sel_sprite = NO_VALUE_FOUND;
+    this->level.layers[this->sel_layer].grid.Query(area, this->selection);
+    this->history.Seal();
+  }
+
+  /**
+   * Selects the sprites on the selected layer whose centers are inside the
+   * lasso. Only sprites in the box around the lasso are tested.
+   */
+  void cLevel_Editor::Select_Lasso() {
+    sRectangle area;
+    area.left = this->lasso[0].x;
+    area.top = this->lasso[0].y;
+    area.right = area.left;
+    area.bottom = area.top;
+    int point_count = this->lasso.size();
+    for (int point_index = 1; point_index < point_count; point_index++) {
+      area.left = std::min(area.left, this->lasso[point_index].x);
+      area.top = std::min(area.top, this->lasso[point_index].y);
+      area.right = std::max(area.right, this->lasso[point_index].x);
+      area.bottom = std::max(area.bottom, this->lasso[point_index].y);
+    }
+    cSprite_Store& store = this->level.layers[this->sel_layer];
+    store.grid.Query(area, this->visible_sprites);
+    this->selection.clear();
+    int sprite_count = this->visible_sprites.size();
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+      int sprite = this->visible_sprites[sprite_index];
+      sRectangle bounds = store.Get_Bounds(sprite);
+      sPoint center;
+      center.x = (bounds.left + bounds.right) / 2;
+      center.y = (bounds.top + bounds.bottom) / 2;
+      if (this->Is_Point_In_Lasso(center)) {
+        this->selection.push_back(sprite);
+      }
+    }
+    this->select_mode = eSELECT_NONE;
+    this->sel_sprite = NO_VALUE_FOUND;
+    this->lasso.clear();
+    this->history.Seal();
+  }
+
+  /**
+   * Determines if a point is inside the lasso by counting how many of its
+   * edges a ray from the point crosses.
+   * @param point The point in level coordinates.
+   * @return True if the point is inside, false otherwise.
+   */
+  bool cLevel_Editor::Is_Point_In_Lasso(sPoint point) {
+    bool inside = false;
+    int point_count = this->lasso.size();
+    for (int point_index = 0, last_index = point_count - 1; point_index < point_count; last_index = point_index++) {
+      sPoint& start = this->lasso[point_index];
+      sPoint& end = this->lasso[last_index];
+      if ((start.y > point.y) != (end.y > point.y)) {
+        double cross_x = start.x + ((double)(end.x - start.x) * (point.y - start.y)) / (end.y - start.y);
+        if (point.x < cross_x) {
+          inside = !inside;
+        }
+      }
+    }
+    return inside;
+  }
+
+  /**
+   * Clears the group selection and any box or lasso being drawn.
+   */
+  void cLevel_Editor::Clear_Selection() {
+    this->selection.clear();
+    this->lasso.clear();
+    this->select_mode = eSELECT_NONE;
+  }
+
+  /**
+   * Follows sprites being dropped from the level by streaming. The history
+   * and the selection keep pointing at the same sprites and lose only the
+   * ones that were dropped.
+   * @param dropped The dropped sprites for each layer, in order.
+   */
+  void cLevel_Editor::Drop_Sprites(std::vector<std::vector<int> >& dropped) {
+    std::vector<int>& gone = dropped[this->sel_layer];
+    this->history.Drop_Sprites(dropped);
+    if (this->sel_sprite != NO_VALUE_FOUND) {
+      this->sel_sprite = this->history.Shift_Sprite(gone, this->sel_sprite);
+    }
+    std::vector<int> selection;
+    int selection_count = this->selection.size();
+    for (int selection_index = 0; selection_index < selection_count; selection_index++) {
+      int sprite = this->history.Shift_Sprite(gone, this->selection[selection_index]);
+      if (sprite != NO_VALUE_FOUND) {
+        selection.push_back(sprite);
+      }
+    }
+    this->selection.swap(selection);
+    this->lint_generation = NO_VALUE_FOUND;
+  }
+
+  /**
+   * Undoes or redoes the last change. The selection is cleared since the
+   * sprites it points to may have moved.
+   * @param undo True to undo, false to redo.
+   */
+  void cLevel_Editor::Undo(bool undo) {
+    bool changed = undo ? this->history.Undo(this->level) : this->history.Redo(this->level);
+    if (changed) {
+      this->sel_sprite = NO_VALUE_FOUND;
+      this->Clear_Selection();
+      this->Set_Background(this->level.background);
+    }
+  }
+
+  /**
+   * Converts screen coordinates to level coordinates.
+   * @param coords The screen coordinates.
+   * @return The level coordinates.
+   */
+  sPoint cLevel_Editor::Get_Level_Coords(sPoint coords) {
+    sPoint point;
+    point.x = coords.x + this->scroll_x;
+    point.y = coords.y + this->scroll_y;
+    return point;
+  }
+
+  /**
+   * Selects a layer and caches its label for the console.
+   * @param layer The index of the layer.
+   */
+  void cLevel_Editor::Set_Layer(int layer) {
+    this->sel_layer = layer;
+    this->layer_label = "Layer: " + this->level.layers[layer].layer;
+    if (this->pick_all_layers) {
+      this->layer_label += " (pick all)";
+    }
+    this->layer_label_width = this->io->Get_Text_Width(this->layer_label);
+    this->layer_label_height = this->io->Get_Text_Height(this->layer_label);
+  }
+
+  /**
+   * Selects a sprite type from the palette and caches its icon and layer.
+   * @param sprite_type The name of the sprite in the palette.
+   */
+  void cLevel_Editor::Set_Sprite_Type(std::string sprite_type) {
+    tObject& sprite = this->sprite_palette[sprite_type];
+    this->sel_sprite_type = sprite_type;
+    this->sel_sprite_icon = this->level.images.Resolve(sprite["icon"].string);
+    this->sel_sprite_layer = sprite["layer"].string;
+  }
+
+  /**
+   * Sets the background and resolves its image.
+   * @param background The name of the background without the suffix.
+   */
+  void cLevel_Editor::Set_Background(std::string background) {
+    if (this->level.background != background) {
+      this->level.Set_Background(background);
+    }
+    this->background_image = this->level.images.Resolve(background + "_Bkg");
+  }
+
+}
+
+// ****************************************************************************
+// Spatial Grid
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates a new spatial grid with the default cell size.
+   */
+  cSpatial_Grid::cSpatial_Grid() {
+    this->cell_size = GRID_CELL_SIZE;
+    this->mark = 0;
+    this->track_changes = false;
+    this->Mark_All_Dirty();
+  }
+
+  /**
+   * Creates a new spatial grid.
+   * @param cell_size The size of a grid cell in pixels.
+   * @throws An error if the cell size is not positive.
+   */
+  cSpatial_Grid::cSpatial_Grid(int cell_size) {
+    Check_Condition((cell_size > 0), "Grid cell size must be positive.");
+    this->cell_size = cell_size;
+    this->mark = 0;
+    this->track_changes = false;
+    this->Mark_All_Dirty();
+  }
+
+  /**
+   * Inserts a sprite into the grid. Sprites must be inserted in order.
+   * @param sprite The index of the sprite.
+   * @param bounds The bounds of the sprite in level coordinates.
+   * @throws An error if the sprite is not inserted at the end.
+   */
+  void cSpatial_Grid::Insert(int sprite, sRectangle bounds) {
+    Check_Condition((sprite == this->Count()), "Sprite inserted out of order in grid.");
+    this->bounds.push_back(bounds);
+    this->marks.push_back(0);
+    this->Add_To_Cells(sprite, bounds);
+  }
+
+  /**
+   * Updates the bounds of a sprite that moved or was resized.
+   * @param sprite The index of the sprite.
+   * @param bounds The new bounds of the sprite.
+   */
+  void cSpatial_Grid::Update(int sprite, sRectangle bounds) {
+    sRectangle& old_bounds = this->bounds[sprite];
+    if ((old_bounds.left != bounds.left) || (old_bounds.top != bounds.top) || (old_bounds.right != bounds.right) || (old_bounds.bottom != bounds.bottom)) {
+      this->Remove_From_Cells(sprite, old_bounds);
+      this->bounds[sprite] = bounds;
+      this->Add_To_Cells(sprite, bounds);
+    }
+  }
+
+  /**
+   * Removes a sprite from the grid. Sprites after it are shifted down by one
+   * so that indices match the layer they were removed from.
+   * @param sprite The index of the sprite.
+   */
+  void cSpatial_Grid::Remove(int sprite) {
+    this->Remove_From_Cells(sprite, this->bounds[sprite]);
+    this->bounds.erase(this->bounds.begin() + sprite);
+    this->marks.erase(this->marks.begin() + sprite);
+    for (std::unordered_map<long long, std::vector<int> >::iterator cell = this->cells.begin(); cell != this->cells.end(); cell++) {
+      std::vector<int>& sprites = cell->second;
+      int sprite_count = sprites.size();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        if (sprites[sprite_index] > sprite) {
+          sprites[sprite_index]--;
+        }
+      }
+    }
+  }
+
+  /**
+   * Removes many sprites from the grid at once. The remaining sprites are
+   * renumbered in a single pass over the cells.
+   * @param sprites The indices of the sprites in ascending order.
+   */
+  void cSpatial_Grid::Remove_Sprites(std::vector<int>& sprites) {
+    int sprite_count = this->bounds.size();
+    std::vector<int> new_indices(sprite_count, 0);
+    int remove_count = sprites.size();
+    for (int remove_index = 0; remove_index < remove_count; remove_index++) {
+      int sprite = sprites[remove_index];
+      this->Remove_From_Cells(sprite, this->bounds[sprite]);
+      new_indices[sprite] = NO_VALUE_FOUND;
+    }
+    int next_sprite = 0;
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+      if (new_indices[sprite_index] != NO_VALUE_FOUND) {
+        new_indices[sprite_index] = next_sprite;
+        this->bounds[next_sprite] = this->bounds[sprite_index];
+        this->marks[next_sprite] = this->marks[sprite_index];
+        next_sprite++;
+      }
+    }
+    this->bounds.resize(next_sprite);
+    this->marks.resize(next_sprite);
+    for (std::unordered_map<long long, std::vector<int> >::iterator cell = this->cells.begin(); cell != this->cells.end(); cell++) {
+      std::vector<int>& cell_sprites = cell->second;
+      int cell_count = cell_sprites.size();
+      for (int sprite_index = 0; sprite_index < cell_count; sprite_index++) {
+        cell_sprites[sprite_index] = new_indices[cell_sprites[sprite_index]];
+      }
+    }
+  }
+
+  /**
+   * Inserts many sprites into the grid at once. The sprites already in the
+   * grid are renumbered in a single pass over the cells.
+   * @param sprites The indices the sprites will have, in ascending order.
+   * @param bounds The bounds of each sprite in level coordinates.
+   */
+  void cSpatial_Grid::Insert_Sprites(std::vector<int>& sprites, std::vector<sRectangle>& bounds) {
+    int old_count = this->bounds.size();
+    int insert_count = sprites.size();
+    std::vector<int> new_indices(old_count, 0);
+    int insert_index = 0;
+    for (int sprite_index = 0; sprite_index < old_count; sprite_index++) {
+      while ((insert_index < insert_count) && (sprites[insert_index] <= (sprite_index + insert_index))) {
+        insert_index++;
+      }
+      new_indices[sprite_index] = sprite_index + insert_index;
+    }
+    for (std::unordered_map<long long, std::vector<int> >::iterator cell = this->cells.begin(); cell != this->cells.end(); cell++) {
+      std::vector<int>& cell_sprites = cell->second;
+      int cell_count = cell_sprites.size();
+      for (int sprite_index = 0; sprite_index < cell_count; sprite_index++) {
+        cell_sprites[sprite_index] = new_indices[cell_sprites[sprite_index]];
+      }
+    }
+    std::vector<sRectangle> new_bounds(old_count + insert_count);
+    for (int sprite_index = 0; sprite_index < old_count; sprite_index++) {
+      new_bounds[new_indices[sprite_index]] = this->bounds[sprite_index];
+    }
+    for (int insert_index = 0; insert_index < insert_count; insert_index++) {
+      new_bounds[sprites[insert_index]] = bounds[insert_index];
+    }
+    this->bounds = new_bounds;
+    this->marks.assign(old_count + insert_count, this->mark);
+    for (int insert_index = 0; insert_index < insert_count; insert_index++) {
+      this->Add_To_Cells(sprites[insert_index], bounds[insert_index]);
+    }
+  }
+
+  /**
+   * Finds all sprites whose bounds overlap an area.
+   * @param area The area to query in level coordinates.
+   * @param sprites The sprite indices found, sorted in draw order.
+   */
+  void cSpatial_Grid::Query(sRectangle area, std::vector<int>& sprites) {
+    sprites.clear();
+    this->mark++;
+    int left = this->Get_Cell(area.left);
+    int top = this->Get_Cell(area.top);
+    int right = this->Get_Cell(area.right);
+    int bottom = this->Get_Cell(area.bottom);
+    for (int cell_y = top; cell_y <= bottom; cell_y++) {
+      for (int cell_x = left; cell_x <= right; cell_x++) {
+        std::unordered_map<long long, std::vector<int> >::iterator cell = this->cells.find(this->Get_Cell_Key(cell_x, cell_y));
+        if (cell != this->cells.end()) {
+          std::vector<int>& cell_sprites = cell->second;
+          int sprite_count = cell_sprites.size();
+          for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+            int sprite = cell_sprites[sprite_index];
+            if (this->marks[sprite] != this->mark) { // Sprites spanning cells are only reported once.
+              this->marks[sprite] = this->mark;
+              sRectangle& bounds = this->bounds[sprite];
+              if ((bounds.left <= area.right) && (bounds.right >= area.left) && (bounds.top <= area.bottom) && (bounds.bottom >= area.top)) {
+                sprites.push_back(sprite);
+              }
+            }
+          }
+        }
+      }
+    }
+    std::sort(sprites.begin(), sprites.end());
+  }
+
+  /**
+   * Finds the topmost sprite at a point. Only the cell under the point is
+   * searched since every sprite is listed in each cell it covers.
+   * @param point The point in level coordinates.
+   * @return The highest sprite index at the point or NO_VALUE_FOUND.
+   */
+  int cSpatial_Grid::Pick(sPoint point) {
+    int sprite = NO_VALUE_FOUND;
+    std::unordered_map<long long, std::vector<int> >::iterator cell = this->cells.find(this->Get_Cell_Key(this->Get_Cell(point.x), this->Get_Cell(point.y)));
+    if (cell != this->cells.end()) {
+      std::vector<int>& cell_sprites = cell->second;
+      int sprite_count = cell_sprites.size();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        int cell_sprite = cell_sprites[sprite_index];
+        if ((cell_sprite > sprite) && Is_Point_In_Box(point, this->bounds[cell_sprite])) {
+          sprite = cell_sprite;
+        }
+      }
+    }
+    return sprite;
+  }
+
+  /**
+   * Clears out all sprites in the grid.
+   */
+  void cSpatial_Grid::Clear() {
+    this->cells.clear();
+    this->bounds.clear();
+    this->marks.clear();
+    this->mark = 0;
+    this->Mark_All_Dirty();
+  }
+
+  /**
+   * Gets the number of sprites in the grid.
+   * @return The number of sprites.
+   */
+  int cSpatial_Grid::Count() {
+    return this->bounds.size();
+  }
+
+  /**
+   * Adds a sprite to all cells covered by its bounds.
+   * @param sprite The index of the sprite.
+   * @param bounds The bounds of the sprite.
+   */
+  void cSpatial_Grid::Add_To_Cells(int sprite, sRectangle bounds) {
+    this->Mark_Dirty(bounds);
+    int left = this->Get_Cell(bounds.left);
+    int top = this->Get_Cell(bounds.top);
+    int right = this->Get_Cell(bounds.right);
+    int bottom = this->Get_Cell(bounds.bottom);
+    for (int cell_y = top; cell_y <= bottom; cell_y++) {
+      for (int cell_x = left; cell_x <= right; cell_x++) {
+        this->cells[this->Get_Cell_Key(cell_x, cell_y)].push_back(sprite);
+      }
+    }
+  }
+
+  /**
+   * Removes a sprite from all cells covered by its bounds.
+   * @param sprite The index of the sprite.
+   * @param bounds The bounds of the sprite.
+   */
+  void cSpatial_Grid::Remove_From_Cells(int sprite, sRectangle bounds) {
+    this->Mark_Dirty(bounds);
+    int left = this->Get_Cell(bounds.left);
+    int top = this->Get_Cell(bounds.top);
+    int right = this->Get_Cell(bounds.right);
+    int bottom = this->Get_Cell(bounds.bottom);
+    for (int cell_y = top; cell_y <= bottom; cell_y++) {
+      for (int cell_x = left; cell_x <= right; cell_x++) {
+        long long key = this->Get_Cell_Key(cell_x, cell_y);
+        std::vector<int>& sprites = this->cells[key];
+        sprites.erase(std::remove(sprites.begin(), sprites.end(), sprite), sprites.end());
+        if (sprites.empty()) {
+          this->cells.erase(key);
+        }
+      }
+    }
+  }
+
+  /**
+   * Gets the cell that a coordinate falls in. Negative coordinates are
+   * rounded down so cells stay the same size on both sides of zero.
+   * @param coord The coordinate.
+   * @return The cell coordinate.
+   */
+  int cSpatial_Grid::Get_Cell(int coord) {
+    int cell = 0;
+    if (coord >= 0) {
+      cell = coord / this->cell_size;
+    }
+    else {
+      cell = -((-coord - 1) / this->cell_size) - 1;
+    }
+    return cell;
+  }
+
+  /**
+   * Packs cell coordinates into a hash key.
+   * @param cell_x The x coordinate of the cell.
+   * @param cell_y The y coordinate of the cell.
+   * @return The key of the cell.
+   */
+  long long cSpatial_Grid::Get_Cell_Key(int cell_x, int cell_y) {
+    return (long long)(((unsigned long long)(unsigned int)cell_x << 32) | (unsigned int)cell_y); // Shifted unsigned since negative cells are common.
+  }
+
+  /**
+   * Adds an area that changed to the dirty area of the grid. The dirty area
+   * is kept as one rectangle that covers every change since it was taken.
+   * @param area The area that changed in level coordinates.
+   */
+  void cSpatial_Grid::Mark_Dirty(sRectangle area) {
+    if (this->track_changes) {
+      this->changes.push_back(area);
+    }
+    if (this->is_dirty) {
+      this->dirty.left = std::min(this->dirty.left, area.left);
+      this->dirty.top = std::min(this->dirty.top, area.top);
+      this->dirty.right = std::max(this->dirty.right, area.right);
+      this->dirty.bottom = std::max(this->dirty.bottom, area.bottom);
+    }
+    else {
+      this->dirty = area;
+      this->is_dirty = true;
+    }
+  }
+
+  /**
+   * Marks the whole grid as dirty.
+   */
+  void cSpatial_Grid::Mark_All_Dirty() {
+    this->dirty.left = INT_MIN;
+    this->dirty.top = INT_MIN;
+    this->dirty.right = INT_MAX;
+    this->dirty.bottom = INT_MAX;
+    this->is_dirty = true;
+  }
+
+  /**
+   * Takes the dirty area and clears it.
+   * @param area The area that changed since the last call.
+   * @return True if anything changed, false otherwise.
+   */
+  bool cSpatial_Grid::Take_Dirty(sRectangle& area) {
+    bool was_dirty = this->is_dirty;
+    area = this->dirty;
+    this->is_dirty = false;
+    return was_dirty;
+  }
+
+}
+
+// ****************************************************************************
+// Sprite Store
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates an empty sprite store.
+   */
+  cSprite_Store::cSprite_Store() {
+    this->strings = NULL;
+    this->images = NULL;
+    this->grid = cSpatial_Grid(GRID_CELL_SIZE);
+  }
+
+  /**
+   * Creates a sprite store for a layer.
+   * @param layer The name of the layer.
+   * @param strings The table that sprite names are interned in.
+   * @param images The table that icons are resolved in.
+   */
+  cSprite_Store::cSprite_Store(std::string layer, cString_Table* strings, cImage_Table* images) {
+    this->layer = layer;
+    this->strings = strings;
+    this->images = images;
+    this->grid = cSpatial_Grid(GRID_CELL_SIZE);
+  }
+
+  /**
+   * Adds a sprite to the store. Geometry and the icon are unpacked into the
+   * typed arrays, everything else goes to the extra property table.
+   * @param sprite The sprite object.
+   * @return The index of the sprite.
+   * @throws An error if the sprite is on a different layer.
+   */
+  int cSprite_Store::Add(tObject& sprite) {
+    Check_Condition((sprite["layer"].string == this->layer), "Sprite is not on layer " + this->layer + ".");
+    sSprite_Record record = this->Make_Record(sprite);
+    return this->Append(record.name, record.icon, record.x, record.y, record.size_x, record.size_y, record.layout, &record.extra);
+  }
+
+  /**
+   * Appends a sprite whose properties have already been resolved.
+   * @param name The interned name of the sprite.
+   * @param icon The handle of the sprite's icon.
+   * @param x The x coordinate.
+   * @param y The y coordinate.
+   * @param size_x The number of tiles across.
+   * @param size_y The number of tiles down.
+   * @param layout The index of the property layout.
+   * @param extra The extra properties or NULL if there are none.
+   * @return The index of the sprite.
+   */
+  int cSprite_Store::Append(int name, int icon, int x, int y, int size_x, int size_y, int layout, tObject* extra) {
+    int index = this->Count();
+    this->x.push_back(x);
+    this->y.push_back(y);
+    this->size_x.push_back(size_x);
+    this->size_y.push_back(size_y);
+    this->width.push_back(this->images->Get(icon).width);
+    this->height.push_back(this->images->Get(icon).height);
+    this->names.push_back(name);
+    this->icons.push_back(icon);
+    this->layouts.push_back(layout);
+    this->extras.push_back(this->Store_Extra(extra));
+    this->grid.Insert(index, this->Get_Bounds(index));
+    return index;
+  }
+
+  /**
+   * Stores extra properties in the shared extra property table. Sprites with
+   * the same properties, like every pipe placed from one palette entry, share
+   * one immutable set that is counted instead of copied.
+   * @param extra The extra properties or NULL if there are none.
+   * @return The slot or NO_VALUE_FOUND if there were no properties to store.
+   */
+  int cSprite_Store::Store_Extra(tObject* extra) {
+    int slot = NO_VALUE_FOUND;
+    if ((extra != NULL) && (extra->Count() > 0)) {
+      std::string key = this->Get_Extra_Key(*extra);
+      std::unordered_map<std::string, int>::iterator match = this->extra_ids.find(key);
+      if (match != this->extra_ids.end()) {
+        slot = match->second;
+        this->extra_refs[slot]++;
+      }
+      else {
+        slot = this->extra_table.size();
+        if (this->free_extras.size() > 0) {
+          slot = this->free_extras.back();
+          this->free_extras.pop_back();
+          this->extra_table[slot] = std::make_shared<tObject>(*extra);
+          this->extra_refs[slot] = 1;
+        }
+        else {
+          this->extra_table.push_back(std::make_shared<tObject>(*extra));
+          this->extra_refs.push_back(1);
+        }
+        this->extra_ids[key] = slot;
+      }
+    }
+    return slot;
+  }
+
+  /**
+   * Drops a reference to a shared set of extra properties, freeing the slot
+   * once no sprite uses it.
+   * @param slot The slot or NO_VALUE_FOUND if there is nothing to release.
+   */
+  void cSprite_Store::Release_Extra(int slot) {
+    if (slot != NO_VALUE_FOUND) {
+      this->extra_refs[slot]--;
+      if (this->extra_refs[slot] == 0) {
+        this->extra_ids.erase(this->Get_Extra_Key(*this->extra_table[slot]));
+        this->extra_table[slot].reset();
+        this->free_extras.push_back(slot);
+      }
+    }
+  }
+
+  /**
+   * Gets the key that identifies a set of extra properties in the table.
+   * Text is ended with a zero and numbers are kept as raw bytes so no value
+   * can run into the next property.
+   * @param extra The extra properties.
+   * @return The key of the properties.
+   */
+  std::string cSprite_Store::Get_Extra_Key(tObject& extra) {
+    std::string key;
+    int prop_count = extra.Count();
+    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+      std::string& name = extra.keys[prop_index];
+      cValue& value = extra[name];
+      key.append(name.c_str(), name.length() + 1);
+      if (value.type == eVALUE_STRING) {
+        key += 's';
+        key.append(value.string.c_str(), value.string.length() + 1);
+      }
+      else {
+        key += 'n';
+        key.append((const char*)&value.number, sizeof(value.number));
+      }
+    }
+    return key;
+  }
+
+  /**
+   * Removes a sprite from the store.
+   * @param index The index of the sprite.
+   */
+  void cSprite_Store::Remove(int index) {
+    this->Release_Extra(this->extras[index]);
+    this->x.erase(this->x.begin() + index);
+    this->y.erase(this->y.begin() + index);
+    this->size_x.erase(this->size_x.begin() + index);
+    this->size_y.erase(this->size_y.begin() + index);
+    this->width.erase(this->width.begin() + index);
+    this->height.erase(this->height.begin() + index);
+    this->names.erase(this->names.begin() + index);
+    this->icons.erase(this->icons.begin() + index);
+    this->layouts.erase(this->layouts.begin() + index);
+    this->extras.erase(this->extras.begin() + index);
+    this->grid.Remove(index);
+  }
+
+  /**
+   * Removes many sprites from the store in one pass.
+   * @param indices The indices of the sprites in ascending order.
+   */
+  void cSprite_Store::Remove_Sprites(std::vector<int>& indices) {
+    int sprite_count = this->Count();
+    int remove_count = indices.size();
+    int remove_index = 0;
+    int next_index = 0;
+    for (int index = 0; index < sprite_count; index++) {
+      if ((remove_index < remove_count) && (indices[remove_index] == index)) {
+        this->Release_Extra(this->extras[index]);
+        remove_index++;
+      }
+      else {
+        this->x[next_index] = this->x[index];
+        this->y[next_index] = this->y[index];
+        this->size_x[next_index] = this->size_x[index];
+        this->size_y[next_index] = this->size_y[index];
+        this->width[next_index] = this->width[index];
+        this->height[next_index] = this->height[index];
+        this->names[next_index] = this->names[index];
+        this->icons[next_index] = this->icons[index];
+        this->layouts[next_index] = this->layouts[index];
+        this->extras[next_index] = this->extras[index];
+        next_index++;
+      }
+    }
+    this->x.resize(next_index);
+    this->y.resize(next_index);
+    this->size_x.resize(next_index);
+    this->size_y.resize(next_index);
+    this->width.resize(next_index);
+    this->height.resize(next_index);
+    this->names.resize(next_index);
+    this->icons.resize(next_index);
+    this->layouts.resize(next_index);
+    this->extras.resize(next_index);
+    this->grid.Remove_Sprites(indices);
+  }
+
+  /**
+   * Inserts sprites at given places. Sprites already in the store move up to
+   * make room, in one pass from the end.
+   * @param indices The indices the sprites will have, in ascending order.
+   * @param records The sprites to insert.
+   * @param source The store whose layouts the records refer to.
+   */
+  void cSprite_Store::Insert_Records(std::vector<int>& indices, std::vector<sSprite_Record>& records, cSprite_Store& source) {
+    int insert_count = indices.size();
+    int old_count = this->Count();
+    int new_count = old_count + insert_count;
+    this->x.resize(new_count);
+    this->y.resize(new_count);
+    this->size_x.resize(new_count);
+    this->size_y.resize(new_count);
+    this->width.resize(new_count);
+    this->height.resize(new_count);
+    this->names.resize(new_count);
+    this->icons.resize(new_count);
+    this->layouts.resize(new_count);
+    this->extras.resize(new_count);
+    int read_index = old_count - 1;
+    int insert_index = insert_count - 1;
+    for (int index = new_count - 1; index >= 0; index--) {
+      if ((insert_index >= 0) && (indices[insert_index] == index)) {
+        sSprite_Record& record = records[insert_index];
+        this->x[index] = record.x;
+        this->y[index] = record.y;
+        this->size_x[index] = record.size_x;
+        this->size_y[index] = record.size_y;
+        this->width[index] = this->images->Get(record.icon).width;
+        this->height[index] = this->images->Get(record.icon).height;
+        this->names[index] = record.name;
+        this->icons[index] = record.icon;
+        this->layouts[index] = (&source == this) ? record.layout : this->Find_Layout(source.layout_table[record.layout]);
+        this->extras[index] = this->Store_Extra(&record.extra);
+        insert_index--;
+      }
+      else {
+        this->x[index] = this->x[read_index];
+        this->y[index] = this->y[read_index];
+        this->size_x[index] = this->size_x[read_index];
+        this->size_y[index] = this->size_y[read_index];
+        this->width[index] = this->width[read_index];
+        this->height[index] = this->height[read_index];
+        this->names[index] = this->names[read_index];
+        this->icons[index] = this->icons[read_index];
+        this->layouts[index] = this->layouts[read_index];
+        this->extras[index] = this->extras[read_index];
+        read_index--;
+      }
+    }
+    std::vector<sRectangle> bounds;
+    for (int insert_index = 0; insert_index < insert_count; insert_index++) {
+      bounds.push_back(this->Get_Bounds(indices[insert_index]));
+    }
+    this->grid.Insert_Sprites(indices, bounds);
+  }
+
+  /**
+   * Gets the resolved fields of a sprite so it can be put back later.
+   * @param index The index of the sprite.
+   * @return The record of the sprite.
+   */
+  sSprite_Record cSprite_Store::Get_Record(int index) {
+    sSprite_Record record;
+    record.name = this->names[index];
+    record.icon = this->icons[index];
+    record.x = this->x[index];
+    record.y = this->y[index];
+    record.size_x = this->size_x[index];
+    record.size_y = this->size_y[index];
+    record.layout = this->layouts[index];
+    if (this->extras[index] != NO_VALUE_FOUND) {
+      record.extra = *this->extra_table[this->extras[index]];
+    }
+    return record;
+  }
+
+  /**
+   * Resolves a sprite object into a record for this store.
+   * @param sprite The sprite object.
+   * @return The record of the sprite.
+   */
+  sSprite_Record cSprite_Store::Make_Record(tObject& sprite) {
+    sSprite_Record record;
+    std::vector<std::string> keys;
+    int prop_count = sprite.Count();
+    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+      std::string key = sprite.keys[prop_index];
+      keys.push_back(key);
+      if (!this->Is_Typed_Key(key)) {
+        record.extra[key] = sprite[key];
+      }
+    }
+    record.name = this->strings->Intern(sprite["name"].string);
+    record.icon = this->images->Resolve(sprite["icon"].string);
+    record.x = sprite["x"].number;
+    record.y = sprite["y"].number;
+    record.size_x = sprite["size-x"].number;
+    record.size_y = sprite["size-y"].number;
+    record.layout = this->Find_Layout(keys);
+    return record;
+  }
+
+  /**
+   * Copies the sprites of another store without its grid. Only the arrays
+   * that saving reads are copied, so the copy can not have sets of extra
+   * properties interned into it. The sets themselves are shared since a set
+   * is never changed once it is stored.
+   * @param other The store to copy from.
+   */
+  void cSprite_Store::Copy_Sprites(cSprite_Store& other) {
+    this->x = other.x;
+    this->y = other.y;
+    this->size_x = other.size_x;
+    this->size_y = other.size_y;
+    this->width = other.width;
+    this->height = other.height;
+    this->names = other.names;
+    this->icons = other.icons;
+    this->layouts = other.layouts;
+    this->extras = other.extras;
+    this->layout_table = other.layout_table;
+    this->extra_table = other.extra_table;
+  }
+
+  /**
+   * Rebuilds the sprite object with its properties in their original order.
+   * @param index The index of the sprite.
+   * @return The sprite object.
+   */
+  tObject cSprite_Store::Get_Object(int index) {
+    tObject sprite;
+    std::vector<std::string>& keys = this->layout_table[this->layouts[index]];
+    int key_count = keys.size();
+    for (int key_index = 0; key_index < key_count; key_index++) {
+      std::string key = keys[key_index];
+      if (key == "name") {
+        sprite[key].Set_String(this->strings->Get(this->names[index]));
+      }
+      else if (key == "x") {
+        sprite[key].Set_Number(this->x[index]);
+      }
+      else if (key == "y") {
+        sprite[key].Set_Number(this->y[index]);
+      }
+      else if (key == "size-x") {
+        sprite[key].Set_Number(this->size_x[index]);
+      }
+      else if (key == "size-y") {
+        sprite[key].Set_Number(this->size_y[index]);
+      }
+      else if (key == "icon") {
+        sprite[key].Set_String(this->images->Get(this->icons[index]).name);
+      }
+      else if (key == "layer") {
+        sprite[key].Set_String(this->layer);
+      }
+      else {
+        sprite[key] = (*this->extra_table[this->extras[index]])[key];
+      }
+    }
+    return sprite;
+  }
+
+  /**
+   * Gets the bounds of a sprite including all of its tiles.
+   * @param index The index of the sprite.
+   * @return The bounds of the sprite in level coordinates.
+   */
+  sRectangle cSprite_Store::Get_Bounds(int index) {
+    sRectangle bounds;
+    bounds.left = this->x[index];
+    bounds.top = this->y[index];
+    bounds.right = bounds.left + std::max(this->width[index] * this->size_x[index], 1) - 1; // Sprites without an image still cover their position.
+    bounds.bottom = bounds.top + std::max(this->height[index] * this->size_y[index], 1) - 1;
+    return bounds;
+  }
+
+  /**
+   * Updates the grid after a sprite was moved or resized.
+   * @param index The index of the sprite.
+   */
+  void cSprite_Store::Update_Bounds(int index) {
+    this->grid.Update(index, this->Get_Bounds(index));
+  }
+
+  /**
+   * Determines if a sprite has an extra property.
+   * @param index The index of the sprite.
+   * @param key The name of the property.
+   * @return True if the property exists, false otherwise.
+   */
+  bool cSprite_Store::Has_Property(int index, std::string key) {
+    bool has_property = false;
+    if (this->extras[index] != NO_VALUE_FOUND) {
+      has_property = this->extra_table[this->extras[index]]->Does_Key_Exist(key);
+    }
+    return has_property;
+  }
+
+  /**
+   * Gets an extra property of a sprite. The value is shared with other
+   * sprites so it must only be changed through Set_Property.
+   * @param index The index of the sprite.
+   * @param key The name of the property.
+   * @return The value of the property.
+   * @throws An error if the property does not exist.
+   */
+  cValue& cSprite_Store::Get_Property(int index, std::string key) {
+    Check_Condition(this->Has_Property(index, key), "Sprite has no property " + key + ".");
+    return (*this->extra_table[this->extras[index]])[key];
+  }
+
+  /**
+   * Sets an extra property of a sprite, adding it if it is new.
+   * @param index The index of the sprite.
+   * @param key The name of the property.
+   * @param value The value of the property.
+   * @throws An error if the property is one of the typed properties.
+   */
+  void cSprite_Store::Set_Property(int index, std::string key, cValue value) {
+    Check_Condition(!this->Is_Typed_Key(key), "Property " + key + " cannot be set as an extra property.");
+    tObject extra;
+    if (this->extras[index] != NO_VALUE_FOUND) {
+      extra = *this->extra_table[this->extras[index]];
+    }
+    if (!extra.Does_Key_Exist(key)) {
+      std::vector<std::string> keys = this->layout_table[this->layouts[index]];
+      keys.push_back(key);
+      this->layouts[index] = this->Find_Layout(keys);
+    }
+    extra[key] = value;
+    this->Release_Extra(this->extras[index]);
+    this->extras[index] = this->Store_Extra(&extra);
+  }
+
+  /**
+   * Removes an extra property from a sprite.
+   * @param index The index of the sprite.
+   * @param key The name of the property.
+   */
+  void cSprite_Store::Remove_Property(int index, std::string key) {
+    if (this->Has_Property(index, key)) {
+      tObject& extra = *this->extra_table[this->extras[index]];
+      tObject kept;
+      int prop_count = extra.Count();
+      for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+        if (extra.keys[prop_index] != key) {
+          kept[extra.keys[prop_index]] = extra[extra.keys[prop_index]];
+        }
+      }
+      this->Release_Extra(this->extras[index]);
+      this->extras[index] = this->Store_Extra(&kept);
+      std::vector<std::string> keys = this->layout_table[this->layouts[index]];
+      keys.erase(std::find(keys.begin(), keys.end(), key));
+      this->layouts[index] = this->Find_Layout(keys);
+    }
+  }
+
+  /**
+   * Gets the number of sprites in the store.
+   * @return The number of sprites.
+   */
+  int cSprite_Store::Count() {
+    return this->x.size();
+  }
+
+  /**
+   * Clears out all sprites in the store.
+   */
+  void cSprite_Store::Clear() {
+    this->x.clear();
+    this->y.clear();
+    this->size_x.clear();
+    this->size_y.clear();
+    this->width.clear();
+    this->height.clear();
+    this->names.clear();
+    this->icons.clear();
+    this->layouts.clear();
+    this->extras.clear();
+    this->layout_table.clear();
+    this->extra_table.clear();
+    this->extra_refs.clear();
+    this->free_extras.clear();
+    this->extra_ids.clear();
+    this->grid.Clear();
+  }
+
+  /**
+   * Reserves room for sprites so a large load does not grow the arrays
+   * again and again.
+   * @param count The number of sprites to make room for.
+   */
+  void cSprite_Store::Reserve(int count) {
+    this->x.reserve(count);
+    this->y.reserve(count);
+    this->size_x.reserve(count);
+    this->size_y.reserve(count);
+    this->width.reserve(count);
+    this->height.reserve(count);
+    this->names.reserve(count);
+    this->icons.reserve(count);
+    this->layouts.reserve(count);
+    this->extras.reserve(count);
+    this->grid.bounds.reserve(count);
+  }
+
+  /**
+   * Determines if a property is stored in the typed arrays.
+   * @param key The name of the property.
+   * @return True if the property is typed, false otherwise.
+   */
+  bool cSprite_Store::Is_Typed_Key(std::string key) {
+    return ((key == "name") || (key == "x") || (key == "y") || (key == "size-x") || (key == "size-y") || (key == "icon") || (key == "layer"));
+  }
+
+  /**
+   * Finds the layout for an order of property names, adding it if new. Only a
+   * handful of layouts exist per level so they are shared between sprites.
+   * @param keys The property names in order.
+   * @return The index of the layout.
+   */
+  int cSprite_Store::Find_Layout(std::vector<std::string>& keys) {
+    int layout = NO_VALUE_FOUND;
+    int layout_count = this->layout_table.size();
+    for (int layout_index = 0; layout_index < layout_count; layout_index++) {
+      if (this->layout_table[layout_index] == keys) {
+        layout = layout_index;
+        break;
+      }
+    }
+    if (layout == NO_VALUE_FOUND) {
+      layout = layout_count;
+      this->layout_table.push_back(keys);
+    }
+    return layout;
+  }
+
+}
+
+// ****************************************************************************
+// String Table
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Interns a string so it can be referred to by an ID.
+   * @param text The string to intern.
+   * @return The ID of the string.
+   */
+  int cString_Table::Intern(std::string text) {
+    int id = this->Find(text);
+    if (id == NO_VALUE_FOUND) {
+      id = this->strings.size();
+      this->strings.push_back(text);
+      this->ids[text] = id;
+    }
+    return id;
+  }
+
+  /**
+   * Finds the ID of an interned string.
+   * @param text The string to find.
+   * @return The ID of the string or NO_VALUE_FOUND if it was not interned.
+   */
+  int cString_Table::Find(std::string text) {
+    int id = NO_VALUE_FOUND;
+    std::unordered_map<std::string, int>::iterator entry = this->ids.find(text);
+    if (entry != this->ids.end()) {
+      id = entry->second;
+    }
+    return id;
+  }
+
+  /**
+   * Rebuilds the IDs of the strings for a table whose strings were copied
+   * without them.
+   */
+  void cString_Table::Index() {
+    int string_count = this->strings.size();
+    this->ids.clear();
+    for (int string_index = 0; string_index < string_count; string_index++) {
+      this->ids[this->strings[string_index]] = string_index;
+    }
+  }
+
+  /**
+   * Gets an interned string by ID.
+   * @param id The ID of the string.
+   * @return The string.
+   */
+  std::string& cString_Table::Get(int id) {
+    return this->strings[id];
+  }
+
+  /**
+   * Gets the number of strings interned.
+   * @return The number of strings.
+   */
+  int cString_Table::Count() {
+    return this->strings.size();
+  }
+
+}
+
+// ****************************************************************************
+// Image Table
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates an empty image table.
+   */
+  cImage_Table::cImage_Table() {
+    this->io = NULL;
+    this->file_sizes = NULL;
+  }
+
+  /**
+   * Creates an image table.
+   * @param io The I/O control that holds the images.
+   */
+  cImage_Table::cImage_Table(cIO_Control* io) {
+    this->io = io;
+    this->file_sizes = NULL;
+  }
+
+  /**
+   * Resolves an image to a handle. The size of the image is looked up once
+   * when it is first resolved. Without an I/O control the size is read from
+   * the image file if file sizes are kept.
+   * @param name The name of the image.
+   * @return The handle of the image.
+   */
+  int cImage_Table::Resolve(std::string name) {
+    int handle = this->names.Find(name);
+    if (handle == NO_VALUE_FOUND) {
+      sImage image;
+      image.name = name;
+      image.width = 0;
+      image.height = 0;
+      if (this->io) { // Tools that work without a display have no images.
+        image.width = this->io->Get_Image_Width(name);
+        image.height = this->io->Get_Image_Height(name);
+      }
+      else if (this->file_sizes) {
+        sImage& file_image = Get_File_Image(*this->file_sizes, name);
+        image.width = file_image.width;
+        image.height = file_image.height;
+      }
+      handle = this->names.Intern(name);
+      this->images.push_back(image);
+    }
+    return handle;
+  }
+
+  /**
+   * Gets an image by handle.
+   * @param handle The handle of the image.
+   * @return The image.
+   */
+  sImage& cImage_Table::Get(int handle) {
+    return this->images[handle];
+  }
+
+  /**
+   * Gets the number of images resolved.
+   * @return The number of images.
+   */
+  int cImage_Table::Count() {
+    return this->images.size();
+  }
+
+}
+
+// ****************************************************************************
+// Level
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates an empty level.
+   */
+  cLevel::cLevel() {
+    this->format = eLEVEL_TEXT;
+    this->generation = 0;
+    this->journal = NULL;
+    this->history = NULL;
+  }
+
+  /**
+   * Sets up the layers of the level. This must be done before loading.
+   * @param layers The names of the layers from lowest to highest.
+   * @param io The I/O control used to size icons or NULL for tools.
+   * @throws An error if there are no layers.
+   */
+  void cLevel::Setup(cArray<std::string> layers, cIO_Control* io) {
+    this->images = cImage_Table(io);
+    int layer_count = layers.Count();
+    Check_Condition((layer_count > 0), "No layers defined!");
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      std::string layer = layers[layer_index];
+      this->layer_names.Intern(layer); // Layer IDs are the same as their index.
+      this->layers.push_back(cSprite_Store(layer, &this->strings, &this->images));
+    }
+  }
+
+  /**
+   * Finds a layer by name.
+   * @param name The name of the layer.
+   * @return The index of the layer or NO_VALUE_FOUND if there is no such layer.
+   */
+  int cLevel::Find_Layer(std::string name) {
+    return this->layer_names.Find(name);
+  }
+
+  /**
+   * Checks that a sprite has all of the required properties.
+   * @param sprite The sprite to check.
+   * @throws An error if a property is missing.
+   */
+  void cLevel::Check_Sprite(tObject& sprite) {
+    Check_Condition(sprite.Does_Key_Exist("name"), "No sprite name present.");
+    Check_Condition(sprite.Does_Key_Exist("layer"), "No layer present.");
+    Check_Condition(sprite.Does_Key_Exist("x"), "No x coordinate.");
+    Check_Condition(sprite.Does_Key_Exist("y"), "No y coordinate.");
+    Check_Condition(sprite.Does_Key_Exist("size-x"), "No size x specifier.");
+    Check_Condition(sprite.Does_Key_Exist("size-y"), "No size y specifier.");
+    Check_Condition(sprite.Does_Key_Exist("icon"), "No icon present.");
+  }
+
+  /**
+   * Destars starred sprite properties. The object catalog stars the
+   * properties of palette sprites.
+   * @param sprite The sprite properties to destar.
+   * @throws An error if a property has no name.
+   */
+  void Destar_Sprite(tObject& sprite) {
+    int prop_count = sprite.Count();
+    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+      Check_Condition((sprite.keys[prop_index].length() > 0), "Key is NULL.");
+      if (sprite.keys[prop_index][0] == '*') {
+        sprite.keys[prop_index] = sprite.keys[prop_index].substr(1); // Destar the key.
+      }
+    }
+  }
+
+  /**
+   * Loads the sprite palette as templates for the sprites of the level.
+   * @param palette The name of the sprite palette.
+   * @throws An error if the palette could not be read.
+   */
+  void cLevel::Load_Templates(std::string palette) {
+    cFile palette_file(palette + ".txt");
+    palette_file.Read();
+    while (palette_file.Has_More_Lines()) {
+      palette_file.Get_Line(); // Sprite type.
+      tObject sprite;
+      palette_file >>= sprite;
+      Destar_Sprite(sprite);
+      this->Add_Template(sprite);
+    }
+  }
+
+  /**
+   * Adds a palette sprite as a template. Text levels write a sprite made
+   * from a template as the template name and the properties that differ from
+   * it, and fill in the rest from the template when they are loaded. Sprites
+   * without all of the properties or on a layer the level does not have are
+   * not used as templates.
+   * @param sprite The destarred palette sprite.
+   * @throws An error if a typed property has a value of the wrong type.
+   */
+  void cLevel::Add_Template(tObject& sprite) {
+    sText_Sprite prototype;
+    std::string layer;
+    int found = 0;
+    int prop_count = sprite.Count();
+    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+      std::string key = sprite.keys[prop_index];
+      this->Apply_Text_Property(prototype, layer, found, key, sprite[key]);
+    }
+    prototype.layer = this->Find_Layer(layer);
+    if ((found == 127) && (prototype.layer != NO_VALUE_FOUND) && (this->Find_Template(prototype.name) == NO_VALUE_FOUND)) {
+      this->template_ids[prototype.name] = this->templates.size();
+      this->templates.push_back(prototype);
+    }
+  }
+
+  /**
+   * Finds the template for a sprite name.
+   * @param name The name of the sprite.
+   * @return The index of the template or NO_VALUE_FOUND if there is none.
+   */
+  int cLevel::Find_Template(std::string name) {
+    int template_index = NO_VALUE_FOUND;
+    std::unordered_map<std::string, int>::iterator entry = this->template_ids.find(name);
+    if (entry != this->template_ids.end()) {
+      template_index = entry->second;
+    }
+    return template_index;
+  }
+
+  /**
+   * Loads a level. The format is detected from the start of the file.
+   * @param name The name of the level file.
+   * @throws An error if the level could not be loaded.
+   */
+  void cLevel::Load(std::string name) {
+    this->Clear();
+    if (this->Is_Binary(name)) {
+      this->Load_Binary(name);
+    }
+    else {
+      this->Load_Text(name);
+    }
+  }
+
+  /**
+   * Saves a level in the format it was loaded in. The level is written to a
+   * temporary file first and then swapped in so that a crash never leaves a
+   * partial level behind.
+   * @param name The name of the level file.
+   * @throws An error if the level could not be saved.
+   */
+  void cLevel::Save(std::string name) {
+    std::string temp_name = name + ".tmp";
+    if (this->format == eLEVEL_BINARY) {
+      this->Save_Binary(temp_name);
+    }
+    else {
+      this->Save_Text(temp_name);
+    }
+    this->Replace_File(temp_name, name);
+  }
+
+  /**
+   * Loads a level from the text format. The file is read in one piece and
+   * cut into chunks at object lines. The chunks are parsed on their own
+   * threads and then added to the layers in file order.
+   * @param name The name of the level file.
+   * @throws An error if the level could not be loaded.
+   */
+  void cLevel::Load_Text(std::string name) {
+    cMapped_File file(name);
+    this->format = eLEVEL_TEXT;
+    int offset = 0;
+    tObject meta_data;
+    Check_Condition(this->Parse_Text_Object(file.data, file.size, offset, meta_data), "No level properties in " + name + ".");
+    Check_Condition(meta_data.Does_Key_Exist("background"), "No background property.");
+    this->background = meta_data["background"].string;
+    Check_Condition(meta_data.Does_Key_Exist("music-track"), "No music track property.");
+    this->music_track = meta_data["music-track"].string;
+    // Cut the rest of the file into chunks.
+    int body_size = file.size - offset;
+    int chunk_count = std::max(std::min((int)std::thread::hardware_concurrency(), body_size / TEXT_PARSE_MIN), 1);
+    std::vector<sText_Chunk> chunks(chunk_count);
+    for (int chunk_index = 0; chunk_index < chunk_count; chunk_index++) {
+      int start = offset + (int)(((long long)body_size * chunk_index) / chunk_count);
+      chunks[chunk_index].start = (chunk_index == 0) ? offset : this->Find_Object_Line(file.data, file.size, start);
+    }
+    for (int chunk_index = 0; chunk_index < chunk_count; chunk_index++) {
+      chunks[chunk_index].end = (chunk_index < (chunk_count - 1)) ? chunks[chunk_index + 1].start : file.size;
+    }
+    std::vector<std::thread> threads;
+    for (int chunk_index = 1; chunk_index < chunk_count; chunk_index++) {
+      threads.push_back(std::thread(&cLevel::Parse_Text_Chunk, this, file.data, &chunks[chunk_index]));
+    }
+    this->Parse_Text_Chunk(file.data, &chunks[0]);
+    int thread_count = threads.size();
+    for (int thread_index = 0; thread_index < thread_count; thread_index++) {
+      threads[thread_index].join();
+    }
+    // Size the layers and add the sprites in file order.
+    int layer_count = this->layers.size();
+    std::vector<int> sprite_counts(layer_count, 0);
+    for (int chunk_index = 0; chunk_index < chunk_count; chunk_index++) {
+      sText_Chunk& chunk = chunks[chunk_index];
+      Check_Condition((chunk.error.length() == 0), chunk.error);
+      int sprite_count = chunk.sprites.size();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        sprite_counts[chunk.sprites[sprite_index].layer]++;
+      }
+    }
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      this->layers[layer_index].Reserve(this->layers[layer_index].Count() + sprite_counts[layer_index]);
+    }
+    for (int chunk_index = 0; chunk_index < chunk_count; chunk_index++) {
+      std::vector<sText_Sprite>& sprites = chunks[chunk_index].sprites;
+      int sprite_count = sprites.size();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        sText_Sprite& sprite = sprites[sprite_index];
+        cSprite_Store& store = this->layers[sprite.layer];
+        store.Append(this->strings.Intern(sprite.name), this->images.Resolve(sprite.icon), sprite.x, sprite.y, sprite.size_x, sprite.size_y, store.Find_Layout(sprite.keys), &sprite.extra);
+      }
+      sprites.clear(); // Free the chunk as we go.
+    }
+  }
+
+  /**
+   * Saves a level in the text format. The sprites are cut into slices that
+   * are formatted on their own threads, and the slices are written out in
+   * order with one write. Sprites made from a template only write what they
+   * change.
+   * @param name The name of the level file.
+   * @throws An error if the file could not be written.
+   */
+  void cLevel::Save_Text(std::string name) {
+    std::vector<int> name_templates(this->strings.Count(), NO_VALUE_FOUND);
+    int template_count = this->templates.size();
+    for (int template_index = 0; template_index < template_count; template_index++) {
+      int name_id = this->strings.Find(this->templates[template_index].name);
+      if (name_id != NO_VALUE_FOUND) {
+        name_templates[name_id] = template_index;
+      }
+    }
+    std::vector<sText_Slice> slices;
+    int layer_count = this->layers.size();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      int sprite_count = this->layers[layer_index].Count();
+      for (int first = 0; first < sprite_count; first += TEXT_SLICE_SIZE) {
+        sText_Slice slice;
+        slice.layer = layer_index;
+        slice.first = first;
+        slice.count = std::min(TEXT_SLICE_SIZE, sprite_count - first);
+        slices.push_back(slice);
+      }
+    }
+    std::atomic<int> next_slice(0);
+    int slice_count = slices.size();
+    int thread_count = std::max(std::min((int)std::thread::hardware_concurrency(), slice_count), 1);
+    std::vector<std::thread> threads;
+    for (int thread_index = 1; thread_index < thread_count; thread_index++) {
+      threads.push_back(std::thread(&cLevel::Format_Text_Worker, this, &slices, &next_slice, &name_templates));
+    }
+    this->Format_Text_Worker(&slices, &next_slice, &name_templates);
+    for (int thread_index = 0; thread_index < (int)threads.size(); thread_index++) {
+      threads[thread_index].join();
+    }
+    std::string buffer = "object\nbackground=" + this->background + "\nmusic-track=" + this->music_track + "\nend\n";
+    size_t buffer_size = buffer.size();
+    for (int slice_index = 0; slice_index < slice_count; slice_index++) {
+      buffer_size += slices[slice_index].text.size();
+    }
+    buffer.reserve(buffer_size);
+    for (int slice_index = 0; slice_index < slice_count; slice_index++) {
+      buffer.append(slices[slice_index].text);
+      std::string().swap(slices[slice_index].text);
+    }
+    std::ofstream level_file(name.c_str(), std::ios::binary | std::ios::trunc);
+    Check_Condition(level_file.is_open(), "Could not write " + name + ".");
+    level_file.write(buffer.data(), buffer.size());
+    Check_Condition(level_file.good(), "Could not write " + name + ".");
+  }
+
+  /**
+   * Finds the first object line at or after an offset.
+   * @param data The text of the level.
+   * @param size The size of the text.
+   * @param offset The offset to start looking from.
+   * @return The offset of the object line or the size of the text if there is none.
+   */
+  int cLevel::Find_Object_Line(const char* data, int size, int offset) {
+    while ((offset > 0) && (offset < size) && (data[offset - 1] != '\n')) { // Go to the start of a line.
+      offset++;
+    }
+    while (offset < size) {
+      const char* line_end = (const char*)std::memchr(data + offset, '\n', size - offset);
+      int end = line_end ? (line_end - data) : size;
+      int length = end - offset;
+      if ((length > 0) && (data[end - 1] == '\r')) {
+        length--;
+      }
+      if ((length == 6) && (std::memcmp(data + offset, "object", 6) == 0)) {
+        break;
+      }
+      offset = line_end ? (end + 1) : size;
+    }
+    return std::min(offset, size);
+  }
+
+  /**
+   * Parses the sprites in a chunk of a text level. The sprites are read
+   * straight into their parts with the same checks as loading an object.
+   * Errors are kept with the chunk so the loader can report the first one.
+   * @param data The text of the level.
+   * @param chunk The chunk to parse.
+   */
+  void cLevel::Parse_Text_Chunk(const char* data, sText_Chunk* chunk) {
+    try {
+      chunk->sprites.reserve((chunk->end - chunk->start) / 96); // About the size of a sprite with no extra properties.
+      int offset = chunk->start;
+      std::string line;
+      std::string key;
+      cValue value;
+      while (this->Read_Text_Line(data, chunk->end, offset, line)) {
+        if (line.length() > 0) { // Blank lines are skipped.
+          Check_Condition((line == "object"), "Expected object but found " + line + ".");
+          chunk->sprites.push_back(sText_Sprite());
+          sText_Sprite& sprite = chunk->sprites.back();
+          std::string layer;
+          int found = 0; // One bit for each typed property.
+          bool ended = false;
+          while (!ended && this->Read_Text_Line(data, chunk->end, offset, line)) {
+            if (line == "end") {
+              ended = true;
+            }
+            else {
+              this->Parse_Text_Property(line, key, value);
+              if (key == "template") { // Start from the template and override it.
+                int template_index = this->Find_Template(value.string);
+                Check_Condition((template_index != NO_VALUE_FOUND), "Template " + value.string + " is not in the palette.");
+                Check_Condition((sprite.keys.size() == 0), "Template " + value.string + " must come first.");
+                sprite = this->templates[template_index];
+                layer = this->layer_names.Get(sprite.layer);
+                found = 127;
+              }
+              else {
+                this->Apply_Text_Property(sprite, layer, found, key, value);
+              }
+            }
+          }
+          Check_Condition(ended, "Object has no end.");
+          Check_Condition((found & 1), "No sprite name present.");
+          Check_Condition((found & 2), "No layer present.");
+          Check_Condition((found & 4), "No x coordinate.");
+          Check_Condition((found & 8), "No y coordinate.");
+          Check_Condition((found & 16), "No size x specifier.");
+          Check_Condition((found & 32), "No size y specifier.");
+          Check_Condition((found & 64), "No icon present.");
+          sprite.layer = this->Find_Layer(layer);
+          Check_Condition((sprite.layer != NO_VALUE_FOUND), "Layer " + layer + " does not exist in layers.");
+        }
+      }
+    }
+    catch (cError error) {
+      chunk->error = error.message;
+    }
+  }
+
+  /**
+   * Puts a property of a text level into the parts of a sprite.
+   * @param sprite The sprite to fill in.
+   * @param layer The name of the layer. It is set by the layer property.
+   * @param found One bit for each typed property that was found.
+   * @param key The name of the property.
+   * @param value The value of the property.
+   * @throws An error if a typed property has a value of the wrong type.
+   */
+  void cLevel::Apply_Text_Property(sText_Sprite& sprite, std::string& layer, int& found, std::string& key, cValue& value) {
+    if (std::find(sprite.keys.begin(), sprite.keys.end(), key) == sprite.keys.end()) {
+      sprite.keys.push_back(key);
+    }
+    if (key == "name") {
+      Check_Condition((value.type == eVALUE_STRING), "No sprite name present.");
+      sprite.name = value.string;
+      found |= 1;
+    }
+    else if (key == "layer") {
+      Check_Condition((value.type == eVALUE_STRING), "No layer present.");
+      layer = value.string;
+      found |= 2;
+    }
+    else if (key == "x") {
+      Check_Condition((value.type == eVALUE_NUMBER), "No x coordinate.");
+      sprite.x = value.number;
+      found |= 4;
+    }
+    else if (key == "y") {
+      Check_Condition((value.type == eVALUE_NUMBER), "No y coordinate.");
+      sprite.y = value.number;
+      found |= 8;
+    }
+    else if (key == "size-x") {
+      Check_Condition((value.type == eVALUE_NUMBER), "No size x specifier.");
+      sprite.size_x = value.number;
+      found |= 16;
+    }
+    else if (key == "size-y") {
+      Check_Condition((value.type == eVALUE_NUMBER), "No size y specifier.");
+      sprite.size_y = value.number;
+      found |= 32;
+    }
+    else if (key == "icon") {
+      Check_Condition((value.type == eVALUE_STRING), "No icon present.");
+      sprite.icon = value.string;
+      found |= 64;
+    }
+    else {
+      sprite.extra[key] = value;
+    }
+  }
+
+  /**
+   * Parses the next object in a text level. Blank lines between objects are
+   * skipped.
+   * @param data The text of the level.
+   * @param end The offset to stop parsing at.
+   * @param offset The offset to parse from. It is moved past the object.
+   * @param object The object to fill in.
+   * @return True if an object was parsed or false if there are no more objects.
+   * @throws An error if the object is not well formed.
+   */
+  bool cLevel::Parse_Text_Object(const char* data, int end, int& offset, tObject& object) {
+    std::string line;
+    bool in_object = false;
+    bool found = false;
+    while (!found && this->Read_Text_Line(data, end, offset, line)) {
+      if (!in_object) {
+        if (line.length() > 0) {
+          Check_Condition((line == "object"), "Expected object but found " + line + ".");
+          in_object = true;
+        }
+      }
+      else if (line == "end") {
+        found = true;
+      }
+      else {
+        std::string key;
+        cValue value;
+        this->Parse_Text_Property(line, key, value);
+        object[key] = value;
+      }
+    }
+    Check_Condition((found || !in_object), "Object has no end.");
+    return found;
+  }
+
+  /**
+   * Reads a line of a text level.
+   * @param data The text of the level.
+   * @param end The offset to stop reading at.
+   * @param offset The offset of the line. It is moved to the next line.
+   * @param line The line without its line ending.
+   * @return True if a line was read or false if the end was reached.
+   */
+  bool cLevel::Read_Text_Line(const char* data, int end, int& offset, std::string& line) {
+    bool read = (offset < end);
+    if (read) {
+      const char* line_end = (const char*)std::memchr(data + offset, '\n', end - offset);
+      int line_stop = line_end ? (line_end - data) : end;
+      int length = line_stop - offset;
+      if ((length > 0) && (data[line_stop - 1] == '\r')) {
+        length--;
+      }
+      line.assign(data + offset, length);
+      offset = line_end ? (line_stop + 1) : end;
+    }
+    return read;
+  }
+
+  /**
+   * Parses a property line of a text level. Values that are plain decimals,
+   * an optional sign then digits with an optional fraction, are numbers and
+   * everything else is text. Words like inf and nan and hex stay text.
+   * @param line The line of the form key=value.
+   * @param key The name of the property.
+   * @param value The value of the property.
+   * @throws An error if the line has no value.
+   */
+  void cLevel::Parse_Text_Property(std::string& line, std::string& key, cValue& value) {
+    std::string::size_type equals = line.find('=');
+    Check_Condition((equals != std::string::npos), "Property " + line + " has no value.");
+    key.assign(line, 0, equals);
+    value = cValue();
+    const char* text = line.c_str() + equals + 1;
+    const char* digits = ((*text == '-') || (*text == '+')) ? (text + 1) : text;
+    const char* fraction = digits;
+    while ((*fraction >= '0') && (*fraction <= '9')) {
+      fraction++;
+    }
+    const char* end = fraction;
+    if ((*fraction == '.') && (fraction[1] >= '0') && (fraction[1] <= '9')) {
+      end = fraction + 1;
+      while ((*end >= '0') && (*end <= '9')) {
+        end++;
+      }
+    }
+    if ((fraction > digits) && (*end == '\0')) {
+      value.Set_Number(std::strtod(text, NULL));
+    }
+    else {
+      value.Set_String(text);
+    }
+  }
+
+  /**
+   * Formats slices of sprites as text until no slices are left. A sprite
+   * whose properties start with those of its template, in the same order, is
+   * written as the template and the values that differ so that it loads back
+   * the same.
+   * @param slices The slices to format.
+   * @param next_slice The next slice to claim.
+   * @param name_templates The template for each sprite name or NO_VALUE_FOUND.
+   */
+  void cLevel::Format_Text_Worker(std::vector<sText_Slice>* slices, std::atomic<int>* next_slice, std::vector<int>* name_templates) {
+    int slice_count = slices->size();
+    int slice_index = (*next_slice)++;
+    while (slice_index < slice_count) {
+      sText_Slice& slice = (*slices)[slice_index];
+      cSprite_Store& store = this->layers[slice.layer];
+      slice.text.reserve(slice.count * 128);
+      int last = slice.first + slice.count;
+      for (int sprite_index = slice.first; sprite_index < last; sprite_index++) {
+        std::vector<std::string>& keys = store.layout_table[store.layouts[sprite_index]];
+        int key_count = keys.size();
+        int template_index = (*name_templates)[store.names[sprite_index]];
+        int inherit_count = 0;
+        if (template_index != NO_VALUE_FOUND) {
+          std::vector<std::string>& template_keys = this->templates[template_index].keys;
+          if ((key_count >= (int)template_keys.size()) && std::equal(template_keys.begin(), template_keys.end(), keys.begin())) {
+            inherit_count = template_keys.size();
+          }
+        }
+        slice.text += "object\n";
+        if (inherit_count > 0) {
+          slice.text += "template=";
+          slice.text += this->templates[template_index].name;
+          slice.text += '\n';
+        }
+        for (int key_index = 0; key_index < key_count; key_index++) {
+          std::string& key = keys[key_index];
+          bool inherited = ((key_index < inherit_count) && this->Is_Template_Value(this->templates[template_index], store, sprite_index, key));
+          if (!inherited) {
+            slice.text += key;
+            slice.text += '=';
+            if (key == "name") {
+              slice.text += this->strings.Get(store.names[sprite_index]);
+            }
+            else if (key == "x") {
+              slice.text += Number_To_Text(store.x[sprite_index]);
+            }
+            else if (key == "y") {
+              slice.text += Number_To_Text(store.y[sprite_index]);
+            }
+            else if (key == "size-x") {
+              slice.text += Number_To_Text(store.size_x[sprite_index]);
+            }
+            else if (key == "size-y") {
+              slice.text += Number_To_Text(store.size_y[sprite_index]);
+            }
+            else if (key == "icon") {
+              slice.text += this->images.Get(store.icons[sprite_index]).name;
+            }
+            else if (key == "layer") {
+              slice.text += store.layer;
+            }
+            else {
+              slice.text += this->Format_Value((*store.extra_table[store.extras[sprite_index]])[key]);
+            }
+            slice.text += '\n';
+          }
+        }
+        slice.text += "end\n";
+      }
+      slice_index = (*next_slice)++;
+    }
+  }
+
+  /**
+   * Determines if a sprite has the same value for a property as its template.
+   * @param sprite The template.
+   * @param store The store of the sprite.
+   * @param index The index of the sprite.
+   * @param key The name of the property. Both the sprite and the template have it.
+   * @return True if the values are the same, false otherwise.
+   */
+  bool cLevel::Is_Template_Value(sText_Sprite& sprite, cSprite_Store& store, int index, std::string& key) {
+    bool same = false;
+    if (key == "name") {
+      same = (this->strings.Get(store.names[index]) == sprite.name);
+    }
+    else if (key == "x") {
+      same = (store.x[index] == sprite.x);
+    }
+    else if (key == "y") {
+      same = (store.y[index] == sprite.y);
+    }
+    else if (key == "size-x") {
+      same = (store.size_x[index] == sprite.size_x);
+    }
+    else if (key == "size-y") {
+      same = (store.size_y[index] == sprite.size_y);
+    }
+    else if (key == "icon") {
+      same = (this->images.Get(store.icons[index]).name == sprite.icon);
+    }
+    else if (key == "layer") {
+      same = (store.layer == this->layer_names.Get(sprite.layer));
+    }
+    else {
+      cValue& value = (*store.extra_table[store.extras[index]])[key];
+      cValue& template_value = sprite.extra[key];
+      same = ((value.type == template_value.type) && ((value.type == eVALUE_STRING) ? (value.string == template_value.string) : (value.number == template_value.number)));
+    }
+    return same;
+  }
+
+  /**
+   * Loads a level from the binary format. The file is mapped into memory and
+   * the sprite records are read straight into the layer stores. Only the
+   * string table and the few sprites with extra properties allocate.
+   * @param name The name of the level file.
+   * @throws An error if the level is not a valid binary level.
+   */
+  void cLevel::Load_Binary(std::string name) {
+    cMapped_File file(name);
+    this->format = eLEVEL_BINARY;
+    sLevel_Header header;
+    this->Read_Block(file, 0, &header, sizeof(sLevel_Header));
+    Check_Condition((std::string(header.magic, 4) == LEVEL_MAGIC), name + " is not a binary level.");
+    Check_Condition((header.version == LEVEL_VERSION), name + " has unsupported version " + Number_To_Text(header.version) + ".");
+    // Read the string table.
+    std::vector<std::string> table;
+    int offset = header.string_offset;
+    for (uint32_t string_index = 0; string_index < header.string_count; string_index++) {
+      uint32_t length = 0;
+      this->Read_Block(file, offset, &length, sizeof(uint32_t));
+      offset += sizeof(uint32_t);
+      Check_Condition(((offset + (int)length) <= file.size), "String table of " + name + " is corrupted.");
+      table.push_back(std::string(file.data + offset, length));
+      offset += length;
+    }
+    int string_count = table.size();
+    // Read the property layouts.
+    std::vector<std::vector<std::string> > layouts;
+    offset = header.layout_offset;
+    for (uint32_t layout_index = 0; layout_index < header.layout_count; layout_index++) {
+      uint32_t key_count = 0;
+      this->Read_Block(file, offset, &key_count, sizeof(uint32_t));
+      offset += sizeof(uint32_t);
+      std::vector<std::string> keys;
+      for (uint32_t key_index = 0; key_index < key_count; key_index++) {
+        uint32_t key = 0;
+        this->Read_Block(file, offset, &key, sizeof(uint32_t));
+        offset += sizeof(uint32_t);
+        Check_Condition(((int)key < string_count), "Layout table of " + name + " is corrupted.");
+        keys.push_back(table[key]);
+      }
+      layouts.push_back(keys);
+    }
+    Check_Condition((((int)header.background < string_count) && ((int)header.music_track < string_count)), "Header of " + name + " is corrupted.");
+    this->background = table[header.background];
+    this->music_track = table[header.music_track];
+    if (header.prop_size > 0) {
+      uint32_t prop_version = 0;
+      this->Read_Block(file, header.prop_offset, &prop_version, sizeof(uint32_t));
+      Check_Condition((prop_version == LEVEL_PROP_VERSION), name + " has unsupported property version " + Number_To_Text(prop_version) + ".");
+    }
+    // Read the sprites layer by layer.
+    std::vector<int> names(string_count, NO_VALUE_FOUND);
+    std::vector<int> icons(string_count, NO_VALUE_FOUND);
+    for (uint32_t layer_index = 0; layer_index < header.layer_count; layer_index++) {
+      sLevel_Layer entry;
+      this->Read_Block(file, header.layer_offset + (layer_index * sizeof(sLevel_Layer)), &entry, sizeof(sLevel_Layer));
+      Check_Condition(((int)entry.name < string_count), "Layer table of " + name + " is corrupted.");
+      int layer = this->Find_Layer(table[entry.name]);
+      Check_Condition((layer != NO_VALUE_FOUND), "Layer " + table[entry.name] + " does not exist in layers.");
+      cSprite_Store& store = this->layers[layer];
+      std::vector<int> layout_map(layouts.size(), NO_VALUE_FOUND);
+      std::unordered_map<uint32_t, tObject> extras;
+      for (uint32_t sprite_index = 0; sprite_index < entry.sprite_count; sprite_index++) {
+        sLevel_Sprite record;
+        this->Read_Block(file, entry.sprite_offset + (sprite_index * sizeof(sLevel_Sprite)), &record, sizeof(sLevel_Sprite));
+        Check_Condition((((int)record.name < string_count) && ((int)record.icon < string_count) && (record.layout < layouts.size())), "Sprite in " + name + " is corrupted.");
+        if (names[record.name] == NO_VALUE_FOUND) {
+          names[record.name] = this->strings.Intern(table[record.name]);
+        }
+        if (icons[record.icon] == NO_VALUE_FOUND) {
+          icons[record.icon] = this->images.Resolve(table[record.icon]);
+        }
+        if (layout_map[record.layout] == NO_VALUE_FOUND) {
+          layout_map[record.layout] = store.Find_Layout(layouts[record.layout]);
+        }
+        if (record.props == LEVEL_NO_PROPS) {
+          store.Append(names[record.name], icons[record.icon], record.x, record.y, record.size_x, record.size_y, layout_map[record.layout], NULL);
+        }
+        else if (extras.count(record.props) > 0) {
+          store.Append(names[record.name], icons[record.icon], record.x, record.y, record.size_x, record.size_y, layout_map[record.layout], &extras[record.props]);
+        }
+        else {
+          tObject& extra = extras[record.props];
+          int prop_offset = header.prop_offset + record.props;
+          uint32_t prop_count = 0;
+          this->Read_Block(file, prop_offset, &prop_count, sizeof(uint32_t));
+          prop_offset += sizeof(uint32_t);
+          for (uint32_t prop_index = 0; prop_index < prop_count; prop_index++) {
+            sLevel_Prop prop;
+            this->Read_Block(file, prop_offset + (prop_index * sizeof(sLevel_Prop)), &prop, sizeof(sLevel_Prop));
+            Check_Condition((((int)prop.key < string_count) && ((int)prop.text < string_count)), "Property of sprite in " + name + " is corrupted.");
+            if (prop.type == eVALUE_STRING) {
+              extra[table[prop.key]].Set_String(table[prop.text]);
+            }
+            else {
+              extra[table[prop.key]].Set_Number(prop.number);
+            }
+          }
+          store.Append(names[record.name], icons[record.icon], record.x, record.y, record.size_x, record.size_y, layout_map[record.layout], &extra);
+        }
+      }
+    }
+  }
+
+  /**
+   * Saves a level in the binary format. The layout is a header, a string
+   * table, the property layouts, a layer table, fixed size sprite records
+   * grouped by layer, and a versioned blob of extra properties.
+   * @param name The name of the level file.
+   * @throws An error if the file could not be written.
+   */
+  void cLevel::Save_Binary(std::string name) {
+    cString_Table table;
+    std::vector<std::vector<std::string> > layouts;
+    std::vector<sLevel_Layer> entries;
+    std::vector<sLevel_Sprite> records;
+    std::string props;
+    uint32_t prop_version = LEVEL_PROP_VERSION;
+    this->Write_Block(props, &prop_version, sizeof(uint32_t));
+    int layer_count = this->layers.size();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      cSprite_Store& store = this->layers[layer_index];
+      sLevel_Layer entry;
+      entry.name = table.Intern(store.layer);
+      entry.sprite_count = store.Count();
+      entry.sprite_offset = records.size(); // Fixed up once the offsets are known.
+      std::vector<int> layout_map(store.layout_table.size(), NO_VALUE_FOUND);
+      std::vector<uint32_t> prop_map(store.extra_table.size(), LEVEL_NO_PROPS);
+      int sprite_count = store.Count();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        int layout = store.layouts[sprite_index];
+        if (layout_map[layout] == NO_VALUE_FOUND) {
+          std::vector<std::string>& keys = store.layout_table[layout];
+          std::vector<std::vector<std::string> >::iterator match = std::find(layouts.begin(), layouts.end(), keys);
+          layout_map[layout] = match - layouts.begin();
+          if (match == layouts.end()) {
+            layouts.push_back(keys);
+          }
+        }
+        sLevel_Sprite record;
+        record.x = store.x[sprite_index];
+        record.y = store.y[sprite_index];
+        record.size_x = store.size_x[sprite_index];
+        record.size_y = store.size_y[sprite_index];
+        record.name = table.Intern(this->strings.Get(store.names[sprite_index]));
+        record.icon = table.Intern(this->images.Get(store.icons[sprite_index]).name);
+        record.layout = layout_map[layout];
+        record.props = LEVEL_NO_PROPS;
+        int slot = store.extras[sprite_index];
+        if ((slot != NO_VALUE_FOUND) && (prop_map[slot] != LEVEL_NO_PROPS)) {
+          record.props = prop_map[slot]; // Shared property sets are written once.
+        }
+        else if (slot != NO_VALUE_FOUND) {
+          tObject& extra = *store.extra_table[slot];
+          uint32_t prop_count = extra.Count();
+          record.props = props.size();
+          prop_map[slot] = record.props;
+          this->Write_Block(props, &prop_count, sizeof(uint32_t));
+          for (uint32_t prop_index = 0; prop_index < prop_count; prop_index++) {
+            std::string key = extra.keys[prop_index];
+            cValue& value = extra[key];
+            sLevel_Prop prop;
+            prop.key = table.Intern(key);
+            prop.type = value.type;
+            prop.text = (value.type == eVALUE_STRING) ? table.Intern(value.string) : 0;
+            prop.reserved = 0;
+            prop.number = (value.type == eVALUE_STRING) ? 0 : value.number;
+            this->Write_Block(props, &prop, sizeof(sLevel_Prop));
+          }
+        }
+        records.push_back(record);
+      }
+      entries.push_back(entry);
+    }
+    sLevel_Header header;
+    std::memcpy(header.magic, LEVEL_MAGIC, 4);
+    header.version = LEVEL_VERSION;
+    header.background = table.Intern(this->background);
+    header.music_track = table.Intern(this->music_track);
+    // Layout keys are interned before the string table is written.
+    int layout_count = layouts.size();
+    std::vector<std::vector<uint32_t> > layout_keys(layout_count);
+    for (int layout_index = 0; layout_index < layout_count; layout_index++) {
+      int key_count = layouts[layout_index].size();
+      for (int key_index = 0; key_index < key_count; key_index++) {
+        layout_keys[layout_index].push_back(table.Intern(layouts[layout_index][key_index]));
+      }
+    }
+    std::string buffer(sizeof(sLevel_Header), '\0');
+    header.string_count = table.Count();
+    header.string_offset = buffer.size();
+    for (int string_index = 0; string_index < table.Count(); string_index++) {
+      std::string& text = table.Get(string_index);
+      uint32_t length = text.length();
+      this->Write_Block(buffer, &length, sizeof(uint32_t));
+      buffer.append(text);
+    }
+    this->Pad_Block(buffer);
+    header.layout_count = layout_count;
+    header.layout_offset = buffer.size();
+    for (int layout_index = 0; layout_index < layout_count; layout_index++) {
+      uint32_t key_count = layout_keys[layout_index].size();
+      this->Write_Block(buffer, &key_count, sizeof(uint32_t));
+      if (key_count > 0) {
+        this->Write_Block(buffer, &layout_keys[layout_index][0], key_count * sizeof(uint32_t));
+      }
+    }
+    this->Pad_Block(buffer);
+    header.layer_count = entries.size();
+    header.layer_offset = buffer.size();
+    int sprite_offset = header.layer_offset + (entries.size() * sizeof(sLevel_Layer));
+    sprite_offset += (8 - (sprite_offset % 8)) % 8;
+    for (int entry_index = 0; entry_index < (int)entries.size(); entry_index++) {
+      entries[entry_index].sprite_offset = sprite_offset + (entries[entry_index].sprite_offset * sizeof(sLevel_Sprite));
+      this->Write_Block(buffer, &entries[entry_index], sizeof(sLevel_Layer));
+    }
+    this->Pad_Block(buffer);
+    if (records.size() > 0) {
+      this->Write_Block(buffer, &records[0], records.size() * sizeof(sLevel_Sprite));
+    }
+    this->Pad_Block(buffer);
+    header.prop_offset = buffer.size();
+    header.prop_size = props.size();
+    buffer.append(props);
+    std::memcpy(&buffer[0], &header, sizeof(sLevel_Header));
+    std::ofstream level_file(name.c_str(), std::ios::binary | std::ios::trunc);
+    Check_Condition(level_file.is_open(), "Could not write " + name + ".");
+    level_file.write(buffer.data(), buffer.size());
+    Check_Condition(level_file.good(), "Could not write " + name + ".");
+  }
+
+  /**
+   * Determines if a level file is in the binary format.
+   * @param name The name of the level file.
+   * @return True if the file starts with the binary level magic, false otherwise.
+   */
+  bool cLevel::Is_Binary(std::string name) {
+    bool is_binary = false;
+    std::ifstream level_file(name.c_str(), std::ios::binary);
+    if (level_file.is_open()) {
+      char magic[4];
+      level_file.read(magic, 4);
+      is_binary = (level_file.gcount() == 4) && (std::string(magic, 4) == LEVEL_MAGIC);
+    }
+    return is_binary;
+  }
+
+  /**
+   * Clears out all sprites in the level.
+   */
+  void cLevel::Clear() {
+    int layer_count = this->layers.size();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      this->layers[layer_index].Clear();
+    }
+  }
+
+  /**
+   * Copies the level into a snapshot that can be saved on another thread. The
+   * spatial grids are left out since saving does not need them. Only flat
+   * arrays are copied here and the lookup tables are rebuilt by Index_Snapshot
+   * on the saving thread.
+   * @param snapshot The level to copy into. It must be empty.
+   */
+  void cLevel::Snapshot(cLevel& snapshot) {
+    snapshot.background = this->background;
+    snapshot.music_track = this->music_track;
+    snapshot.format = this->format;
+    snapshot.generation = this->generation;
+    snapshot.layer_names.strings = this->layer_names.strings;
+    snapshot.strings.strings = this->strings.strings;
+    snapshot.images.names.strings = this->images.names.strings;
+    snapshot.images.images = this->images.images;
+    snapshot.images.io = NULL; // Images are not resolved off the main thread.
+    snapshot.templates = this->templates;
+    int layer_count = this->layers.size();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      cSprite_Store& store = this->layers[layer_index];
+      snapshot.layers.push_back(cSprite_Store(store.layer, &snapshot.strings, &snapshot.images));
+      snapshot.layers[layer_index].Copy_Sprites(store);
+    }
+  }
+
+  /**
+   * Rebuilds the lookup tables that were left out of a snapshot.
+   */
+  void cLevel::Index_Snapshot() {
+    this->layer_names.Index();
+    this->strings.Index();
+    this->images.names.Index();
+    int template_count = this->templates.size();
+    for (int template_index = 0; template_index < template_count; template_index++) {
+      this->template_ids[this->templates[template_index].name] = template_index;
+    }
+  }
+
+  /**
+   * Replaces a file with a temporary file. The temporary file is flushed to
+   * disk before it is renamed over the original.
+   * @param temp_name The name of the temporary file.
+   * @param name The name of the file to replace.
+   * @throws An error if the file could not be replaced.
+   */
+  void cLevel::Replace_File(std::string temp_name, std::string name) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(temp_name.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    Check_Condition((file != INVALID_HANDLE_VALUE), "Could not open " + temp_name + ".");
+    bool flushed = FlushFileBuffers(file);
+    CloseHandle(file);
+    Check_Condition(flushed, "Could not flush " + temp_name + ".");
+    bool replaced = MoveFileExA(temp_name.c_str(), name.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    Check_Condition(replaced, "Could not replace " + name + ".");
+#else
+    int file = open(temp_name.c_str(), O_RDONLY);
+    Check_Condition((file != -1), "Could not open " + temp_name + ".");
+    bool flushed = (fsync(file) == 0);
+    close(file);
+    Check_Condition(flushed, "Could not flush " + temp_name + ".");
+    Check_Condition((rename(temp_name.c_str(), name.c_str()) == 0), "Could not replace " + name + ".");
+    std::string::size_type slash = name.rfind('/');
+    std::string folder = (slash == std::string::npos) ? "." : name.substr(0, slash + 1);
+    int folder_file = open(folder.c_str(), O_RDONLY);
+    if (folder_file != -1) { // Make the rename itself durable.
+      fsync(folder_file);
+      close(folder_file);
+    }
+#endif
+  }
+
+  /**
+   * Adds a sprite to a layer.
+   * @param layer The index of the layer.
+   * @param sprite The sprite to add.
+   * @return The index of the new sprite.
+   */
+  int cLevel::Add_Sprite(int layer, tObject& sprite) {
+    cSprite_Store& store = this->layers[layer];
+    int index = store.Add(sprite);
+    this->generation++;
+    if (this->history) {
+      sUndo_Entry entry = this->history->Make_Entry(eUNDO_ADD, layer, index);
+      entry.sprites.push_back(index);
+      this->history->Record(entry);
+    }
+    if (this->journal) {
+      this->journal->Record("", "create " + store.layer + " " + Number_To_Text(index) + this->Format_Sprite(store, index));
+    }
+    return index;
+  }
+
+  /**
+   * Moves a sprite.
+   * @param layer The index of the layer.
+   * @param sprite The index of the sprite.
+   * @param x The new x coordinate.
+   * @param y The new y coordinate.
+   */
+  void cLevel::Move_Sprite(int layer, int sprite, int x, int y) {
+    cSprite_Store& store = this->layers[layer];
+    if (this->history) {
+      sUndo_Entry entry = this->history->Make_Entry(eUNDO_MOVE, layer, sprite);
+      entry.old_x = store.x[sprite];
+      entry.old_y = store.y[sprite];
+      entry.new_x = x;
+      entry.new_y = y;
+      this->history->Record(entry);
+    }
+    store.x[sprite] = x;
+    store.y[sprite] = y;
+    store.Update_Bounds(sprite);
+    this->generation++;
+    if (this->journal) {
+      std::string op = "move " + store.layer + " " + Number_To_Text(sprite);
+      this->journal->Record(op, op + " " + Number_To_Text(x) + " " + Number_To_Text(y)); // Drags collapse into one entry.
+    }
+  }
+
+  /**
+   * Resizes a sprite.
+   * @param layer The index of the layer.
+   * @param sprite The index of the sprite.
+   * @param size_x The new number of tiles across.
+   * @param size_y The new number of tiles down.
+   */
+  void cLevel::Resize_Sprite(int layer, int sprite, int size_x, int size_y) {
+    cSprite_Store& store = this->layers[layer];
+    if (this->history) {
+      sUndo_Entry entry = this->history->Make_Entry(eUNDO_RESIZE, layer, sprite);
+      entry.old_x = store.size_x[sprite];
+      entry.old_y = store.size_y[sprite];
+      entry.new_x = size_x;
+      entry.new_y = size_y;
+      this->history->Record(entry);
+    }
+    store.size_x[sprite] = size_x;
+    store.size_y[sprite] = size_y;
+    store.Update_Bounds(sprite);
+    this->generation++;
+    if (this->journal) {
+      std::string op = "resize " + store.layer + " " + Number_To_Text(sprite);
+      this->journal->Record(op, op + " " + Number_To_Text(size_x) + " " + Number_To_Text(size_y));
+    }
+  }
+
+  /**
+   * Removes a sprite from a layer.
+   * @param layer The index of the layer.
+   * @param sprite The index of the sprite.
+   */
+  void cLevel::Remove_Sprite(int layer, int sprite) {
+    if (this->history) {
+      sUndo_Entry entry = this->history->Make_Entry(eUNDO_REMOVE, layer, sprite);
+      entry.sprites.push_back(sprite);
+      entry.records.push_back(this->layers[layer].Get_Record(sprite));
+      this->history->Record(entry);
+    }
+    this->layers[layer].Remove(sprite);
+    this->generation++;
+    if (this->journal) {
+      this->journal->Record("", "delete " + this->layers[layer].layer + " " + Number_To_Text(sprite));
+    }
+  }
+
+  /**
+   * Moves many sprites by the same offset.
+   * @param layer The index of the layer.
+   * @param sprites The indices of the sprites.
+   * @param offset_x The distance to move across.
+   * @param offset_y The distance to move down.
+   */
+  void cLevel::Move_Sprites(int layer, std::vector<int>& sprites, int offset_x, int offset_y) {
+    cSprite_Store& store = this->layers[layer];
+    int sprite_count = sprites.size();
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+      int sprite = sprites[sprite_index];
+      store.x[sprite] += offset_x;
+      store.y[sprite] += offset_y;
+      store.Update_Bounds(sprite);
+    }
+    this->generation++;
+    if (this->history) {
+      sUndo_Entry entry = this->history->Make_Entry(eUNDO_SHIFT, layer, NO_VALUE_FOUND);
+      entry.sprites = sprites;
+      entry.new_x = offset_x;
+      entry.new_y = offset_y;
+      this->history->Record(entry);
+    }
+    if (this->journal) {
+      this->journal->Record("", "shift " + store.layer + " " + Number_To_Text(offset_x) + " " + Number_To_Text(offset_y) + this->Format_Sprites(sprites));
+    }
+  }
+
+  /**
+   * Resizes many sprites by the same number of tiles. No sprite is made
+   * smaller than one tile.
+   * @param layer The index of the layer.
+   * @param sprites The indices of the sprites.
+   * @param offset_x The number of tiles to add across.
+   * @param offset_y The number of tiles to add down.
+   */
+  void cLevel::Resize_Sprites(int layer, std::vector<int>& sprites, int offset_x, int offset_y) {
+    cSprite_Store& store = this->layers[layer];
+    std::vector<int> clamped;
+    int sprite_count = sprites.size();
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+      int sprite = sprites[sprite_index];
+      int size_x = store.size_x[sprite] + offset_x;
+      int size_y = store.size_y[sprite] + offset_y;
+      if ((size_x < 1) || (size_y < 1)) { // Only these cannot be undone by the offset.
+        clamped.push_back(sprite);
+        clamped.push_back(store.size_x[sprite]);
+        clamped.push_back(store.size_y[sprite]);
+      }
+      store.size_x[sprite] = std::max(size_x, 1);
+      store.size_y[sprite] = std::max(size_y, 1);
+      store.Update_Bounds(sprite);
+    }
+    this->generation++;
+    if (this->history) {
+      sUndo_Entry entry = this->history->Make_Entry(eUNDO_GROW, layer, NO_VALUE_FOUND);
+      entry.sprites = sprites;
+      entry.clamped = clamped;
+      entry.new_x = offset_x;
+      entry.new_y = offset_y;
+      this->history->Record(entry);
+    }
+    if (this->journal) {
+      this->journal->Record("", "grow " + store.layer + " " + Number_To_Text(offset_x) + " " + Number_To_Text(offset_y) + this->Format_Sprites(sprites));
+    }
+  }
+
+  /**
+   * Removes many sprites from a layer at once.
+   * @param layer The index of the layer.
+   * @param sprites The indices of the sprites in ascending order.
+   */
+  void cLevel::Remove_Sprites(int layer, std::vector<int>& sprites) {
+    cSprite_Store& store = this->layers[layer];
+    if (this->history) {
+      sUndo_Entry entry = this->history->Make_Entry(eUNDO_REMOVE, layer, NO_VALUE_FOUND);
+      entry.sprites = sprites;
+      int sprite_count = sprites.size();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        entry.records.push_back(store.Get_Record(sprites[sprite_index]));
+      }
+      this->history->Record(entry);
+    }
+    store.Remove_Sprites(sprites);
+    this->generation++;
+    if (this->journal) {
+      this->journal->Record("", "delete-many " + store.layer + this->Format_Sprites(sprites));
+    }
+  }
+
+  /**
+   * Moves sprites to another layer. They are added to the end of the new
+   * layer in the same order. Moving to the same layer does nothing.
+   * @param layer The index of the layer the sprites are on.
+   * @param sprites The indices of the sprites in ascending order. Set to their indices on the new layer.
+   * @param new_layer The index of the layer to move them to.
+   */
+  void cLevel::Change_Layer(int layer, std::vector<int>& sprites, int new_layer) {
+    if (new_layer != layer) {
+      cSprite_Store& store = this->layers[layer];
+      cSprite_Store& target = this->layers[new_layer];
+      std::vector<int> moved;
+      std::vector<sSprite_Record> records;
+      int sprite_count = sprites.size();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        // The layer is implied by the store so the record carries over as is.
+        records.push_back(store.Get_Record(sprites[sprite_index]));
+        moved.push_back(target.Count() + sprite_index);
+      }
+      if (sprite_count > 0) {
+        target.Insert_Records(moved, records, store);
+      }
+      store.Remove_Sprites(sprites);
+      this->generation++;
+      if (this->history) {
+        sUndo_Entry entry = this->history->Make_Entry(eUNDO_RELAYER, layer, NO_VALUE_FOUND);
+        entry.new_layer = new_layer;
+        entry.sprites = sprites;
+        entry.moved = moved;
+        this->history->Record(entry);
+      }
+      if (this->journal) {
+        this->journal->Record("", "relayer " + store.layer + " " + target.layer + this->Format_Sprites(sprites));
+      }
+      sprites = moved;
+    }
+  }
+
+  /**
+   * Puts sprites back at the places they were removed from.
+   * @param layer The index of the layer.
+   * @param sprites The indices the sprites will have, in ascending order.
+   * @param records The sprites to put back.
+   * @param source The store the records were taken from.
+   */
+  void cLevel::Insert_Sprites(int layer, std::vector<int>& sprites, std::vector<sSprite_Record>& records, cSprite_Store& source) {
+    cSprite_Store& store = this->layers[layer];
+    store.Insert_Records(sprites, records, source);
+    this->generation++;
+    if (this->history) {
+      sUndo_Entry entry = this->history->Make_Entry(eUNDO_ADD, layer, NO_VALUE_FOUND);
+      entry.sprites = sprites;
+      this->history->Record(entry);
+    }
+    if (this->journal) {
+      std::string line = "insert " + store.layer + this->Format_Sprites(sprites);
+      int sprite_count = sprites.size();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        line += this->Format_Sprite(store, sprites[sprite_index]);
+      }
+      this->journal->Record("", line);
+    }
+  }
+
+  /**
+   * Sets an extra property of a sprite.
+   * @param layer The index of the layer.
+   * @param sprite The index of the sprite.
+   * @param key The name of the property.
+   * @param value The value of the property.
+   */
+  void cLevel::Set_Sprite_Property(int layer, int sprite, std::string key, cValue value) {
+    cSprite_Store& store = this->layers[layer];
+    if (this->history) {
+      sUndo_Entry entry = this->history->Make_Entry(eUNDO_PROPERTY, layer, sprite);
+      entry.key = key;
+      entry.had_value = store.Has_Property(sprite, key);
+      if (entry.had_value) {
+        entry.old_value = store.Get_Property(sprite, key);
+      }
+      entry.has_value = true;
+      entry.new_value = value;
+      this->history->Record(entry);
+    }
+    store.Set_Property(sprite, key, value);
+    this->generation++;
+    if (this->journal) {
+      std::string type = (value.type == eVALUE_STRING) ? "s" : "n";
+      std::string op = "set " + store.layer + " " + Number_To_Text(sprite) + " " + type + " " + key;
+      this->journal->Record(op, op + " " + this->Format_Value(value));
+    }
+  }
+
+  /**
+   * Removes an extra property from a sprite.
+   * @param layer The index of the layer.
+   * @param sprite The index of the sprite.
+   * @param key The name of the property.
+   */
+  void cLevel::Remove_Sprite_Property(int layer, int sprite, std::string key) {
+    cSprite_Store& store = this->layers[layer];
+    if (store.Has_Property(sprite, key)) {
+      if (this->history) {
+        sUndo_Entry entry = this->history->Make_Entry(eUNDO_PROPERTY, layer, sprite);
+        entry.key = key;
+        entry.had_value = true;
+        entry.old_value = store.Get_Property(sprite, key);
+        entry.has_value = false;
+        this->history->Record(entry);
+      }
+      store.Remove_Property(sprite, key);
+      this->generation++;
+      if (this->journal) {
+        this->journal->Record("", "unset " + store.layer + " " + Number_To_Text(sprite) + " " + key);
+      }
+    }
+  }
+
+  /**
+   * Sets the background of the level.
+   * @param background The name of the background without the suffix.
+   */
+  void cLevel::Set_Background(std::string background) {
+    if (this->history) {
+      sUndo_Entry entry = this->history->Make_Entry(eUNDO_BACKGROUND, NO_VALUE_FOUND, NO_VALUE_FOUND);
+      entry.old_text = this->background;
+      entry.new_text = background;
+      this->history->Record(entry);
+    }
+    this->background = background;
+    this->generation++;
+    if (this->journal) {
+      this->journal->Record("background", "background " + background);
+    }
+  }
+
+  /**
+   * Sets the music track of the level.
+   * @param music_track The name of the music track.
+   */
+  void cLevel::Set_Music_Track(std::string music_track) {
+    if (this->history) {
+      sUndo_Entry entry = this->history->Make_Entry(eUNDO_MUSIC_TRACK, NO_VALUE_FOUND, NO_VALUE_FOUND);
+      entry.old_text = this->music_track;
+      entry.new_text = music_track;
+      this->history->Record(entry);
+    }
+    this->music_track = music_track;
+    this->generation++;
+    if (this->journal) {
+      this->journal->Record("music-track", "music-track " + music_track);
+    }
+  }
+
+  /**
+   * Formats a property value as text.
+   * @param value The value to format.
+   * @return The text of the value.
+   */
+  std::string cLevel::Format_Value(cValue& value) {
+    std::string text = value.string;
+    if (value.type != eVALUE_STRING) {
+      text = Number_To_Text(value.number);
+    }
+    return text;
+  }
+
+  /**
+   * Formats a list of sprite indices for the journal.
+   * @param sprites The indices of the sprites.
+   * @return The indices, each with a space before it.
+   */
+  std::string cLevel::Format_Sprites(std::vector<int>& sprites) {
+    std::ostringstream text;
+    int sprite_count = sprites.size();
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+      text << " " << sprites[sprite_index];
+    }
+    return text.str();
+  }
+
+  /**
+   * Formats the properties of a sprite for the journal.
+   * @param store The store the sprite is in.
+   * @param sprite The index of the sprite.
+   * @return One line per property, each with a newline before it, and an end line.
+   */
+  std::string cLevel::Format_Sprite(cSprite_Store& store, int sprite) {
+    std::string text;
+    tObject object = store.Get_Object(sprite);
+    int prop_count = object.Count();
+    for (int prop_index = 0; prop_index < prop_count; prop_index++) {
+      std::string key = object.keys[prop_index];
+      cValue& value = object[key];
+      std::string type = (value.type == eVALUE_STRING) ? "s" : "n";
+      text += "\n" + type + " " + key + " " + this->Format_Value(value);
+    }
+    return text + "\nend";
+  }
+
+  /**
+   * Appends raw data to a buffer.
+   * @param buffer The buffer to write to.
+   * @param data The data to write.
+   * @param size The number of bytes to write.
+   */
+  void cLevel::Write_Block(std::string& buffer, const void* data, int size) {
+    buffer.append((const char*)data, size);
+  }
+
+  /**
+   * Pads a buffer so the next block is aligned to eight bytes.
+   * @param buffer The buffer to pad.
+   */
+  void cLevel::Pad_Block(std::string& buffer) {
+    buffer.append((8 - (buffer.size() % 8)) % 8, '\0');
+  }
+
+  /**
+   * Reads raw data from a mapped file.
+   * @param file The mapped file.
+   * @param offset The offset to read from.
+   * @param data The place to read the data into.
+   * @param size The number of bytes to read.
+   * @throws An error if the data is past the end of the file.
+   */
+  void cLevel::Read_Block(cMapped_File& file, int offset, void* data, int size) {
+    Check_Condition(((offset >= 0) && ((offset + size) <= file.size)), "Level file is truncated.");
+    std::memcpy(data, file.data + offset, size);
+  }
+
+}
+
+// ****************************************************************************
+// Mapped File
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Maps a file into memory for reading.
+   * @param name The name of the file.
+   * @throws An error if the file could not be mapped.
+   */
+  cMapped_File::cMapped_File(std::string name) {
+    this->data = NULL;
+    this->size = 0;
+    this->file_handle = NULL;
+    this->map_handle = NULL;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    Check_Condition((file != INVALID_HANDLE_VALUE), "Could not open " + name + ".");
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    this->size = (int)file_size.QuadPart;
+    HANDLE mapping = NULL;
+    if (this->size > 0) {
+      mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (mapping) {
+        this->data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      }
+      if (this->data == NULL) {
+        if (mapping) {
+          CloseHandle(mapping);
+        }
+        CloseHandle(file);
+      }
+      Check_Condition((this->data != NULL), "Could not map " + name + ".");
+    }
+    this->file_handle = file;
+    this->map_handle = mapping;
+#else
+    int file = open(name.c_str(), O_RDONLY);
+    Check_Condition((file != -1), "Could not open " + name + ".");
+    struct stat info;
+    if (fstat(file, &info) == 0) {
+      this->size = (int)info.st_size;
+    }
+    if (this->size > 0) {
+      void* data = mmap(NULL, this->size, PROT_READ, MAP_PRIVATE, file, 0);
+      if (data != MAP_FAILED) {
+        this->data = (const char*)data;
+      }
+    }
+    close(file); // The mapping stays valid after the file is closed.
+    Check_Condition(((this->data != NULL) || (this->size == 0)), "Could not map " + name + ".");
+#endif
+  }
+
+  /**
+   * Unmaps the file.
+   */
+  cMapped_File::~cMapped_File() {
+#ifdef _WIN32
+    if (this->data) {
+      UnmapViewOfFile(this->data);
+    }
+    if (this->map_handle) {
+      CloseHandle((HANDLE)this->map_handle);
+    }
+    if (this->file_handle) {
+      CloseHandle((HANDLE)this->file_handle);
+    }
+#else
+    if (this->data) {
+      munmap((void*)this->data, this->size);
+    }
+#endif
+  }
+
+}
+
+// ****************************************************************************
+// Autosaver
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates an autosaver that is not running yet.
+   */
+  cAutosaver::cAutosaver() {
+    this->running = false;
+  }
+
+  /**
+   * Stops the autosaver once all queued saves are done.
+   */
+  cAutosaver::~cAutosaver() {
+    this->Stop();
+  }
+
+  /**
+   * Starts the thread that saves levels.
+   */
+  void cAutosaver::Start() {
+    if (!this->running) {
+      this->running = true;
+      this->worker = std::thread(&cAutosaver::Run, this);
+    }
+  }
+
+  /**
+   * Stops the thread once all queued saves are done.
+   */
+  void cAutosaver::Stop() {
+    {
+      std::lock_guard<std::mutex> guard(this->lock);
+      this->running = false;
+    }
+    this->signal.notify_all();
+    if (this->worker.joinable()) {
+      this->worker.join();
+    }
+    while (this->jobs.size() > 0) { // Never started so nothing was saved.
+      delete this->jobs.front().snapshot;
+      this->jobs.pop_front();
+    }
+  }
+
+  /**
+   * Queues a snapshot to be saved as the level file. The journal is started
+   * over once the level file has been replaced.
+   * @param snapshot The snapshot to save. The autosaver takes ownership.
+   * @param name The name of the level file.
+   * @param journal The name of the journal file.
+   */
+  void cAutosaver::Save(cLevel* snapshot, std::string name, std::string journal) {
+    sSave_Job job;
+    job.snapshot = snapshot;
+    job.name = name;
+    job.journal = journal;
+    {
+      std::lock_guard<std::mutex> guard(this->lock);
+      this->jobs.push_back(job);
+    }
+    this->signal.notify_all();
+  }
+
+  /**
+   * Queues journal entries to be appended to the journal file.
+   * @param journal The name of the journal file.
+   * @param text The journal entries.
+   */
+  void cAutosaver::Append(std::string journal, std::string text) {
+    sSave_Job job;
+    job.snapshot = NULL;
+    job.journal = journal;
+    job.text = text;
+    {
+      std::lock_guard<std::mutex> guard(this->lock);
+      this->jobs.push_back(job);
+    }
+    this->signal.notify_all();
+  }
+
+  /**
+   * Runs the queued saves in order until stopped.
+   */
+  void cAutosaver::Run() {
+    while (true) {
+      sSave_Job job;
+      {
+        std::unique_lock<std::mutex> guard(this->lock);
+        while (this->running && (this->jobs.size() == 0)) {
+          this->signal.wait(guard);
+        }
+        if (this->jobs.size() == 0) { // Stopped with nothing left to save.
+          break;
+        }
+        job = this->jobs.front();
+        this->jobs.pop_front();
+      }
+      try {
+        cLevel_Journal journal;
+        if (job.snapshot) {
+          job.snapshot->Index_Snapshot();
+          job.snapshot->Save(job.name);
+          std::string temp_name = job.journal + ".tmp";
+          std::ofstream journal_file(temp_name.c_str(), std::ios::binary | std::ios::trunc);
+          journal_file << journal.Get_Header(job.name) << "\n";
+          journal_file.close();
+          job.snapshot->Replace_File(temp_name, job.journal);
+        }
+        else {
+          journal.Append_File(job.journal, job.text);
+        }
+      }
+      catch (cError error) {
+        error.Print();
+      }
+      delete job.snapshot;
+    }
+  }
+
+}
+
+// ****************************************************************************
+// Level Journal
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates a journal that is not attached to a file yet.
+   */
+  cLevel_Journal::cLevel_Journal() {
+    this->base_exists = false;
+    this->entry_count = 0;
+    this->limit = 0;
+  }
+
+  /**
+   * Opens the journal of a level and replays it on top of the level. The
+   * journal names a hash of the level file it was started from. If the level
+   * file was replaced since then the entries are already in it and the
+   * journal is started over.
+   * @param name The name of the journal file.
+   * @param base_name The name of the level file.
+   * @param level The level that was loaded from the level file.
+   */
+  void cLevel_Journal::Open(std::string name, std::string base_name, cLevel& level) {
+    this->name = name;
+    this->base_name = base_name;
+    this->base_exists = std::ifstream(base_name.c_str()).good();
+    this->pending.clear();
+    this->last_op = "";
+    this->entry_count = 0;
+    std::string header = this->Get_Header(base_name);
+    std::vector<std::string> lines;
+    std::ifstream journal_file(name.c_str(), std::ios::binary);
+    std::string line;
+    bool cut_off = false;
+    while (std::getline(journal_file, line)) {
+      if (journal_file.eof()) { // Entries end with a newline so this one was never finished.
+        cut_off = true;
+        break;
+      }
+      if ((line.length() > 0) && (line[line.length() - 1] == '\r')) {
+        line.erase(line.length() - 1);
+      }
+      lines.push_back(line);
+    }
+    journal_file.close();
+    int line_index = 0;
+    if ((lines.size() > 0) && (lines[0] == header)) {
+      line_index = 1;
+      this->entry_count = this->Replay(level, lines, line_index);
+      if (this->entry_count > 0) {
+        std::cout << "Recovered " << this->entry_count << " edits from " << name << "." << std::endl;
+      }
+    }
+    if ((line_index == 0) || (line_index != (int)lines.size()) || cut_off) { // Start over or drop damaged entries.
+      std::string text = header + "\n";
+      for (int keep_index = 1; keep_index < line_index; keep_index++) {
+        text += lines[keep_index] + "\n";
+      }
+      std::string temp_name = name + ".tmp";
+      std::ofstream temp_file(temp_name.c_str(), std::ios::binary | std::ios::trunc);
+      temp_file << text;
+      temp_file.close();
+      level.Replace_File(temp_name, name);
+    }
+  }
+
+  /**
+   * Records an edit. An edit with the same operation as the one before it
+   * replaces it, so a drag or a held key only takes up one entry.
+   * @param op The operation to collapse on or an empty string if it never collapses.
+   * @param line The journal entry.
+   */
+  void cLevel_Journal::Record(std::string op, std::string line) {
+    if ((op.length() > 0) && (op == this->last_op) && (this->pending.size() > 0)) {
+      this->pending.back() = line;
+    }
+    else {
+      this->pending.push_back(line);
+      this->entry_count++;
+    }
+    this->last_op = op;
+  }
+
+  /**
+   * Takes the entries that have not been written yet.
+   * @return The entries as text, one per line.
+   */
+  std::string cLevel_Journal::Flush() {
+    std::string text;
+    int entry_count = this->pending.size();
+    for (int entry_index = 0; entry_index < entry_count; entry_index++) {
+      text += this->pending[entry_index] + "\n";
+    }
+    this->pending.clear();
+    this->last_op = "";
+    return text;
+  }
+
+  /**
+   * Determines if the journal has grown past its limit.
+   * @return True if the level should be compacted, false otherwise.
+   */
+  bool cLevel_Journal::Needs_Compaction() {
+    return ((this->limit > 0) && (this->entry_count > this->limit));
+  }
+
+  /**
+   * Replays journal entries on a level. Replay stops at the first entry that
+   * is incomplete or damaged, which happens if the editor died while writing it.
+   * @param level The level to replay the entries on.
+   * @param lines The lines of the journal.
+   * @param line_index The line to start at. Set to the line after the last entry replayed.
+   * @return The number of entries replayed.
+   */
+  int cLevel_Journal::Replay(cLevel& level, std::vector<std::string>& lines, int& line_index) {
+    int entry_count = 0;
+    int line_count = lines.size();
+    cLevel_Journal* journal = level.journal;
+    cUndo_History* history = level.history;
+    level.journal = NULL; // Do not record what is being replayed.
+    level.history = NULL;
+    try {
+      while (line_index < line_count) {
+        std::istringstream entry(lines[line_index]);
+        std::string op;
+        entry >> op;
+        int next_line = line_index + 1;
+        if ((op == "background") || (op == "music-track")) {
+          std::string value = lines[line_index].substr(op.length() + 1);
+          if (op == "background") {
+            level.Set_Background(value);
+          }
+          else {
+            level.Set_Music_Track(value);
+          }
+        }
+        else if (op == "insert") {
+          std::string layer_name;
+          entry >> layer_name;
+          int layer = level.Find_Layer(layer_name);
+          Check_Condition((!entry.fail() && (layer != NO_VALUE_FOUND)), "Journal entry " + lines[line_index] + " is corrupted.");
+          cSprite_Store& store = level.layers[layer];
+          std::vector<int> sprites;
+          int sprite = NO_VALUE_FOUND;
+          while (entry >> sprite) {
+            Check_Condition(((sprite >= 0) && ((sprites.size() == 0) || (sprite > sprites.back()))), "Journal entry " + lines[line_index] + " does not match the level.");
+            sprites.push_back(sprite);
+          }
+          Check_Condition((((int)sprites.size() > 0) && (sprites.back() < (store.Count() + (int)sprites.size()))), "Journal entry " + lines[line_index] + " does not match the level.");
+          std::vector<sSprite_Record> records;
+          int sprite_count = sprites.size();
+          for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+            tObject object;
+            if (!this->Read_Sprite(lines, next_line, object)) {
+              break;
+            }
+            level.Check_Sprite(object);
+            records.push_back(store.Make_Record(object));
+          }
+          if ((int)records.size() < sprite_count) { // Cut off in the middle of writing.
+            break;
+          }
+          level.Insert_Sprites(layer, sprites, records, store);
+        }
+        else if ((op == "shift") || (op == "grow") || (op == "delete-many") || (op == "relayer")) {
+          std::string layer_name;
+          entry >> layer_name;
+          int layer = level.Find_Layer(layer_name);
+          int new_layer = NO_VALUE_FOUND;
+          int offset_x = 0;
+          int offset_y = 0;
+          if (op == "relayer") {
+            std::string new_layer_name;
+            entry >> new_layer_name;
+            new_layer = level.Find_Layer(new_layer_name);
+            Check_Condition((new_layer != NO_VALUE_FOUND), "Journal entry " + lines[line_index] + " is corrupted.");
+          }
+          else if (op != "delete-many") {
+            entry >> offset_x >> offset_y;
+          }
+          Check_Condition((!entry.fail() && (layer != NO_VALUE_FOUND)), "Journal entry " + lines[line_index] + " is corrupted.");
+          int sprite_count = level.layers[layer].Count();
+          std::vector<int> sprites;
+          int sprite = NO_VALUE_FOUND;
+          while (entry >> sprite) {
+            Check_Condition(((sprite >= 0) && (sprite < sprite_count) && ((sprites.size() == 0) || (sprite > sprites.back()))), "Journal entry " + lines[line_index] + " does not match the level.");
+            sprites.push_back(sprite);
+          }
+          if (op == "shift") {
+            level.Move_Sprites(layer, sprites, offset_x, offset_y);
+          }
+          else if (op == "grow") {
+            level.Resize_Sprites(layer, sprites, offset_x, offset_y);
+          }
+          else if (op == "delete-many") {
+            level.Remove_Sprites(layer, sprites);
+          }
+          else {
+            level.Change_Layer(layer, sprites, new_layer);
+          }
+        }
+        else {
+          std::string layer_name;
+          int sprite = NO_VALUE_FOUND;
+          entry >> layer_name >> sprite;
+          int layer = level.Find_Layer(layer_name);
+          Check_Condition((!entry.fail() && (layer != NO_VALUE_FOUND)), "Journal entry " + lines[line_index] + " is corrupted.");
+          int sprite_count = level.layers[layer].Count();
+          if (op == "create") {
+            Check_Condition((sprite == sprite_count), "Journal entry " + lines[line_index] + " does not match the level.");
+            tObject object;
+            if (!this->Read_Sprite(lines, next_line, object)) { // Cut off in the middle of writing.
+              break;
+            }
+            level.Check_Sprite(object);
+            level.Add_Sprite(layer, object);
+          }
+          else {
+            Check_Condition(((sprite >= 0) && (sprite < sprite_count)), "Journal entry " + lines[line_index] + " does not match the level.");
+            if (op == "move") {
+              int x = 0;
+              int y = 0;
+              entry >> x >> y;
+              Check_Condition(!entry.fail(), "Journal entry " + lines[line_index] + " is corrupted.");
+              level.Move_Sprite(layer, sprite, x, y);
+            }
+            else if (op == "resize") {
+              int size_x = 0;
+              int size_y = 0;
+              entry >> size_x >> size_y;
+              Check_Condition(!entry.fail(), "Journal entry " + lines[line_index] + " is corrupted.");
+              level.Resize_Sprite(layer, sprite, size_x, size_y);
+            }
+            else if (op == "delete") {
+              level.Remove_Sprite(layer, sprite);
+            }
+            else if (op == "unset") {
+              std::string key;
+              entry >> key;
+              Check_Condition(!entry.fail(), "Journal entry " + lines[line_index] + " is corrupted.");
+              level.Remove_Sprite_Property(layer, sprite, key);
+            }
+            else if (op == "set") {
+              std::string type;
+              std::string key;
+              entry >> type >> key;
+              Check_Condition(!entry.fail(), "Journal entry " + lines[line_index] + " is corrupted.");
+              std::string prefix = op + " " + layer_name + " " + Number_To_Text(sprite) + " " + type + " " + key + " ";
+              std::string text = (prefix.length() <= lines[line_index].length()) ? lines[line_index].substr(prefix.length()) : "";
+              cValue value;
+              if (type == "s") {
+                value.Set_String(text);
+              }
+              else {
+                value.Set_Number(std::atof(text.c_str()));
+              }
+              level.Set_Sprite_Property(layer, sprite, key, value);
+            }
+            else {
+              Check_Condition(false, "Journal entry " + lines[line_index] + " is not a known operation.");
+            }
+          }
+        }
+        line_index = next_line;
+        entry_count++;
+      }
+    }
+    catch (cError error) { // Keep what was replayed before the bad entry.
+      error.Print();
+    }
+    level.journal = journal;
+    level.history = history;
+    return entry_count;
+  }
+
+  /**
+   * Reads the property lines of a sprite up to its end line.
+   * @param lines The lines of the journal.
+   * @param line_index The line to start at. Set to the line after the end line.
+   * @param sprite The sprite object to fill.
+   * @return True if the end line was found, false if the journal stopped first.
+   */
+  bool cLevel_Journal::Read_Sprite(std::vector<std::string>& lines, int& line_index, tObject& sprite) {
+    bool complete = false;
+    int line_count = lines.size();
+    while (line_index < line_count) {
+      std::string prop_line = lines[line_index++];
+      if (prop_line == "end") {
+        complete = true;
+        break;
+      }
+      std::istringstream prop(prop_line);
+      std::string type;
+      std::string key;
+      prop >> type >> key;
+      std::string::size_type value_start = type.length() + key.length() + 2;
+      std::string value = (value_start <= prop_line.length()) ? prop_line.substr(value_start) : "";
+      if (type == "s") {
+        sprite[key].Set_String(value);
+      }
+      else {
+        sprite[key].Set_Number(std::atof(value.c_str()));
+      }
+    }
+    return complete;
+  }
+
+  /**
+   * Gets the header line for a journal started from a level file.
+   * @param base_name The name of the level file.
+   * @return The header line.
+   */
+  std::string cLevel_Journal::Get_Header(std::string base_name) {
+    std::ostringstream header;
+    header << "base " << std::hex << this->Hash_File(base_name);
+    return header.str();
+  }
+
+  /**
+   * Appends text to a file and flushes it to disk.
+   * @param name The name of the file.
+   * @param text The text to append.
+   * @throws An error if the file could not be written.
+   */
+  void cLevel_Journal::Append_File(std::string name, std::string text) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(name.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    Check_Condition((file != INVALID_HANDLE_VALUE), "Could not open " + name + ".");
+    DWORD written = 0;
+    bool appended = WriteFile(file, text.data(), text.length(), &written, NULL) && (written == text.length()) && FlushFileBuffers(file);
+    CloseHandle(file);
+    Check_Condition(appended, "Could not append to " + name + ".");
+#else
+    int file = open(name.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    Check_Condition((file != -1), "Could not open " + name + ".");
+    bool appended = (write(file, text.data(), text.length()) == (ssize_t)text.length()) && (fsync(file) == 0);
+    close(file);
+    Check_Condition(appended, "Could not append to " + name + ".");
+#endif
+  }
+
+  /**
+   * Hashes the contents of a file with FNV-1a.
+   * @param name The name of the file.
+   * @return The hash or zero if the file does not exist.
+   */
+  unsigned long long cLevel_Journal::Hash_File(std::string name) {
+    unsigned long long hash = 0;
+    std::ifstream file(name.c_str(), std::ios::binary);
+    if (file.is_open()) {
+      hash = 14695981039346656037ULL;
+      char buffer[65536];
+      while (file.read(buffer, sizeof(buffer)) || (file.gcount() > 0)) {
+        int count = file.gcount();
+        for (int byte_index = 0; byte_index < count; byte_index++) {
+          hash ^= (unsigned char)buffer[byte_index];
+          hash *= 1099511628211ULL;
+        }
+      }
+    }
+    return hash;
+  }
+
+}
+
+// ****************************************************************************
+// Headless I/O
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates an I/O control that draws into memory instead of a window. Input
+   * is read from queues filled by the caller.
+   * @param width The width of the screen.
+   * @param height The height of the screen.
+   * @param image_size The width and height of images that were not added.
+   * @param rasterize True to fill the pixels of draws, false to only count them.
+   */
+  cHeadless_IO::cHeadless_IO(int width, int height, int image_size, bool rasterize) {
+    this->width = width;
+    this->height = height;
+    this->image_size = image_size;
+    this->rasterize = rasterize;
+    this->color = 0;
+    if (rasterize) {
+      this->buffer.resize(width * height, 0);
+    }
+    this->Reset_Counts();
+  }
+
+  /**
+   * Draws an image. The image is filled with a color made from its name.
+   * @param name The name of the image.
+   * @param x The x coordinate.
+   * @param y The y coordinate.
+   * @param width The width of the image.
+   * @param height The height of the image.
+   * @param angle The angle of rotation.
+   * @param flip_x True to flip across.
+   * @param flip_y True to flip down.
+   */
+  void cHeadless_IO::Draw_Image(std::string name, int x, int y, int width, int height, int angle, bool flip_x, bool flip_y) {
+    unsigned int color = 2166136261U;
+    int char_count = name.length();
+    for (int char_index = 0; char_index < char_count; char_index++) {
+      color = (color ^ (unsigned char)name[char_index]) * 16777619U;
+    }
+    this->Fill(x, y, width, height, color);
+    this->draw_count++;
+  }
+
+  /**
+   * Draws an image repeated over a grid of tiles. Every tile of an image has
+   * the same color so the whole run is filled at once.
+   * @param name The name of the image.
+   * @param x The x coordinate of the first tile.
+   * @param y The y coordinate of the first tile.
+   * @param width The width of a tile.
+   * @param height The height of a tile.
+   * @param count_x The number of tiles across.
+   * @param count_y The number of tiles down.
+   */
+  void cHeadless_IO::Draw_Image_Tiled(std::string name, int x, int y, int width, int height, int count_x, int count_y) {
+    unsigned int color = 2166136261U;
+    int char_count = name.length();
+    for (int char_index = 0; char_index < char_count; char_index++) {
+      color = (color ^ (unsigned char)name[char_index]) * 16777619U;
+    }
+    this->Fill(x, y, width * count_x, height * count_y, color);
+    this->draw_count++;
+  }
+
+  /**
+   * Gets the width of an image.
+   * @param name The name of the image.
+   * @return The width of the image.
+   */
+  int cHeadless_IO::Get_Image_Width(std::string name) {
+    std::unordered_map<std::string, sImage>::iterator image = this->images.find(name);
+    return (image != this->images.end()) ? image->second.width : this->image_size;
+  }
+
+  /**
+   * Gets the height of an image.
+   * @param name The name of the image.
+   * @return The height of the image.
+   */
+  int cHeadless_IO::Get_Image_Height(std::string name) {
+    std::unordered_map<std::string, sImage>::iterator image = this->images.find(name);
+    return (image != this->images.end()) ? image->second.height : this->image_size;
+  }
+
+  /**
+   * Clears the screen with a color.
+   * @param red The red component.
+   * @param green The green component.
+   * @param blue The blue component.
+   */
+  void cHeadless_IO::Color(int red, int green, int blue) {
+    this->color = (red << 16) | (green << 8) | blue;
+    this->Fill(0, 0, this->width, this->height, this->color);
+  }
+
+  /**
+   * Draws a filled box.
+   * @param x The x coordinate.
+   * @param y The y coordinate.
+   * @param width The width of the box.
+   * @param height The height of the box.
+   * @param red The red component.
+   * @param green The green component.
+   * @param blue The blue component.
+   */
+  void cHeadless_IO::Box(int x, int y, int width, int height, int red, int green, int blue) {
+    this->Fill(x, y, width, height, (red << 16) | (green << 8) | blue);
+    this->draw_count++;
+  }
+
+  /**
+   * Outputs text. Only the text is counted.
+   * @param text The text to output.
+   * @param x The x coordinate.
+   * @param y The y coordinate.
+   * @param red The red component.
+   * @param green The green component.
+   * @param blue The blue component.
+   */
+  void cHeadless_IO::Output_Text(std::string text, int x, int y, int red, int green, int blue) {
+    this->text_count++;
+  }
+
+  /**
+   * Gets the width of text in a fixed cell font.
+   * @param text The text to measure.
+   * @return The width of the text.
+   */
+  int cHeadless_IO::Get_Text_Width(std::string text) {
+    return text.length() * 8;
+  }
+
+  /**
+   * Gets the height of text in a fixed cell font.
+   * @param text The text to measure.
+   * @return The height of the text.
+   */
+  int cHeadless_IO::Get_Text_Height(std::string text) {
+    return 12;
+  }
+
+  /**
+   * Reads the next queued key.
+   * @return The key or no signal if the queue is empty.
+   */
+  sSignal cHeadless_IO::Read_Key() {
+    sSignal key;
+    key.code = NO_VALUE_FOUND;
+    key.coords.x = 0;
+    key.coords.y = 0;
+    key.button = NO_VALUE_FOUND;
+    if (this->keys.size() > 0) {
+      key = this->keys.front();
+      this->keys.pop_front();
+    }
+    return key;
+  }
+
+  /**
+   * Reads the next queued mouse signal.
+   * @return The signal or no signal if the queue is empty.
+   */
+  sSignal cHeadless_IO::Read_Signal() {
+    sSignal signal;
+    signal.code = NO_VALUE_FOUND;
+    signal.coords.x = 0;
+    signal.coords.y = 0;
+    signal.button = NO_VALUE_FOUND;
+    if (this->signals.size() > 0) {
+      signal = this->signals.front();
+      this->signals.pop_front();
+    }
+    return signal;
+  }
+
+  /**
+   * Plays a music track. There is no sound so nothing is played.
+   * @param name The name of the music track.
+   */
+  void cHeadless_IO::Play_Music(std::string name) {
+  }
+
+  /**
+   * Stops the music.
+   */
+  void cHeadless_IO::Silence() {
+  }
+
+  /**
+   * Ends the frame.
+   */
+  void cHeadless_IO::Refresh() {
+    this->frame_count++;
+  }
+
+  /**
+   * Gets the list of files set on the control.
+   * @param folder The folder to list.
+   * @return The list of files.
+   */
+  cArray<std::string> cHeadless_IO::Get_File_List(std::string folder) {
+    return this->files;
+  }
+
+  /**
+   * Gets the current folder.
+   * @return The current folder.
+   */
+  std::string cHeadless_IO::Get_Current_Folder() {
+    return ".";
+  }
+
+  /**
+   * Gets the extension of a file.
+   * @param file The name of the file.
+   * @return The extension without the dot.
+   */
+  std::string cHeadless_IO::Get_File_Extension(std::string file) {
+    std::string::size_type dot = file.rfind('.');
+    return (dot != std::string::npos) ? file.substr(dot + 1) : "";
+  }
+
+  /**
+   * Gets the title of a file.
+   * @param file The name of the file.
+   * @return The name of the file without the extension.
+   */
+  std::string cHeadless_IO::Get_File_Title(std::string file) {
+    std::string::size_type dot = file.rfind('.');
+    return file.substr(0, dot);
+  }
+
+  /**
+   * Adds an image so that its size is known.
+   * @param name The name of the image.
+   * @param width The width of the image.
+   * @param height The height of the image.
+   */
+  void cHeadless_IO::Add_Image(std::string name, int width, int height) {
+    sImage& image = this->images[name];
+    image.name = name;
+    image.width = width;
+    image.height = height;
+  }
+
+  /**
+   * Queues a key to be read.
+   * @param code The code of the key or NO_VALUE_FOUND for no key.
+   */
+  void cHeadless_IO::Add_Key(int code) {
+    sSignal key;
+    key.code = code;
+    key.coords.x = 0;
+    key.coords.y = 0;
+    key.button = NO_VALUE_FOUND;
+    this->keys.push_back(key);
+  }
+
+  /**
+   * Queues a mouse signal to be read.
+   * @param button The button that is pressed.
+   * @param x The x coordinate of the mouse.
+   * @param y The y coordinate of the mouse.
+   */
+  void cHeadless_IO::Add_Signal(int button, int x, int y) {
+    sSignal signal;
+    signal.code = eSIGNAL_MOUSE;
+    signal.coords.x = x;
+    signal.coords.y = y;
+    signal.button = button;
+    this->signals.push_back(signal);
+  }
+
+  /**
+   * Resets the draw counts.
+   */
+  void cHeadless_IO::Reset_Counts() {
+    this->draw_count = 0;
+    this->text_count = 0;
+    this->pixel_count = 0;
+    this->frame_count = 0;
+  }
+
+  /**
+   * Fills a rectangle clipped to the screen. The pixels covered are counted
+   * even if they are not drawn.
+   * @param x The x coordinate.
+   * @param y The y coordinate.
+   * @param width The width of the rectangle.
+   * @param height The height of the rectangle.
+   * @param color The color to fill with.
+   */
+  void cHeadless_IO::Fill(int x, int y, int width, int height, unsigned int color) {
+    int left = std::max(x, 0);
+    int top = std::max(y, 0);
+    int right = std::min(x + width, this->width);
+    int bottom = std::min(y + height, this->height);
+    if ((left < right) && (top < bottom)) {
+      this->pixel_count += (long long)(right - left) * (bottom - top);
+      if (this->rasterize) {
+        for (int pixel_y = top; pixel_y < bottom; pixel_y++) {
+          unsigned int* row = &this->buffer[pixel_y * this->width];
+          std::fill(row + left, row + right, color);
+        }
+      }
+    }
+  }
+
+}
+
+// ****************************************************************************
+// Level Generator
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates a level generator with the layers and screen size from the config.
+   * Sprites are spread evenly over all layers unless a mix is set.
+   * @param config The config parser.
+   */
+  cLevel_Generator::cLevel_Generator(cConfig& config) {
+    this->sprite_count = 1000;
+    this->pattern = "uniform";
+    this->max_size = 4;
+    this->link_rate = 0.5;
+    this->seed = 1;
+    this->background = "SMW_Hilly";
+    this->music_track = "SMW_Mountains";
+    this->screen_width = config.Get_Property("width");
+    this->screen_height = config.Get_Property("height");
+    this->layers = Parse_Sausage_Text(config.Get_Text_Property("layers"), ",");
+    this->layer_weights.assign(this->layers.Count(), 1.0);
+    this->layer_types.resize(this->layers.Count());
+    this->world_width = 0;
+    this->world_height = 0;
+  }
+
+  /**
+   * Loads the sprite palette that sprites are made from. Each sprite type
+   * goes on the layer it names.
+   * @param name The name of the sprite palette.
+   * @throws An error if the sprite palette could not be loaded.
+   */
+  void cLevel_Generator::Load_Palette(std::string name) {
+    cFile palette_file(name + ".txt");
+    palette_file.Read();
+    while (palette_file.Has_More_Lines()) {
+      palette_file.Get_Line(); // Sprite type.
+      tObject sprite;
+      palette_file >>= sprite;
+      Destar_Sprite(sprite);
+      this->types.push_back(sprite);
+      int layer_count = this->layers.Count();
+      for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+        if (this->layers[layer_index] == sprite["layer"].string) {
+          this->layer_types[layer_index].push_back(sprite);
+        }
+      }
+    }
+    Check_Condition((this->types.size() > 0), "No sprites in palette!");
+  }
+
+  /**
+   * Sets how sprites are shared between layers.
+   * @param mix Pairs of layer and weight such as character:4,platform:1.
+   * @throws An error if a layer does not exist.
+   */
+  void cLevel_Generator::Set_Mix(std::string mix) {
+    this->layer_weights.assign(this->layers.Count(), 0.0);
+    cArray<std::string> pairs = Parse_Sausage_Text(mix, ",");
+    int pair_count = pairs.Count();
+    for (int pair_index = 0; pair_index < pair_count; pair_index++) {
+      cArray<std::string> pair = Parse_Sausage_Text(pairs[pair_index], ":");
+      int layer = NO_VALUE_FOUND;
+      int layer_count = this->layers.Count();
+      for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+        if (this->layers[layer_index] == pair[0]) {
+          layer = layer_index;
+        }
+      }
+      Check_Condition((layer != NO_VALUE_FOUND), "Layer " + pair[0] + " does not exist in layers.");
+      this->layer_weights[layer] = (pair.Count() > 1) ? std::atof(pair[1].c_str()) : 1.0;
+    }
+  }
+
+  /**
+   * Generates a level. Sprites that point to other levels are linked to the
+   * other generated levels so the levels form a graph.
+   * @param level The level to fill. It must be set up with the same layers.
+   * @param level_names The names of all of the levels being generated.
+   * @param level_index The index of the level being generated.
+   * @throws An error if the pattern is not known.
+   */
+  void cLevel_Generator::Generate(cLevel& level, std::vector<std::string>& level_names, int level_index) {
+    this->random.seed(this->seed + level_index); // Every level is reproducible on its own.
+    int active_layers = 0;
+    int layer_count = this->layers.Count();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      if (this->layer_weights[layer_index] > 0) {
+        active_layers++;
+      }
+    }
+    Check_Condition((active_layers > 0), "No layers to put sprites on.");
+    this->Setup_World(active_layers);
+    this->layer_picker = std::discrete_distribution<int>(this->layer_weights.begin(), this->layer_weights.end());
+    level.background = this->background;
+    level.music_track = this->music_track;
+    int level_count = level_names.size();
+    std::bernoulli_distribution link(this->link_rate);
+    std::uniform_int_distribution<int> target(0, std::max(level_count - 2, 0));
+    for (int sprite_index = 0; sprite_index < this->sprite_count; sprite_index++) {
+      int layer = this->Pick_Layer();
+      tObject sprite = this->Pick_Type(layer);
+      sPoint position = this->Place_Sprite();
+      sprite["x"].Set_Number(position.x);
+      sprite["y"].Set_Number(position.y);
+      sprite["size-x"].Set_Number(this->Pick_Size());
+      sprite["size-y"].Set_Number(this->Pick_Size());
+      sprite["layer"].Set_String(this->layers[layer]);
+      if (sprite.Does_Key_Exist("pointer-level")) {
+        std::string pointer_level = "None";
+        if ((level_count > 1) && link(this->random)) {
+          int target_index = target(this->random);
+          if (target_index >= level_index) { // Skip this level.
+            target_index++;
+          }
+          pointer_level = level_names[target_index];
+        }
+        sprite["pointer-level"].Set_String(pointer_level);
+      }
+      level.Add_Sprite(level.Find_Layer(this->layers[layer]), sprite);
+    }
+  }
+
+  /**
+   * Sizes the world so each layer holds about one sprite per spacing square.
+   * @param layer_count The number of layers that get sprites.
+   */
+  void cLevel_Generator::Setup_World(int layer_count) {
+    double area = ((double)this->sprite_count / layer_count) * GENERATOR_SPACING * GENERATOR_SPACING;
+    this->clusters.clear();
+    if (this->pattern == "horizontal") { // Long and flat like a side scroller.
+      this->world_height = this->screen_height * 2;
+      this->world_width = std::max((int)(area / this->world_height), this->screen_width);
+    }
+    else {
+      Check_Condition(((this->pattern == "uniform") || (this->pattern == "clustered")), "Pattern " + this->pattern + " is not uniform, clustered, or horizontal.");
+      int side = (int)std::sqrt(area);
+      this->world_width = std::max(side, this->screen_width);
+      this->world_height = std::max(side, this->screen_height);
+      if (this->pattern == "clustered") {
+        int cluster_count = std::max(this->sprite_count / GENERATOR_CLUSTER_SIZE, 1);
+        std::uniform_int_distribution<int> x(0, this->world_width - 1);
+        std::uniform_int_distribution<int> y(0, this->world_height - 1);
+        for (int cluster_index = 0; cluster_index < cluster_count; cluster_index++) {
+          sPoint center;
+          center.x = x(this->random);
+          center.y = y(this->random);
+          this->clusters.push_back(center);
+        }
+      }
+    }
+  }
+
+  /**
+   * Places a sprite according to the pattern.
+   * @return The coordinates of the sprite.
+   */
+  sPoint cLevel_Generator::Place_Sprite() {
+    sPoint position;
+    if (this->clusters.size() > 0) {
+      std::uniform_int_distribution<int> cluster(0, this->clusters.size() - 1);
+      std::normal_distribution<double> spread(0.0, this->screen_width / 2);
+      sPoint& center = this->clusters[cluster(this->random)];
+      position.x = std::min(std::max(center.x + (int)spread(this->random), 0), this->world_width - 1);
+      position.y = std::min(std::max(center.y + (int)spread(this->random), 0), this->world_height - 1);
+    }
+    else {
+      std::uniform_int_distribution<int> x(0, this->world_width - 1);
+      std::uniform_int_distribution<int> y(0, this->world_height - 1);
+      position.x = x(this->random);
+      position.y = y(this->random);
+    }
+    return position;
+  }
+
+  /**
+   * Picks the number of tiles of a sprite. Each size is half as likely as the
+   * one below it, so most sprites are a single tile.
+   * @return The number of tiles.
+   */
+  int cLevel_Generator::Pick_Size() {
+    std::bernoulli_distribution grow(0.5);
+    int size = 1;
+    while ((size < this->max_size) && grow(this->random)) {
+      size++;
+    }
+    return size;
+  }
+
+  /**
+   * Picks a layer by the mix.
+   * @return The index of the layer.
+   */
+  int cLevel_Generator::Pick_Layer() {
+    return this->layer_picker(this->random);
+  }
+
+  /**
+   * Picks a sprite type for a layer. Layers that no type goes on get any type
+   * in the palette.
+   * @param layer The index of the layer.
+   * @return The sprite type.
+   */
+  tObject& cLevel_Generator::Pick_Type(int layer) {
+    std::vector<tObject>& types = (this->layer_types[layer].size() > 0) ? this->layer_types[layer] : this->types;
+    std::uniform_int_distribution<int> type(0, types.size() - 1);
+    return types[type(this->random)];
+  }
+
+}
+
+// ****************************************************************************
+// Undo History
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates an empty undo history with no memory limit.
+   */
+  cUndo_History::cUndo_History() {
+    this->memory = 0;
+    this->limit = 0;
+    this->sealed = true;
+  }
+
+  /**
+   * Makes an undo entry with its fields cleared.
+   * @param op The operation that was done.
+   * @param layer The index of the layer or NO_VALUE_FOUND.
+   * @param sprite The index of the sprite or NO_VALUE_FOUND.
+   * @return The entry.
+   */
+  sUndo_Entry cUndo_History::Make_Entry(int op, int layer, int sprite) {
+    sUndo_Entry entry;
+    entry.op = op;
+    entry.layer = layer;
+    entry.new_layer = NO_VALUE_FOUND;
+    entry.sprite = sprite;
+    entry.old_x = 0;
+    entry.old_y = 0;
+    entry.new_x = 0;
+    entry.new_y = 0;
+    entry.had_value = false;
+    entry.has_value = false;
+    return entry;
+  }
+
+  /**
+   * Records a change. Changes that cannot be redone any more are dropped and
+   * the oldest entries are dropped once the memory limit is reached.
+   * @param entry The change.
+   */
+  void cUndo_History::Record(sUndo_Entry& entry) {
+    if (!this->Coalesce(entry)) {
+      this->memory += this->Get_Size(entry);
+      this->undo_entries.push_back(entry);
+    }
+    while (this->redo_entries.size() > 0) {
+      this->memory -= this->Get_Size(this->redo_entries.back());
+      this->redo_entries.pop_back();
+    }
+    this->sealed = false;
+    this->Trim();
+  }
+
+  /**
+   * Undoes the last change.
+   * @param level The level to undo the change on.
+   * @return True if there was a change to undo, false otherwise.
+   */
+  bool cUndo_History::Undo(cLevel& level) {
+    bool undone = false;
+    if (this->undo_entries.size() > 0) {
+      sUndo_Entry entry = this->undo_entries.back();
+      this->undo_entries.pop_back();
+      this->memory -= this->Get_Size(entry);
+      this->Apply(level, entry, true);
+      this->memory += this->Get_Size(entry);
+      this->redo_entries.push_back(entry);
+      undone = true;
+    }
+    this->sealed = true;
+    return undone;
+  }
+
+  /**
+   * Redoes the last change that was undone.
+   * @param level The level to redo the change on.
+   * @return True if there was a change to redo, false otherwise.
+   */
+  bool cUndo_History::Redo(cLevel& level) {
+    bool redone = false;
+    if (this->redo_entries.size() > 0) {
+      sUndo_Entry entry = this->redo_entries.back();
+      this->redo_entries.pop_back();
+      this->memory -= this->Get_Size(entry);
+      this->Apply(level, entry, false);
+      this->memory += this->Get_Size(entry);
+      this->undo_entries.push_back(entry);
+      redone = true;
+    }
+    this->sealed = true;
+    return redone;
+  }
+
+  /**
+   * Stops the next change from being folded into the last one.
+   */
+  void cUndo_History::Seal() {
+    this->sealed = true;
+  }
+
+  /**
+   * Clears out all changes.
+   */
+  void cUndo_History::Clear() {
+    this->undo_entries.clear();
+    this->redo_entries.clear();
+    this->memory = 0;
+    this->sealed = true;
+  }
+
+  /**
+   * Folds a change into the last one if it continues it, such as the next
+   * frame of a drag or another nudge of the same sprites.
+   * @param entry The change.
+   * @return True if the change was folded in, false otherwise.
+   */
+  bool cUndo_History::Coalesce(sUndo_Entry& entry) {
+    bool coalesced = false;
+    if (!this->sealed && (this->undo_entries.size() > 0)) {
+      sUndo_Entry& last = this->undo_entries.back();
+      if ((last.op == entry.op) && (last.layer == entry.layer) && (last.sprite == entry.sprite)) {
+        if ((entry.op == eUNDO_MOVE) || (entry.op == eUNDO_RESIZE)) {
+          last.new_x = entry.new_x;
+          last.new_y = entry.new_y;
+          coalesced = true;
+        }
+        else if ((entry.op == eUNDO_PROPERTY) && (last.key == entry.key)) {
+          this->memory -= this->Get_Size(last);
+          last.has_value = entry.has_value;
+          last.new_value = entry.new_value;
+          this->memory += this->Get_Size(last);
+          coalesced = true;
+        }
+        else if ((entry.op == eUNDO_BACKGROUND) || (entry.op == eUNDO_MUSIC_TRACK)) {
+          last.new_text = entry.new_text;
+          coalesced = true;
+        }
+        else if ((entry.op == eUNDO_SHIFT) && (last.sprites == entry.sprites)) {
+          last.new_x += entry.new_x;
+          last.new_y += entry.new_y;
+          coalesced = true;
+        }
+        else if ((entry.op == eUNDO_GROW) && (last.sprites == entry.sprites) && (last.clamped.size() == 0) && (entry.clamped.size() == 0)) {
+          last.new_x += entry.new_x; // Sizes never hit the floor so the offsets add up.
+          last.new_y += entry.new_y;
+          coalesced = true;
+        }
+      }
+    }
+    return coalesced;
+  }
+
+  /**
+   * Applies a change in either direction. The change is made through the
+   * level so it is journaled, but it is not recorded again.
+   * @param level The level to apply the change to.
+   * @param entry The change.
+   * @param undo True to undo the change, false to redo it.
+   */
+  void cUndo_History::Apply(cLevel& level, sUndo_Entry& entry, bool undo) {
+    cUndo_History* history = level.history;
+    level.history = NULL;
+    int sign = undo ? -1 : 1;
+    if (entry.op == eUNDO_MOVE) {
+      level.Move_Sprite(entry.layer, entry.sprite, undo ? entry.old_x : entry.new_x, undo ? entry.old_y : entry.new_y);
+    }
+    else if (entry.op == eUNDO_RESIZE) {
+      level.Resize_Sprite(entry.layer, entry.sprite, undo ? entry.old_x : entry.new_x, undo ? entry.old_y : entry.new_y);
+    }
+    else if (entry.op == eUNDO_ADD) {
+      cSprite_Store& store = level.layers[entry.layer];
+      if (undo) { // Keep the sprites so they can be added back.
+        entry.records.clear();
+        int sprite_count = entry.sprites.size();
+        for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+          entry.records.push_back(store.Get_Record(entry.sprites[sprite_index]));
+        }
+        level.Remove_Sprites(entry.layer, entry.sprites);
+      }
+      else {
+        level.Insert_Sprites(entry.layer, entry.sprites, entry.records, store);
+        entry.records.clear();
+      }
+    }
+    else if (entry.op == eUNDO_REMOVE) {
+      if (undo) {
+        level.Insert_Sprites(entry.layer, entry.sprites, entry.records, level.layers[entry.layer]);
+      }
+      else {
+        level.Remove_Sprites(entry.layer, entry.sprites);
+      }
+    }
+    else if (entry.op == eUNDO_PROPERTY) {
+      if (undo ? entry.had_value : entry.has_value) {
+        level.Set_Sprite_Property(entry.layer, entry.sprite, entry.key, undo ? entry.old_value : entry.new_value);
+      }
+      else {
+        level.Remove_Sprite_Property(entry.layer, entry.sprite, entry.key);
+      }
+    }
+    else if (entry.op == eUNDO_BACKGROUND) {
+      level.Set_Background(undo ? entry.old_text : entry.new_text);
+    }
+    else if (entry.op == eUNDO_MUSIC_TRACK) {
+      level.Set_Music_Track(undo ? entry.old_text : entry.new_text);
+    }
+    else if (entry.op == eUNDO_SHIFT) {
+      level.Move_Sprites(entry.layer, entry.sprites, sign * entry.new_x, sign * entry.new_y);
+    }
+    else if (entry.op == eUNDO_GROW) {
+      level.Resize_Sprites(entry.layer, entry.sprites, sign * entry.new_x, sign * entry.new_y);
+      if (undo) { // Sprites that hit one tile get their sizes back.
+        int clamp_count = entry.clamped.size();
+        for (int clamp_index = 0; clamp_index < clamp_count; clamp_index += 3) {
+          level.Resize_Sprite(entry.layer, entry.clamped[clamp_index], entry.clamped[clamp_index + 1], entry.clamped[clamp_index + 2]);
+        }
+      }
+    }
+    else if (entry.op == eUNDO_RELAYER) {
+      if (undo) {
+        cSprite_Store& target = level.layers[entry.new_layer];
+        std::vector<sSprite_Record> records;
+        int sprite_count = entry.moved.size();
+        for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+          records.push_back(target.Get_Record(entry.moved[sprite_index]));
+        }
+        level.Remove_Sprites(entry.new_layer, entry.moved);
+        level.Insert_Sprites(entry.layer, entry.sprites, records, target);
+      }
+      else {
+        std::vector<int> sprites = entry.sprites;
+        level.Change_Layer(entry.layer, sprites, entry.new_layer);
+      }
+    }
+    level.history = history;
+  }
+
+  /**
+   * Estimates the memory used by a change.
+   * @param entry The change.
+   * @return The number of bytes.
+   */
+  long long cUndo_History::Get_Size(sUndo_Entry& entry) {
+    long long size = sizeof(sUndo_Entry);
+    size += (entry.sprites.capacity() + entry.moved.capacity() + entry.clamped.capacity()) * sizeof(int);
+    size += entry.records.capacity() * sizeof(sSprite_Record);
+    int record_count = entry.records.size();
+    for (int record_index = 0; record_index < record_count; record_index++) {
+      size += entry.records[record_index].extra.Count() * (sizeof(cValue) + 32); // Key and value text.
+    }
+    size += entry.key.capacity() + entry.old_text.capacity() + entry.new_text.capacity();
+    size += entry.old_value.string.capacity() + entry.new_value.string.capacity();
+    return size;
+  }
+
+  /**
+   * Drops the oldest changes until the history fits in its memory limit. The
+   * newest change is always kept so the last edit can be undone.
+   */
+  void cUndo_History::Trim() {
+    while ((this->limit > 0) && (this->memory > this->limit) && (this->undo_entries.size() > 1)) {
+      this->memory -= this->Get_Size(this->undo_entries.front());
+      this->undo_entries.pop_front();
+    }
+  }
+
+  /**
+   * Follows sprites being dropped from the level without being edited, such
+   * as chunks that were streamed out. The indices in each change are moved
+   * down past the dropped sprites. A change that touches a dropped sprite
+   * cannot be applied any more so it is dropped along with every change
+   * before it on the undo side or after it on the redo side.
+   * @param dropped The dropped sprites for each layer, in order.
+   */
+  void cUndo_History::Drop_Sprites(std::vector<std::vector<int> >& dropped) {
+    std::vector<std::vector<int> > gone = dropped;
+    int entry_index = this->undo_entries.size() - 1;
+    while ((entry_index >= 0) && this->Drop_From_Entry(this->undo_entries[entry_index], gone, true)) {
+      entry_index--;
+    }
+    for (int drop_index = 0; drop_index <= entry_index; drop_index++) {
+      this->memory -= this->Get_Size(this->undo_entries.front());
+      this->undo_entries.pop_front();
+    }
+    gone = dropped;
+    entry_index = this->redo_entries.size() - 1; // The next change to redo is at the back.
+    while ((entry_index >= 0) && this->Drop_From_Entry(this->redo_entries[entry_index], gone, false)) {
+      entry_index--;
+    }
+    for (int drop_index = 0; drop_index <= entry_index; drop_index++) {
+      this->memory -= this->Get_Size(this->redo_entries.front());
+      this->redo_entries.pop_front();
+    }
+    this->sealed = true;
+  }
+
+  /**
+   * Moves the indices of one change past the dropped sprites. The dropped
+   * sprites are then carried to the other side of the change, which moves
+   * them around the sprites it adds or removes, so the next change can be
+   * checked against them.
+   * @param entry The change.
+   * @param gone The dropped sprites for each layer as they stand on one side of the change.
+   * @param after True if the dropped sprites stand after the change, false if before.
+   * @return True if the change is kept, false if it touches a dropped sprite.
+   */
+  bool cUndo_History::Drop_From_Entry(sUndo_Entry& entry, std::vector<std::vector<int> >& gone, bool after) {
+    bool kept = true;
+    if ((entry.op == eUNDO_MOVE) || (entry.op == eUNDO_RESIZE) || (entry.op == eUNDO_PROPERTY)) {
+      entry.sprite = this->Shift_Sprite(gone[entry.layer], entry.sprite);
+      kept = (entry.sprite != NO_VALUE_FOUND);
+    }
+    else if ((entry.op == eUNDO_SHIFT) || (entry.op == eUNDO_GROW)) {
+      kept = this->Shift_Sprites(gone[entry.layer], entry.sprites, 1) && this->Shift_Sprites(gone[entry.layer], entry.clamped, 3);
+    }
+    else if ((entry.op == eUNDO_ADD) || (entry.op == eUNDO_REMOVE)) {
+      std::vector<int> sprites = entry.sprites;
+      if ((entry.op == eUNDO_ADD) == after) { // The sprites are in the level on this side.
+        kept = this->Shift_Sprites(gone[entry.layer], entry.sprites, 1);
+        this->Remove_Sprites(gone[entry.layer], sprites);
+      }
+      else {
+        this->Insert_Sprites(gone[entry.layer], sprites);
+        this->Shift_Sprites(gone[entry.layer], entry.sprites, 1);
+      }
+    }
+    else if (entry.op == eUNDO_RELAYER) {
+      std::vector<int>& source = after ? entry.moved : entry.sprites;
+      std::vector<int>& target = after ? entry.sprites : entry.moved;
+      std::vector<int>& source_gone = after ? gone[entry.new_layer] : gone[entry.layer];
+      std::vector<int>& target_gone = after ? gone[entry.layer] : gone[entry.new_layer];
+      std::vector<int> sprites = source;
+      kept = this->Shift_Sprites(source_gone, source, 1);
+      this->Remove_Sprites(source_gone, sprites);
+      this->Insert_Sprites(target_gone, target);
+      this->Shift_Sprites(target_gone, target, 1);
+    }
+    return kept;
+  }
+
+  /**
+   * Gets the index a sprite has once some sprites are dropped.
+   * @param gone The dropped sprites in order.
+   * @param sprite The index of the sprite.
+   * @return The new index or NO_VALUE_FOUND if the sprite was dropped.
+   */
+  int cUndo_History::Shift_Sprite(std::vector<int>& gone, int sprite) {
+    int index = NO_VALUE_FOUND;
+    std::vector<int>::iterator position = std::lower_bound(gone.begin(), gone.end(), sprite);
+    if ((position == gone.end()) || (*position != sprite)) {
+      index = sprite - (position - gone.begin());
+    }
+    return index;
+  }
+
+  /**
+   * Moves a list of sprite indices past some dropped sprites.
+   * @param gone The dropped sprites in order.
+   * @param sprites The sprite indices. Dropped sprites are left as they are.
+   * @param step The distance between indices in the list.
+   * @return True if none of the sprites was dropped, false otherwise.
+   */
+  bool cUndo_History::Shift_Sprites(std::vector<int>& gone, std::vector<int>& sprites, int step) {
+    bool kept = true;
+    int sprite_count = sprites.size();
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index += step) {
+      int sprite = this->Shift_Sprite(gone, sprites[sprite_index]);
+      if (sprite != NO_VALUE_FOUND) {
+        sprites[sprite_index] = sprite;
+      }
+      else {
+        kept = false;
+      }
+    }
+    return kept;
+  }
+
+  /**
+   * Moves dropped sprites down past sprites that a change takes out.
+   * @param gone The dropped sprites in order.
+   * @param sprites The sprites taken out, in order. None of them are dropped ones.
+   */
+  void cUndo_History::Remove_Sprites(std::vector<int>& gone, std::vector<int>& sprites) {
+    int gone_count = gone.size();
+    for (int gone_index = 0; gone_index < gone_count; gone_index++) {
+      gone[gone_index] -= std::lower_bound(sprites.begin(), sprites.end(), gone[gone_index]) - sprites.begin();
+    }
+  }
+
+  /**
+   * Moves dropped sprites up past sprites that a change puts in.
+   * @param gone The dropped sprites in order.
+   * @param sprites The indices the sprites are put in at, in order.
+   */
+  void cUndo_History::Insert_Sprites(std::vector<int>& gone, std::vector<int>& sprites) {
+    int gone_count = gone.size();
+    int sprite_count = sprites.size();
+    int sprite_index = 0;
+    for (int gone_index = 0; gone_index < gone_count; gone_index++) {
+      while ((sprite_index < sprite_count) && (sprites[sprite_index] <= (gone[gone_index] + sprite_index))) {
+        sprite_index++;
+      }
+      gone[gone_index] += sprite_index;
+    }
+  }
+
+}
+
+// ****************************************************************************
+// Level Index
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates an empty level index.
+   */
+  cLevel_Index::cLevel_Index() {
+    this->io = NULL;
+    this->folder_time = 0;
+    this->poll_interval = 0;
+    this->poll_timer = 0;
+  }
+
+  /**
+   * Sets up the index on the current folder and builds it.
+   * @param io The I/O control used to list files.
+   * @param poll_interval The number of frames between checks of the folder.
+   */
+  void cLevel_Index::Setup(cIO_Control* io, int poll_interval) {
+    this->io = io;
+    this->folder = io->Get_Current_Folder();
+    this->poll_interval = poll_interval;
+    this->poll_timer = poll_interval;
+    this->Refresh();
+  }
+
+  /**
+   * Rebuilds the index by listing the folder. The level names are kept
+   * sorted so they can be searched.
+   */
+  void cLevel_Index::Refresh() {
+    this->folder_time = this->Get_Folder_Time();
+    this->names.clear();
+    cArray<std::string> files = this->io->Get_File_List(this->folder);
+    int file_count = files.Count();
+    for (int file_index = 0; file_index < file_count; file_index++) {
+      std::string file = files[file_index];
+      if (this->io->Get_File_Extension(file) == "map") {
+        this->names.push_back(this->io->Get_File_Title(file));
+      }
+    }
+    std::sort(this->names.begin(), this->names.end());
+    this->levels = cArray<std::string>();
+    this->levels.Add("None"); // Add no level option.
+    int name_count = this->names.size();
+    for (int name_index = 0; name_index < name_count; name_index++) {
+      this->levels.Add(this->names[name_index]);
+    }
+  }
+
+  /**
+   * Counts down to the next check of the folder. The folder is only listed
+   * again if its modification time changed. A folder changed within the last
+   * second is listed again in case it changes again within the same second.
+   */
+  void cLevel_Index::Poll() {
+    if (this->poll_interval > 0) {
+      this->poll_timer--;
+      if (this->poll_timer <= 0) {
+        long long folder_time = this->Get_Folder_Time();
+        if ((folder_time != this->folder_time) || (folder_time >= ((long long)std::time(NULL) - 1))) {
+          this->Refresh();
+        }
+        this->poll_timer = this->poll_interval;
+      }
+    }
+  }
+
+  /**
+   * Finds a level in the index.
+   * @param name The name of the level.
+   * @return The index of the level in the level list or NO_VALUE_FOUND if it is not there.
+   */
+  int cLevel_Index::Find(std::string name) {
+    int level = NO_VALUE_FOUND;
+    if (name == "None") {
+      level = 0;
+    }
+    else {
+      std::vector<std::string>::iterator found = std::lower_bound(this->names.begin(), this->names.end(), name);
+      if ((found != this->names.end()) && (*found == name)) {
+        level = (found - this->names.begin()) + 1; // After the no level option.
+      }
+    }
+    return level;
+  }
+
+  /**
+   * Gets the time the folder was last changed.
+   * @return The time in seconds or zero if the folder could not be read.
+   */
+  long long cLevel_Index::Get_Folder_Time() {
+    long long folder_time = 0;
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (GetFileAttributesExA(this->folder.c_str(), GetFileExInfoStandard, &attributes)) {
+      unsigned long long ticks = ((unsigned long long)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+      folder_time = (long long)((ticks - 116444736000000000ULL) / 10000000ULL); // 100 ns ticks since 1601 to seconds since 1970.
+    }
+#else
+    struct stat folder_stat;
+    if (stat(this->folder.c_str(), &folder_stat) == 0) {
+      folder_time = folder_stat.st_mtime;
+    }
+#endif
+    return folder_time;
+  }
+
+}
+
+// ****************************************************************************
+// Project Validator
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates a validator for the levels in a folder.
+   * @param config The config parser.
+   * @param folder The folder holding the levels.
+   */
+  cProject_Validator::cProject_Validator(cConfig& config, std::string folder) {
+    this->folder = folder;
+    this->palette = config.Get_Text_Property("palette");
+    this->layers = Parse_Sausage_Text(config.Get_Text_Property("layers"), ",");
+    this->next_level = 0;
+    this->thread_count = std::max((int)std::thread::hardware_concurrency(), 1);
+    this->problem_count = 0;
+  }
+
+  /**
+   * Lists the levels in the folder. The levels are sorted by name so the
+   * report comes out in the same order every time.
+   * @throws An error if the folder could not be read.
+   */
+  void cProject_Validator::List_Levels() {
+    std::vector<std::string> names;
+#ifdef _WIN32
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA((this->folder + "\\*.map").c_str(), &find_data);
+    if (find_handle != INVALID_HANDLE_VALUE) {
+      do {
+        names.push_back(find_data.cFileName);
+      } while (FindNextFileA(find_handle, &find_data));
+      FindClose(find_handle);
+    }
+    else {
+      Check_Condition((GetLastError() == ERROR_FILE_NOT_FOUND), "Could not read folder " + this->folder + "."); // A folder with no levels is empty.
+    }
+#else
+    DIR* dir = opendir(this->folder.c_str());
+    Check_Condition((dir != NULL), "Could not read folder " + this->folder + ".");
+    struct dirent* entry = readdir(dir);
+    while (entry != NULL) {
+      names.push_back(entry->d_name);
+      entry = readdir(dir);
+    }
+    closedir(dir);
+#endif
+    std::sort(names.begin(), names.end());
+    this->reports.clear();
+    this->ids.clear();
+    int name_count = names.size();
+    for (int name_index = 0; name_index < name_count; name_index++) {
+      std::string name = names[name_index];
+      if ((name.length() > 4) && (name.compare(name.length() - 4, 4, ".map") == 0)) {
+        sLevel_Report report;
+        report.name = name.substr(0, name.length() - 4);
+        this->ids[report.name] = this->reports.size();
+        this->reports.push_back(report);
+      }
+    }
+  }
+
+  /**
+   * Loads every level on a pool of threads. Each level is loaded on its own
+   * so the threads share nothing but the counter of the next level.
+   */
+  void cProject_Validator::Load_Levels() {
+    this->next_level = 0;
+    int thread_count = std::min(this->thread_count, std::max((int)this->reports.size(), 1));
+    std::vector<std::thread> threads;
+    for (int thread_index = 0; thread_index < thread_count; thread_index++) {
+      threads.push_back(std::thread(&cProject_Validator::Load_Worker, this));
+    }
+    for (int thread_index = 0; thread_index < thread_count; thread_index++) {
+      threads[thread_index].join();
+    }
+  }
+
+  /**
+   * Takes levels from the list and loads them until none are left.
+   */
+  void cProject_Validator::Load_Worker() {
+    int report_count = this->reports.size();
+    int level_index = this->next_level++;
+    while (level_index < report_count) {
+      this->Scan_Level(this->reports[level_index]);
+      level_index = this->next_level++;
+    }
+  }
+
+  /**
+   * Loads a level and collects its links and the pipes that lead into it.
+   * Only the links are kept so that the level can be freed right away.
+   * @param report The report to fill in. A level that does not load gets an error.
+   */
+  void cProject_Validator::Scan_Level(sLevel_Report& report) {
+    try {
+      cLevel level;
+      level.Setup(this->layers, NULL);
+      level.Load_Templates(this->palette);
+      level.Load(this->folder + "/" + report.name + ".map");
+      int layer_count = level.layers.size();
+      for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+        cSprite_Store& store = level.layers[layer_index];
+        int sprite_count = store.Count();
+        for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+          if (store.Has_Property(sprite_index, "pointer-type")) {
+            std::string type = level.Format_Value(store.Get_Property(sprite_index, "pointer-type"));
+            std::string code = store.Has_Property(sprite_index, "pointer-code") ? level.Format_Value(store.Get_Property(sprite_index, "pointer-code")) : "";
+            report.entries.push_back(type + ":" + code);
+            if (store.Has_Property(sprite_index, "pointer-level")) {
+              sLevel_Link link;
+              link.layer = store.layer;
+              link.x = store.x[sprite_index];
+              link.y = store.y[sprite_index];
+              link.level = level.Format_Value(store.Get_Property(sprite_index, "pointer-level"));
+              link.type = type;
+              link.code = code;
+              if (link.level != "None") {
+                report.links.push_back(link);
+              }
+            }
+          }
+          else if (store.Has_Property(sprite_index, "pointer-level")) {
+            sLevel_Link link;
+            link.layer = store.layer;
+            link.x = store.x[sprite_index];
+            link.y = store.y[sprite_index];
+            link.level = level.Format_Value(store.Get_Property(sprite_index, "pointer-level"));
+            if (link.level != "None") {
+              report.links.push_back(link);
+            }
+          }
+        }
+      }
+      std::sort(report.entries.begin(), report.entries.end());
+      report.entries.erase(std::unique(report.entries.begin(), report.entries.end()), report.entries.end());
+    }
+    catch (cError error) {
+      report.error = error.message;
+    }
+  }
+
+  /**
+   * Loads all the levels and checks the links between them.
+   * @param starts The levels the game starts in. If none are given the first level is used.
+   * @return The number of problems found.
+   * @throws An error if the folder could not be read.
+   */
+  int cProject_Validator::Validate(std::vector<std::string>& starts) {
+    this->problem_count = 0;
+    this->List_Levels();
+    this->Load_Levels();
+    int report_count = this->reports.size();
+    for (int report_index = 0; report_index < report_count; report_index++) {
+      sLevel_Report& report = this->reports[report_index];
+      if (report.error.length() > 0) {
+        this->Report(report.name + ": does not load: " + report.error);
+      }
+    }
+    this->Check_Links();
+    this->Check_Reachable(starts);
+    return this->problem_count;
+  }
+
+  /**
+   * Checks that every link points to a level that loads and, for typed links
+   * like pipes, that the level has a matching entry with the same code.
+   */
+  void cProject_Validator::Check_Links() {
+    int report_count = this->reports.size();
+    for (int report_index = 0; report_index < report_count; report_index++) {
+      sLevel_Report& report = this->reports[report_index];
+      int link_count = report.links.size();
+      for (int link_index = 0; link_index < link_count; link_index++) {
+        sLevel_Link& link = report.links[link_index];
+        std::string where = report.name + " (" + link.layer + " " + Number_To_Text(link.x) + ", " + Number_To_Text(link.y) + ")";
+        std::unordered_map<std::string, int>::iterator target = this->ids.find(link.level);
+        if (target == this->ids.end()) {
+          this->Report(where + ": points to missing level " + link.level + ".");
+        }
+        else if (this->reports[target->second].error.length() > 0) {
+          this->Report(where + ": points to level " + link.level + " which does not load.");
+        }
+        else if (link.type.length() > 0) {
+          std::vector<std::string>& entries = this->reports[target->second].entries;
+          if (!std::binary_search(entries.begin(), entries.end(), link.type + ":" + link.code)) {
+            this->Report(where + ": " + link.type + " code " + link.code + " has no match in level " + link.level + ".");
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * Walks the links from the start levels and reports every level that
+   * cannot be reached.
+   * @param starts The levels the game starts in. If none are given the first level is used.
+   */
+  void cProject_Validator::Check_Reachable(std::vector<std::string>& starts) {
+    int report_count = this->reports.size();
+    std::vector<bool> reached(report_count, false);
+    std::vector<int> pending;
+    if ((starts.size() == 0) && (report_count > 0)) {
+      starts.push_back(this->reports[0].name);
+    }
+    int start_count = starts.size();
+    for (int start_index = 0; start_index < start_count; start_index++) {
+      std::unordered_map<std::string, int>::iterator start = this->ids.find(starts[start_index]);
+      if (start == this->ids.end()) {
+        this->Report("Start level " + starts[start_index] + " does not exist.");
+      }
+      else if (!reached[start->second]) {
+        reached[start->second] = true;
+        pending.push_back(start->second);
+      }
+    }
+    while (pending.size() > 0) {
+      sLevel_Report& report = this->reports[pending.back()];
+      pending.pop_back();
+      int link_count = report.links.size();
+      for (int link_index = 0; link_index < link_count; link_index++) {
+        std::unordered_map<std::string, int>::iterator target = this->ids.find(report.links[link_index].level);
+        if ((target != this->ids.end()) && !reached[target->second]) {
+          reached[target->second] = true;
+          pending.push_back(target->second);
+        }
+      }
+    }
+    for (int report_index = 0; report_index < report_count; report_index++) {
+      if (!reached[report_index]) {
+        this->Report(this->reports[report_index].name + ": cannot be reached from the start.");
+      }
+    }
+  }
+
+  /**
+   * Prints a problem and counts it.
+   * @param problem The description of the problem.
+   */
+  void cProject_Validator::Report(std::string problem) {
+    std::cout << problem << std::endl;
+    this->problem_count++;
+  }
+
+}
+
+// ****************************************************************************
+// Layer Cache
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates an empty layer cache.
+   */
+  cLayer_Cache::cLayer_Cache() {
+    this->area.left = 0;
+    this->area.top = 0;
+    this->area.right = 0;
+    this->area.bottom = 0;
+    this->valid = false;
+    this->draw_count = 0;
+    this->visit_count = 0;
+    this->cull_count = 0;
+  }
+
+  /**
+   * Brings the cache up to date for a view. The tiles are only laid out again
+   * if the view left the cached area or an edit touched the cached area.
+   * Layers that are not being edited are never laid out again while the view
+   * stays put.
+   * @param store The sprites on the layer.
+   * @param view The view in level coordinates.
+   */
+  void cLayer_Cache::Update(cSprite_Store& store, sRectangle view) {
+    sRectangle dirty;
+    if (store.grid.Take_Dirty(dirty)) {
+      if ((dirty.left <= this->area.right) && (dirty.right >= this->area.left) && (dirty.top <= this->area.bottom) && (dirty.bottom >= this->area.top)) {
+        this->valid = false;
+      }
+    }
+    if (!this->valid || (view.left < this->area.left) || (view.top < this->area.top) || (view.right > this->area.right) || (view.bottom > this->area.bottom)) {
+      this->Build(store, view);
+    }
+  }
+
+  /**
+   * Lays out the tiles of every sprite around a view. A margin is added
+   * around the view so small scrolls do not need a new layout. Each sprite
+   * is kept as one run of tiles cut down to the cached area.
+   * @param store The sprites on the layer.
+   * @param view The view in level coordinates.
+   */
+  void cLayer_Cache::Build(cSprite_Store& store, sRectangle view) {
+    this->area.left = view.left - LAYER_CACHE_MARGIN;
+    this->area.top = view.top - LAYER_CACHE_MARGIN;
+    this->area.right = view.right + LAYER_CACHE_MARGIN;
+    this->area.bottom = view.bottom + LAYER_CACHE_MARGIN;
+    this->tiles.clear();
+    store.grid.Query(this->area, this->sprites);
+    int sprite_count = this->sprites.size();
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+      int sprite = this->sprites[sprite_index];
+      sTile tile;
+      tile.image = store.icons[sprite];
+      tile.width = std::max(store.width[sprite], 1);
+      tile.height = std::max(store.height[sprite], 1);
+      int x = store.x[sprite];
+      int y = store.y[sprite];
+      int first_x = (this->area.left > x) ? (this->area.left - x) / tile.width : 0;
+      int first_y = (this->area.top > y) ? (this->area.top - y) / tile.height : 0;
+      int last_x = std::min(store.size_x[sprite] - 1, (this->area.right - x) / tile.width);
+      int last_y = std::min(store.size_y[sprite] - 1, (this->area.bottom - y) / tile.height);
+      if ((last_x >= first_x) && (last_y >= first_y)) {
+        tile.x = x + (first_x * tile.width);
+        tile.y = y + (first_y * tile.height);
+        tile.count_x = last_x - first_x + 1;
+        tile.count_y = last_y - first_y + 1;
+        this->tiles.push_back(tile);
+      }
+    }
+    this->valid = true;
+  }
+
+  /**
+   * Draws the cached tiles that are in view. Each run is cut down to the
+   * view and drawn with one call if the control can draw tiled images. The
+   * draws, the sprites looked at, and the sprites out of view are counted.
+   * @param io The I/O control to draw with.
+   * @param tiled_io The same control if it draws tiled images, or NULL.
+   * @param images The images of the level.
+   * @param view The view in level coordinates.
+   */
+  void cLayer_Cache::Draw(cIO_Control* io, cTiled_IO* tiled_io, cImage_Table& images, sRectangle view) {
+    int tile_count = this->tiles.size();
+    this->draw_count = 0;
+    this->visit_count = tile_count;
+    this->cull_count = 0;
+    for (int tile_index = 0; tile_index < tile_count; tile_index++) {
+      sTile& tile = this->tiles[tile_index];
+      int first_x = (view.left > tile.x) ? (view.left - tile.x) / tile.width : 0;
+      int first_y = (view.top > tile.y) ? (view.top - tile.y) / tile.height : 0;
+      int last_x = (view.right >= tile.x) ? std::min(tile.count_x - 1, (view.right - tile.x) / tile.width) : -1;
+      int last_y = (view.bottom >= tile.y) ? std::min(tile.count_y - 1, (view.bottom - tile.y) / tile.height) : -1;
+      if ((last_x >= first_x) && (last_y >= first_y)) {
+        std::string& name = images.Get(tile.image).name;
+        int x = tile.x + (first_x * tile.width) - view.left;
+        int y = tile.y + (first_y * tile.height) - view.top;
+        if (tiled_io) {
+          tiled_io->Draw_Image_Tiled(name, x, y, tile.width, tile.height, last_x - first_x + 1, last_y - first_y + 1);
+          this->draw_count++;
+        }
+        else {
+          for (int tile_y = first_y; tile_y <= last_y; tile_y++) {
+            for (int tile_x = first_x; tile_x <= last_x; tile_x++) {
+              io->Draw_Image(name, x + ((tile_x - first_x) * tile.width), y + ((tile_y - first_y) * tile.height), tile.width, tile.height, 0, false, false);
+            }
+          }
+          this->draw_count += (last_x - first_x + 1) * (last_y - first_y + 1);
+        }
+      }
+      else {
+        this->cull_count++;
+      }
+    }
+  }
+
+}
+
+// ****************************************************************************
+// Allegro Tiled I/O
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates the Allegro I/O control with tiled drawing.
+   * @param title The title of the window.
+   * @param width The width of the screen.
+   * @param height The height of the screen.
+   * @param scale The scale of the screen.
+   * @param font The name of the font.
+   */
+  cAllegro_Tiled_IO::cAllegro_Tiled_IO(std::string title, int width, int height, int scale, std::string font) : cAllegro_IO(title, width, height, scale, font) {
+    this->stop_loading = false;
+    this->scale = std::max(scale, 1);
+    this->input_events = NULL;
+    this->input_queue = NULL;
+    this->stop_input = false;
+    this->mouse_button = NO_VALUE_FOUND;
+  }
+
+  /**
+   * Stops the image loaders.
+   */
+  cAllegro_Tiled_IO::~cAllegro_Tiled_IO() {
+    this->Stop_Input();
+    this->load_lock.lock();
+    this->stop_loading = true;
+    this->load_lock.unlock();
+    int loader_count = this->loaders.size();
+    for (int loader_index = 0; loader_index < loader_count; loader_index++) {
+      this->loaders[loader_index].join();
+    }
+    while (this->loaded_images.size() > 0) {
+      al_destroy_bitmap(this->loaded_images.front().bitmap);
+      this->loaded_images.pop_front();
+    }
+  }
+
+  /**
+   * Draws an image repeated over a grid of tiles. Drawing is held while the
+   * tiles are drawn so Allegro sends them to the card as one batch.
+   * @param name The name of the image.
+   * @param x The x coordinate of the first tile.
+   * @param y The y coordinate of the first tile.
+   * @param width The width of a tile.
+   * @param height The height of a tile.
+   * @param count_x The number of tiles across.
+   * @param count_y The number of tiles down.
+   */
+  void cAllegro_Tiled_IO::Draw_Image_Tiled(std::string name, int x, int y, int width, int height, int count_x, int count_y) {
+    al_hold_bitmap_drawing(true);
+    for (int tile_y = 0; tile_y < count_y; tile_y++) {
+      for (int tile_x = 0; tile_x < count_x; tile_x++) {
+        this->Draw_Image(name, x + (tile_x * width), y + (tile_y * height), width, height, 0, false, false);
+      }
+    }
+    al_hold_bitmap_drawing(false);
+  }
+
+}
+
+// ****************************************************************************
+// Atlas Packer
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates an atlas packer.
+   * @param page_size The width and height of an atlas page.
+   * @param padding The space left around each image so neighbours do not bleed.
+   */
+  cAtlas_Packer::cAtlas_Packer(int page_size, int padding) {
+    this->page_size = page_size;
+    this->padding = padding;
+    this->page_count = 0;
+  }
+
+  /**
+   * Adds an image to pack.
+   * @param name The name of the image.
+   * @param width The width of the image.
+   * @param height The height of the image.
+   */
+  void cAtlas_Packer::Add(std::string name, int width, int height) {
+    sAtlas_Entry entry;
+    entry.name = name;
+    entry.page = 0;
+    entry.x = 0;
+    entry.y = 0;
+    entry.width = width;
+    entry.height = height;
+    this->entries.push_back(entry);
+  }
+
+  /**
+   * Orders atlas entries from tallest to shortest, then by name.
+   * @param entry_a The first entry.
+   * @param entry_b The second entry.
+   * @return True if the first entry is packed before the second.
+   */
+  bool Is_Atlas_Entry_Before(const sAtlas_Entry& entry_a, const sAtlas_Entry& entry_b) {
+    return (entry_a.height != entry_b.height) ? (entry_a.height > entry_b.height) : (entry_a.name < entry_b.name);
+  }
+
+  /**
+   * Packs the images onto shelves. Images are placed tallest first so each
+   * shelf wastes little height, and a new page is started when one fills up.
+   * @throws An error if an image does not fit on a page.
+   */
+  void cAtlas_Packer::Pack() {
+    std::vector<sAtlas_Entry>& entries = this->entries;
+    std::sort(entries.begin(), entries.end(), Is_Atlas_Entry_Before);
+    int page = 0;
+    int shelf_x = 0;
+    int shelf_y = 0;
+    int shelf_height = 0;
+    int entry_count = entries.size();
+    for (int entry_index = 0; entry_index < entry_count; entry_index++) {
+      sAtlas_Entry& entry = entries[entry_index];
+      int width = entry.width + (this->padding * 2);
+      int height = entry.height + (this->padding * 2);
+      Check_Condition(((width <= this->page_size) && (height <= this->page_size)), "Image " + entry.name + " is too big for the atlas.");
+      if ((shelf_x + width) > this->page_size) { // Start a new shelf.
+        shelf_x = 0;
+        shelf_y += shelf_height;
+        shelf_height = 0;
+      }
+      if ((shelf_y + height) > this->page_size) { // Start a new page.
+        page++;
+        shelf_x = 0;
+        shelf_y = 0;
+        shelf_height = 0;
+      }
+      entry.page = page;
+      entry.x = shelf_x + this->padding;
+      entry.y = shelf_y + this->padding;
+      shelf_x += width;
+      shelf_height = std::max(shelf_height, height);
+    }
+    this->page_count = (entry_count > 0) ? page + 1 : 0;
+  }
+
+}
+
+// ****************************************************************************
+// Allegro Atlas
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Puts the images into atlas pages and draws them from there so that
+   * drawing does not keep switching bitmaps. The pages are cached on disk
+   * with the times of the source images and only packed again when one of
+   * them changes.
+   * @param names The names of the images to put in the atlas.
+   * @param atlas_name The name of the atlas files.
+   * @param rebuild Whether to pack the atlas even if the cache is current.
+   * @throws An error if the atlas could not be packed.
+   */
+  void cAllegro_Tiled_IO::Load_Atlas(cArray<std::string> names, std::string atlas_name, bool rebuild) {
+    std::vector<std::string> sources = this->Get_Atlas_Sources(names);
+    std::vector<sAtlas_Entry> entries;
+    if (rebuild || !this->Read_Atlas(atlas_name, sources, entries)) {
+      this->Build_Atlas(names, atlas_name, sources, entries);
+    }
+    this->Use_Atlas(entries);
+  }
+
+  /**
+   * Gets the source images with their times. This is the key of the cache.
+   * @param names The names of the images.
+   * @return One line per image with its name and time.
+   */
+  std::vector<std::string> cAllegro_Tiled_IO::Get_Atlas_Sources(cArray<std::string>& names) {
+    std::vector<std::string> sources;
+    int name_count = names.Count();
+    for (int name_index = 0; name_index < name_count; name_index++) {
+      std::stringstream source;
+      source << "source " << names[name_index] << " " << this->Get_File_Time(names[name_index] + ".png");
+      sources.push_back(source.str());
+    }
+    return sources;
+  }
+
+  /**
+   * Reads the cached atlas if it was packed from the same source images.
+   * @param atlas_name The name of the atlas files.
+   * @param sources The source images with their times.
+   * @param entries The images in the atlas.
+   * @return True if the cache was read, false if it is missing or out of date.
+   */
+  bool cAllegro_Tiled_IO::Read_Atlas(std::string atlas_name, std::vector<std::string>& sources, std::vector<sAtlas_Entry>& entries) {
+    std::ifstream index_file((atlas_name + ".txt").c_str());
+    bool valid = index_file.is_open();
+    std::string line;
+    int source_count = sources.size();
+    for (int source_index = 0; valid && (source_index < source_count); source_index++) {
+      valid = (std::getline(index_file, line) && (line == sources[source_index]));
+    }
+    int page_count = 0;
+    if (valid) {
+      valid = ((index_file >> line >> page_count) && (line == "pages"));
+    }
+    while (valid && (index_file >> line)) {
+      sAtlas_Entry entry;
+      valid = ((line == "image") && (index_file >> entry.name >> entry.page >> entry.x >> entry.y >> entry.width >> entry.height) && (entry.page < page_count));
+      if (valid) {
+        entries.push_back(entry);
+      }
+    }
+    std::vector<ALLEGRO_BITMAP*> pages;
+    for (int page_index = 0; valid && (page_index < page_count); page_index++) {
+      ALLEGRO_BITMAP* page = al_load_bitmap((atlas_name + "_" + Number_To_Text(page_index) + ".png").c_str());
+      valid = (page != NULL);
+      if (valid) {
+        pages.push_back(page);
+      }
+    }
+    if (valid) {
+      this->atlas_pages = pages;
+    }
+    else { // Drop what was read so the atlas can be packed again.
+      int loaded_count = pages.size();
+      for (int loaded_index = 0; loaded_index < loaded_count; loaded_index++) {
+        al_destroy_bitmap(pages[loaded_index]);
+      }
+      entries.clear();
+    }
+    return valid;
+  }
+
+  /**
+   * Packs the loaded images into atlas pages and writes them to the cache.
+   * @param names The names of the images.
+   * @param atlas_name The name of the atlas files.
+   * @param sources The source images with their times.
+   * @param entries The images in the atlas.
+   * @throws An error if an image is not loaded or does not fit.
+   */
+  void cAllegro_Tiled_IO::Build_Atlas(cArray<std::string>& names, std::string atlas_name, std::vector<std::string>& sources, std::vector<sAtlas_Entry>& entries) {
+    cAtlas_Packer packer(ATLAS_SIZE, ATLAS_PADDING);
+    int name_count = names.Count();
+    for (int name_index = 0; name_index < name_count; name_index++) {
+      ALLEGRO_BITMAP* image = this->Load_Image_Now(names[name_index]);
+      packer.Add(names[name_index], al_get_bitmap_width(image), al_get_bitmap_height(image));
+    }
+    packer.Pack();
+    ALLEGRO_STATE state;
+    al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER | ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+    al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP); // Packed on the CPU and uploaded once it is loaded back.
+    al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO); // Copy pixels with their alpha.
+    std::vector<ALLEGRO_BITMAP*> pages;
+    for (int page_index = 0; page_index < packer.page_count; page_index++) {
+      ALLEGRO_BITMAP* page = al_create_bitmap(ATLAS_SIZE, ATLAS_SIZE);
+      Check_Condition((page != NULL), "Could not create atlas page.");
+      al_set_target_bitmap(page);
+      al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+      pages.push_back(page);
+    }
+    int entry_count = packer.entries.size();
+    for (int entry_index = 0; entry_index < entry_count; entry_index++) {
+      sAtlas_Entry& entry = packer.entries[entry_index];
+      al_set_target_bitmap(pages[entry.page]);
+      al_draw_bitmap(this->images[entry.name], entry.x, entry.y, 0);
+    }
+    al_restore_state(&state);
+    std::ofstream index_file((atlas_name + ".txt").c_str());
+    int source_count = sources.size();
+    for (int source_index = 0; source_index < source_count; source_index++) {
+      index_file << sources[source_index] << std::endl;
+    }
+    index_file << "pages " << packer.page_count << std::endl;
+    for (int entry_index = 0; entry_index < entry_count; entry_index++) {
+      sAtlas_Entry& entry = packer.entries[entry_index];
+      index_file << "image " << entry.name << " " << entry.page << " " << entry.x << " " << entry.y << " " << entry.width << " " << entry.height << std::endl;
+    }
+    index_file.close();
+    this->atlas_pages.clear();
+    for (int page_index = 0; page_index < packer.page_count; page_index++) {
+      al_save_bitmap((atlas_name + "_" + Number_To_Text(page_index) + ".png").c_str(), pages[page_index]);
+      this->atlas_pages.push_back(al_clone_bitmap(pages[page_index])); // Upload to the card.
+      al_destroy_bitmap(pages[page_index]);
+    }
+    entries = packer.entries;
+  }
+
+  /**
+   * Swaps the loaded images for parts of the atlas pages. The pages are not
+   * freed here since the images point into them until Allegro shuts down.
+   * @param entries The images in the atlas.
+   */
+  void cAllegro_Tiled_IO::Use_Atlas(std::vector<sAtlas_Entry>& entries) {
+    int entry_count = entries.size();
+    for (int entry_index = 0; entry_index < entry_count; entry_index++) {
+      sAtlas_Entry& entry = entries[entry_index];
+      ALLEGRO_BITMAP* image = al_create_sub_bitmap(this->atlas_pages[entry.page], entry.x, entry.y, entry.width, entry.height);
+      if (image) {
+        if (this->images.Does_Key_Exist(entry.name) && this->images[entry.name]) {
+          al_destroy_bitmap(this->images[entry.name]);
+        }
+        this->images[entry.name] = image;
+      }
+    }
+  }
+
+  /**
+   * Gets the time a file was last changed.
+   * @param name The name of the file.
+   * @return The time in seconds or zero if the file does not exist.
+   */
+  long long cAllegro_Tiled_IO::Get_File_Time(std::string name) {
+    long long file_time = 0;
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (GetFileAttributesExA(name.c_str(), GetFileExInfoStandard, &attributes)) {
+      unsigned long long ticks = ((unsigned long long)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+      file_time = (long long)((ticks - 116444736000000000ULL) / 10000000ULL); // 100 ns ticks since 1601 to seconds since 1970.
+    }
+#else
+    struct stat file_stat;
+    if (stat(name.c_str(), &file_stat) == 0) {
+      file_time = file_stat.st_mtime;
+    }
+#endif
+    return file_time;
+  }
+
+}
+
+// ****************************************************************************
+// Allegro Loader
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Lists the images and music in the current folder without decoding them.
+   * Image sizes are read from the PNG headers so backgrounds can be checked
+   * and sprites laid out before the pixels arrive. An image without a
+   * readable header is decoded right away.
+   */
+  void cAllegro_Tiled_IO::Scan_Resources() {
+    cArray<std::string> files = this->Get_File_List(this->Get_Current_Folder());
+    int file_count = files.Count();
+    for (int file_index = 0; file_index < file_count; file_index++) {
+      std::string file = files[file_index];
+      std::string ext = this->Get_File_Extension(file);
+      std::string name = this->Get_File_Title(file);
+      if (ext == "png") {
+        sImage image;
+        this->images[name] = NULL; // Not decoded yet.
+        if (Read_Image_Size(file, image)) {
+          this->image_files[name] = image;
+        }
+        else {
+          image.name = file;
+          this->image_files[name] = image;
+          this->Load_Image_Now(name);
+          image.width = al_get_bitmap_width(this->images[name]);
+          image.height = al_get_bitmap_height(this->images[name]);
+          this->image_files[name] = image;
+        }
+      }
+      else if (ext == "ogg") {
+        this->tracks[name] = NULL; // Streamed when it is first played.
+      }
+    }
+  }
+
+  /**
+   * Reads the size of a PNG image from its header.
+   * @param file The name of the image file.
+   * @param image The image to fill in with the file name and size.
+   * @return True if the header was read, false otherwise.
+   */
+  bool Read_Image_Size(std::string file, sImage& image) {
+    unsigned char header[24];
+    std::ifstream image_file(file.c_str(), std::ios::binary);
+    image.name = file;
+    image.width = 0;
+    image.height = 0;
+    bool read = (image_file.read((char*)header, sizeof(header)) && (std::memcmp(header + 1, "PNG", 3) == 0) && (std::memcmp(header + 12, "IHDR", 4) == 0));
+    if (read) {
+      image.width = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19]; // Big endian.
+      image.height = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+    }
+    return read;
+  }
+
+  /**
+   * Gets the size of an image from its PNG file. Each file is read once and
+   * an image without a readable file has no size.
+   * @param image_sizes The images read so far by name.
+   * @param name The name of the image.
+   * @return The image.
+   */
+  sImage& Get_File_Image(std::unordered_map<std::string, sImage>& image_sizes, std::string name) {
+    std::unordered_map<std::string, sImage>::iterator match = image_sizes.find(name);
+    if (match == image_sizes.end()) {
+      sImage file_image;
+      Read_Image_Size(name + ".png", file_image);
+      file_image.name = name;
+      match = image_sizes.insert(std::make_pair(name, file_image)).first;
+    }
+    return match->second;
+  }
+
+  /**
+   * Starts decoding the images that are not loaded on a pool of threads.
+   * @param first_images The images to decode before the rest.
+   */
+  void cAllegro_Tiled_IO::Start_Loading(std::vector<std::string>& first_images) {
+    this->load_lock.lock();
+    int image_count = this->images.Count();
+    for (int image_index = 0; image_index < image_count; image_index++) {
+      if (!this->images.values[image_index]) {
+        this->pending_images.push_back(this->images.keys[image_index]);
+      }
+    }
+    this->load_lock.unlock();
+    int first_count = first_images.size();
+    for (int first_index = first_count - 1; first_index >= 0; first_index--) {
+      this->Prioritize_Image(first_images[first_index]);
+    }
+    int loader_count = std::max((int)std::thread::hardware_concurrency() - 1, 1); // Leave a core for the editor.
+    for (int loader_index = 0; loader_index < loader_count; loader_index++) {
+      this->loaders.push_back(std::thread(&cAllegro_Tiled_IO::Load_Worker, this));
+    }
+  }
+
+  /**
+   * Decodes pending images into memory bitmaps. Video bitmaps can only be
+   * made on the thread that owns the display, so they are handed back to
+   * be uploaded by Refresh.
+   */
+  void cAllegro_Tiled_IO::Load_Worker() {
+    al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP); // Only affects this thread.
+    bool done = false;
+    while (!done) {
+      std::string file;
+      this->load_lock.lock();
+      done = this->stop_loading || (this->pending_images.size() == 0);
+      sLoaded_Image loaded;
+      if (!done) {
+        loaded.name = this->pending_images.front();
+        file = this->image_files[loaded.name].name;
+        this->pending_images.pop_front();
+      }
+      this->load_lock.unlock();
+      if (!done) {
+        loaded.bitmap = al_load_bitmap(file.c_str());
+        this->load_lock.lock();
+        this->loaded_images.push_back(loaded);
+        this->load_lock.unlock();
+      }
+    }
+  }
+
+  /**
+   * Turns the decoded images into video bitmaps and puts them in use.
+   */
+  void cAllegro_Tiled_IO::Upload_Images() {
+    std::deque<sLoaded_Image> loaded_images;
+    this->load_lock.lock();
+    loaded_images.swap(this->loaded_images);
+    this->load_lock.unlock();
+    while (loaded_images.size() > 0) {
+      sLoaded_Image& loaded = loaded_images.front();
+      if (loaded.bitmap) {
+        if (!this->images[loaded.name]) { // Not loaded some other way in the meantime.
+          this->images[loaded.name] = al_clone_bitmap(loaded.bitmap);
+        }
+        al_destroy_bitmap(loaded.bitmap);
+      }
+      loaded_images.pop_front();
+    }
+  }
+
+  /**
+   * Moves an image to the front of the images waiting to be decoded.
+   * @param name The name of the image.
+   */
+  void cAllegro_Tiled_IO::Prioritize_Image(std::string name) {
+    this->load_lock.lock();
+    std::deque<std::string>::iterator pending = std::find(this->pending_images.begin(), this->pending_images.end(), name);
+    if (pending != this->pending_images.end()) {
+      this->pending_images.erase(pending);
+      this->pending_images.push_front(name);
+    }
+    this->load_lock.unlock();
+  }
+
+  /**
+   * Decodes an image on this thread if it is not loaded yet.
+   * @param name The name of the image.
+   * @return The image.
+   * @throws An error if the image does not exist or could not be decoded.
+   */
+  ALLEGRO_BITMAP* cAllegro_Tiled_IO::Load_Image_Now(std::string name) {
+    Check_Condition(this->images.Does_Key_Exist(name), "Image " + name + " does not exist.");
+    if (!this->images[name]) {
+      ALLEGRO_BITMAP* image = al_load_bitmap(this->image_files[name].name.c_str());
+      Check_Condition((image != NULL), "Could not load image " + name + ".");
+      this->images[name] = image;
+    }
+    return this->images[name];
+  }
+
+  /**
+   * Draws an image. An image that is still being decoded is skipped for this
+   * frame and moved to the front of the queue.
+   * @param name The name of the image.
+   * @param x The x coordinate.
+   * @param y The y coordinate.
+   * @param width The width to draw.
+   * @param height The height to draw.
+   * @param angle The angle of rotation.
+   * @param flip_x Whether to flip horizontally.
+   * @param flip_y Whether to flip vertically.
+   */
+  void cAllegro_Tiled_IO::Draw_Image(std::string name, int x, int y, int width, int height, int angle, bool flip_x, bool flip_y) {
+    if (this->image_files.count(name) && !this->images[name]) {
+      this->Prioritize_Image(name);
+    }
+    else {
+      cAllegro_IO::Draw_Image(name, x, y, width, height, angle, flip_x, flip_y);
+    }
+  }
+
+  /**
+   * Gets the width of an image without waiting for it to be decoded.
+   * @param name The name of the image.
+   * @return The width of the image.
+   */
+  int cAllegro_Tiled_IO::Get_Image_Width(std::string name) {
+    std::unordered_map<std::string, sImage>::iterator image = this->image_files.find(name);
+    return (image != this->image_files.end()) ? image->second.width : cAllegro_IO::Get_Image_Width(name);
+  }
+
+  /**
+   * Gets the height of an image without waiting for it to be decoded.
+   * @param name The name of the image.
+   * @return The height of the image.
+   */
+  int cAllegro_Tiled_IO::Get_Image_Height(std::string name) {
+    std::unordered_map<std::string, sImage>::iterator image = this->image_files.find(name);
+    return (image != this->image_files.end()) ? image->second.height : cAllegro_IO::Get_Image_Height(name);
+  }
+
+  /**
+   * Plays a music track. The track is opened as a stream the first time it
+   * is played.
+   * @param name The name of the track.
+   * @throws An error if the track could not be opened.
+   */
+  void cAllegro_Tiled_IO::Play_Music(std::string name) {
+    if (this->tracks.Does_Key_Exist(name) && !this->tracks[name]) {
+      ALLEGRO_AUDIO_STREAM* track = al_load_audio_stream((name + ".ogg").c_str(), 4, 2048);
+      Check_Condition((track != NULL), "Could not load music track " + name + ".");
+      this->tracks[name] = track;
+    }
+    cAllegro_IO::Play_Music(name);
+  }
+
+  /**
+   * Puts decoded images in use and shows the frame.
+   */
+  void cAllegro_Tiled_IO::Refresh() {
+    this->Upload_Images();
+    cAllegro_IO::Refresh();
+  }
+
+}
+
+// ****************************************************************************
+// Level Stream
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates a level stream that is not open yet.
+   */
+  cLevel_Stream::cLevel_Stream() {
+    this->chunk_size = STREAM_CHUNK_SIZE;
+    this->radius = 1;
+    this->running = false;
+  }
+
+  /**
+   * Stops the stream once all queued saves are done.
+   */
+  cLevel_Stream::~cLevel_Stream() {
+    this->Close();
+  }
+
+  /**
+   * Opens a level that was split into chunks. Only the world file is read
+   * here. The chunks are loaded by Update as the view comes near them.
+   * @param name The name of the level.
+   * @param level The level that the chunks are loaded into.
+   * @param radius The number of chunks around the view to keep loaded.
+   * @throws An error if the world file could not be read.
+   */
+  void cLevel_Stream::Open(std::string name, cLevel& level, int radius) {
+    this->name = name;
+    this->radius = std::max(radius, 0);
+    this->chunks.clear();
+    this->layers = cArray<std::string>();
+    int layer_count = level.layers.size();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      this->layers.Add(level.layers[layer_index].layer);
+    }
+    level.Clear();
+    this->Read_Manifest(level);
+    this->Track_Changes(level, false);
+    this->running = true;
+    this->worker = std::thread(&cLevel_Stream::Run, this);
+  }
+
+  /**
+   * Stops the thread once all queued loads and saves are done.
+   */
+  void cLevel_Stream::Close() {
+    {
+      std::lock_guard<std::mutex> guard(this->lock);
+      this->running = false;
+    }
+    this->signal.notify_all();
+    if (this->worker.joinable()) {
+      this->worker.join();
+    }
+    while (this->loaded.size() > 0) {
+      delete this->loaded.front().level;
+      this->loaded.pop_front();
+    }
+  }
+
+  /**
+   * Keeps the chunks around the view loaded. Edits since the last call mark
+   * their chunks dirty, chunks that finished loading are merged, chunks near
+   * the view are requested and chunks that are far away are written back if
+   * dirty and dropped. Merged sprites go at the end of their layer so the
+   * sprites already there keep their indices.
+   * @param level The level the chunks are loaded into.
+   * @param view The view in level coordinates.
+   * @param dropped Filled with the indices each layer had for the sprites that were dropped, in order.
+   * @return True if sprites were dropped, which moves sprite indices.
+   */
+  bool cLevel_Stream::Update(cLevel& level, sRectangle view, std::vector<std::vector<int> >& dropped) {
+    this->Track_Changes(level, true);
+    std::deque<sStream_Job> loaded;
+    {
+      std::lock_guard<std::mutex> guard(this->lock);
+      loaded.swap(this->loaded);
+    }
+    while (loaded.size() > 0) {
+      sStream_Job& job = loaded.front();
+      sChunk& chunk = this->chunks[job.key];
+      chunk.loading = false;
+      chunk.loaded = true;
+      if (job.level) {
+        this->Merge_Chunk(level, *job.level);
+        delete job.level;
+      }
+      else {
+        chunk.broken = true; // Never written back so the file is not lost.
+      }
+      loaded.pop_front();
+    }
+    int left = this->Get_Chunk_Coord(view.left) - this->radius;
+    int top = this->Get_Chunk_Coord(view.top) - this->radius;
+    int right = this->Get_Chunk_Coord(view.right) + this->radius;
+    int bottom = this->Get_Chunk_Coord(view.bottom) + this->radius;
+    for (int chunk_y = top; chunk_y <= bottom; chunk_y++) {
+      for (int chunk_x = left; chunk_x <= right; chunk_x++) {
+        this->Request_Load(this->Get_Chunk(chunk_x, chunk_y));
+      }
+    }
+    int layer_count = level.layers.size();
+    dropped.assign(layer_count, std::vector<int>());
+    int removed_count = 0;
+    for (std::unordered_map<long long, sChunk>::iterator entry = this->chunks.begin(); entry != this->chunks.end(); entry++) {
+      sChunk& chunk = entry->second;
+      bool far_away = (chunk.x < (left - 1)) || (chunk.x > (right + 1)) || (chunk.y < (top - 1)) || (chunk.y > (bottom + 1)); // One chunk of slack so the edge does not thrash.
+      if (chunk.loaded && far_away) {
+        removed_count += this->Evict_Chunk(level, chunk, dropped);
+      }
+    }
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) { // Chunks do not share sprites so each layer is compacted once.
+      if (dropped[layer_index].size() > 0) {
+        std::sort(dropped[layer_index].begin(), dropped[layer_index].end());
+        level.layers[layer_index].Remove_Sprites(dropped[layer_index]);
+      }
+    }
+    this->Track_Changes(level, false); // Merges and evictions are not edits.
+    return (removed_count > 0);
+  }
+
+  /**
+   * Writes back every loaded chunk that changed along with the world file.
+   * @param level The level the chunks are loaded into.
+   */
+  void cLevel_Stream::Flush(cLevel& level) {
+    this->Track_Changes(level, true);
+    for (std::unordered_map<long long, sChunk>::iterator entry = this->chunks.begin(); entry != this->chunks.end(); entry++) {
+      sChunk& chunk = entry->second;
+      if (chunk.loaded && chunk.dirty && !chunk.broken) {
+        std::vector<std::vector<int> > indices;
+        this->Find_Chunk_Sprites(level, chunk, indices);
+        this->Save_Chunk(level, chunk, indices);
+      }
+    }
+    sStream_Job job;
+    job.key = 0;
+    job.level = NULL;
+    job.file = this->name + ".world";
+    job.text = this->Get_Manifest(level);
+    this->Queue(job);
+  }
+
+  /**
+   * Splits a whole level into chunk files and writes the world file. The
+   * sprites are sorted into chunks in one pass.
+   * @param level The level to split.
+   * @param name The name of the level.
+   * @param chunk_size The width and height of a chunk in pixels.
+   * @throws An error if the chunk size is not positive or a file could not be written.
+   */
+  void cLevel_Stream::Write_World(cLevel& level, std::string name, int chunk_size) {
+    Check_Condition((chunk_size > 0), "Chunk size must be positive.");
+    this->name = name;
+    this->chunk_size = chunk_size;
+    this->chunks.clear();
+    int layer_count = level.layers.size();
+    std::unordered_map<long long, std::vector<std::vector<int> > > chunk_sprites;
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      cSprite_Store& store = level.layers[layer_index];
+      int sprite_count = store.Count();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        sChunk& chunk = this->Get_Chunk(this->Get_Chunk_Coord(store.x[sprite_index]), this->Get_Chunk_Coord(store.y[sprite_index]));
+        std::vector<std::vector<int> >& indices = chunk_sprites[this->Get_Chunk_Key(chunk.x, chunk.y)];
+        indices.resize(layer_count);
+        indices[layer_index].push_back(sprite_index);
+      }
+    }
+    for (std::unordered_map<long long, sChunk>::iterator entry = this->chunks.begin(); entry != this->chunks.end(); entry++) {
+      sChunk& chunk = entry->second;
+      cLevel* chunk_level = this->Extract_Chunk(level, chunk_sprites[entry->first]);
+      chunk_level->Save(this->Get_Chunk_File(chunk));
+      delete chunk_level;
+      chunk.exists = true;
+    }
+    std::string temp_name = name + ".world.tmp";
+    std::ofstream world_file(temp_name.c_str(), std::ios::binary | std::ios::trunc);
+    world_file << this->Get_Manifest(level);
+    world_file.close();
+    level.Replace_File(temp_name, name + ".world");
+  }
+
+  /**
+   * Takes the changes the grids of the level recorded since the last call.
+   * Each change is the bounds of a sprite before or after an edit, and the
+   * top left corner of the bounds is the sprite position.
+   * @param level The level.
+   * @param keep Whether to mark the chunks of the changes dirty or throw the changes away.
+   */
+  void cLevel_Stream::Track_Changes(cLevel& level, bool keep) {
+    int layer_count = level.layers.size();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      cSpatial_Grid& grid = level.layers[layer_index].grid;
+      grid.track_changes = true;
+      if (keep) {
+        int change_count = grid.changes.size();
+        for (int change_index = 0; change_index < change_count; change_index++) {
+          this->Mark_Dirty(grid.changes[change_index].left, grid.changes[change_index].top);
+        }
+      }
+      grid.changes.clear();
+    }
+  }
+
+  /**
+   * Marks the chunk at a position as dirty. A chunk that gets sprites before
+   * it was loaded is loaded so its file is not overwritten without them.
+   * @param x The x coordinate in the level.
+   * @param y The y coordinate in the level.
+   */
+  void cLevel_Stream::Mark_Dirty(int x, int y) {
+    sChunk& chunk = this->Get_Chunk(this->Get_Chunk_Coord(x), this->Get_Chunk_Coord(y));
+    chunk.dirty = true;
+    this->Request_Load(chunk);
+  }
+
+  /**
+   * Queues a chunk to be loaded if it has a file and is not loaded. A chunk
+   * without a file is empty and counts as loaded right away.
+   * @param chunk The chunk.
+   */
+  void cLevel_Stream::Request_Load(sChunk& chunk) {
+    if (!chunk.loaded && !chunk.loading) {
+      if (chunk.exists) {
+        sStream_Job job;
+        job.key = this->Get_Chunk_Key(chunk.x, chunk.y);
+        job.level = NULL;
+        job.file = this->Get_Chunk_File(chunk);
+        chunk.loading = true;
+        this->Queue(job);
+      }
+      else {
+        chunk.loaded = true;
+      }
+    }
+  }
+
+  /**
+   * Adds the sprites of a loaded chunk to the end of each layer. The names
+   * and icons are looked up again since the chunk has its own tables.
+   * @param level The level.
+   * @param chunk_level The chunk that was loaded.
+   */
+  void cLevel_Stream::Merge_Chunk(cLevel& level, cLevel& chunk_level) {
+    int layer_count = std::min(level.layers.size(), chunk_level.layers.size());
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      cSprite_Store& store = level.layers[layer_index];
+      cSprite_Store& chunk_store = chunk_level.layers[layer_index];
+      int sprite_count = chunk_store.Count();
+      std::vector<int> indices;
+      std::vector<sSprite_Record> records;
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        sSprite_Record record = chunk_store.Get_Record(sprite_index);
+        record.name = level.strings.Intern(chunk_level.strings.Get(record.name));
+        record.icon = level.images.Resolve(chunk_level.images.names.Get(record.icon));
+        indices.push_back(store.Count() + sprite_index);
+        records.push_back(record);
+      }
+      if (sprite_count > 0) {
+        store.Insert_Records(indices, records, chunk_store);
+      }
+    }
+  }
+
+  /**
+   * Marks the sprites of a chunk to be dropped from the level. A dirty chunk
+   * is written back first. The sprites stay in the level until the caller
+   * removes them.
+   * @param level The level.
+   * @param chunk The chunk to drop.
+   * @param dropped The sprites to drop for each layer. The sprites of the chunk are added.
+   * @return The number of sprites dropped.
+   */
+  int cLevel_Stream::Evict_Chunk(cLevel& level, sChunk& chunk, std::vector<std::vector<int> >& dropped) {
+    std::vector<std::vector<int> > indices;
+    this->Find_Chunk_Sprites(level, chunk, indices);
+    if (chunk.dirty && !chunk.broken) {
+      this->Save_Chunk(level, chunk, indices);
+    }
+    int removed_count = 0;
+    int layer_count = indices.size();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      dropped[layer_index].insert(dropped[layer_index].end(), indices[layer_index].begin(), indices[layer_index].end());
+      removed_count += indices[layer_index].size();
+    }
+    chunk.loaded = false;
+    chunk.broken = false;
+    return removed_count;
+  }
+
+  /**
+   * Queues the sprites of a chunk to be written to its file.
+   * @param level The level.
+   * @param chunk The chunk.
+   * @param indices The sprites in the chunk for each layer.
+   */
+  void cLevel_Stream::Save_Chunk(cLevel& level, sChunk& chunk, std::vector<std::vector<int> >& indices) {
+    sStream_Job job;
+    job.key = this->Get_Chunk_Key(chunk.x, chunk.y);
+    job.level = this->Extract_Chunk(level, indices);
+    job.file = this->Get_Chunk_File(chunk);
+    this->Queue(job);
+    chunk.dirty = false;
+    chunk.exists = true;
+  }
+
+  /**
+   * Finds the sprites whose position falls in a chunk.
+   * @param level The level.
+   * @param chunk The chunk.
+   * @param indices The sprites found for each layer, in ascending order.
+   */
+  void cLevel_Stream::Find_Chunk_Sprites(cLevel& level, sChunk& chunk, std::vector<std::vector<int> >& indices) {
+    sRectangle area;
+    area.left = chunk.x * this->chunk_size;
+    area.top = chunk.y * this->chunk_size;
+    area.right = area.left + this->chunk_size - 1;
+    area.bottom = area.top + this->chunk_size - 1;
+    int layer_count = level.layers.size();
+    indices.assign(layer_count, std::vector<int>());
+    std::vector<int> sprites;
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      cSprite_Store& store = level.layers[layer_index];
+      store.grid.Query(area, sprites);
+      int sprite_count = sprites.size();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        int sprite = sprites[sprite_index];
+        if ((store.x[sprite] >= area.left) && (store.y[sprite] >= area.top)) { // Sprites reaching in from other chunks are not in this one.
+          indices[layer_index].push_back(sprite);
+        }
+      }
+    }
+  }
+
+  /**
+   * Copies some sprites of the level into a level of their own. The string
+   * and image tables are copied whole so the records need no lookups.
+   * @param level The level.
+   * @param indices The sprites to copy for each layer.
+   * @return The new level. The caller owns it.
+   */
+  cLevel* cLevel_Stream::Extract_Chunk(cLevel& level, std::vector<std::vector<int> >& indices) {
+    cLevel* chunk_level = new cLevel();
+    chunk_level->background = level.background;
+    chunk_level->music_track = level.music_track;
+    chunk_level->format = eLEVEL_BINARY;
+    chunk_level->layer_names = level.layer_names;
+    chunk_level->strings = level.strings;
+    chunk_level->images = level.images;
+    chunk_level->images.io = NULL; // Images are not resolved off the main thread.
+    int layer_count = level.layers.size();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      cSprite_Store& store = level.layers[layer_index];
+      chunk_level->layers.push_back(cSprite_Store(store.layer, &chunk_level->strings, &chunk_level->images));
+      if (layer_index < (int)indices.size()) {
+        std::vector<int>& sprites = indices[layer_index];
+        int sprite_count = sprites.size();
+        std::vector<int> new_indices;
+        std::vector<sSprite_Record> records;
+        for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+          new_indices.push_back(sprite_index);
+          records.push_back(store.Get_Record(sprites[sprite_index]));
+        }
+        chunk_level->layers[layer_index].Insert_Records(new_indices, records, store);
+      }
+    }
+    return chunk_level;
+  }
+
+  /**
+   * Writes the world file. It holds the level properties, the chunk size
+   * and the chunks that have a file.
+   * @param level The level.
+   * @return The text of the world file.
+   */
+  std::string cLevel_Stream::Get_Manifest(cLevel& level) {
+    std::stringstream manifest;
+    manifest << "background " << level.background << "\n";
+    manifest << "music-track " << level.music_track << "\n";
+    manifest << "chunk-size " << this->chunk_size << "\n";
+    for (std::unordered_map<long long, sChunk>::iterator entry = this->chunks.begin(); entry != this->chunks.end(); entry++) {
+      if (entry->second.exists) {
+        manifest << "chunk " << entry->second.x << " " << entry->second.y << "\n";
+      }
+    }
+    return manifest.str();
+  }
+
+  /**
+   * Reads the world file.
+   * @param level The level that gets the level properties.
+   * @throws An error if the world file could not be read.
+   */
+  void cLevel_Stream::Read_Manifest(cLevel& level) {
+    std::ifstream world_file((this->name + ".world").c_str());
+    Check_Condition(world_file.is_open(), "Could not open world " + this->name + ".");
+    std::string line;
+    while (std::getline(world_file, line)) {
+      std::stringstream fields(line);
+      std::string field;
+      fields >> field;
+      if (field == "background") {
+        fields >> level.background;
+      }
+      else if (field == "music-track") {
+        fields >> level.music_track;
+      }
+      else if (field == "chunk-size") {
+        fields >> this->chunk_size;
+        Check_Condition((this->chunk_size > 0), "Chunk size must be positive.");
+      }
+      else if (field == "chunk") {
+        int chunk_x = 0;
+        int chunk_y = 0;
+        Check_Condition((bool)(fields >> chunk_x >> chunk_y), "Bad chunk in world " + this->name + ".");
+        this->Get_Chunk(chunk_x, chunk_y).exists = true;
+      }
+    }
+  }
+
+  /**
+   * Gets a chunk, adding an empty one if it is not known yet.
+   * @param chunk_x The x coordinate of the chunk.
+   * @param chunk_y The y coordinate of the chunk.
+   * @return The chunk.
+   */
+  sChunk& cLevel_Stream::Get_Chunk(int chunk_x, int chunk_y) {
+    long long key = this->Get_Chunk_Key(chunk_x, chunk_y);
+    std::unordered_map<long long, sChunk>::iterator entry = this->chunks.find(key);
+    if (entry == this->chunks.end()) {
+      sChunk chunk;
+      chunk.x = chunk_x;
+      chunk.y = chunk_y;
+      chunk.exists = false;
+      chunk.loaded = false;
+      chunk.loading = false;
+      chunk.dirty = false;
+      chunk.broken = false;
+      entry = this->chunks.insert(std::make_pair(key, chunk)).first;
+    }
+    return entry->second;
+  }
+
+  /**
+   * Gets the key of a chunk.
+   * @param chunk_x The x coordinate of the chunk.
+   * @param chunk_y The y coordinate of the chunk.
+   * @return The key of the chunk.
+   */
+  long long cLevel_Stream::Get_Chunk_Key(int chunk_x, int chunk_y) {
+    return (long long)(((unsigned long long)(unsigned int)chunk_x << 32) ^ (unsigned int)chunk_y);
+  }
+
+  /**
+   * Gets the name of the file of a chunk.
+   * @param chunk The chunk.
+   * @return The name of the file.
+   */
+  std::string cLevel_Stream::Get_Chunk_File(sChunk& chunk) {
+    return this->name + "_" + Number_To_Text(chunk.x) + "_" + Number_To_Text(chunk.y) + ".chunk";
+  }
+
+  /**
+   * Gets the chunk that a coordinate falls in. Negative coordinates are
+   * rounded down so chunks stay the same size on both sides of zero.
+   * @param coord The coordinate.
+   * @return The chunk coordinate.
+   */
+  int cLevel_Stream::Get_Chunk_Coord(int coord) {
+    return (coord >= 0) ? (coord / this->chunk_size) : -(((-coord) + this->chunk_size - 1) / this->chunk_size);
+  }
+
+  /**
+   * Queues a load or save for the stream thread.
+   * @param job The job.
+   */
+  void cLevel_Stream::Queue(sStream_Job job) {
+    {
+      std::lock_guard<std::mutex> guard(this->lock);
+      this->jobs.push_back(job);
+    }
+    this->signal.notify_all();
+  }
+
+  /**
+   * Runs the queued loads and saves in order until stopped. Keeping them on
+   * one thread in order means a chunk is never read back before it is
+   * written.
+   */
+  void cLevel_Stream::Run() {
+    while (true) {
+      sStream_Job job;
+      {
+        std::unique_lock<std::mutex> guard(this->lock);
+        while (this->running && (this->jobs.size() == 0)) {
+          this->signal.wait(guard);
+        }
+        if (this->jobs.size() == 0) { // Stopped with nothing left to do.
+          break;
+        }
+        job = this->jobs.front();
+        this->jobs.pop_front();
+      }
+      if (job.level) { // Save a chunk.
+        try {
+          job.level->Save(job.file);
+        }
+        catch (cError error) {
+          error.Print();
+        }
+        delete job.level;
+      }
+      else if (job.text.length() > 0) { // Save the world file.
+        try {
+          cLevel writer;
+          std::string temp_name = job.file + ".tmp";
+          std::ofstream world_file(temp_name.c_str(), std::ios::binary | std::ios::trunc);
+          world_file << job.text;
+          world_file.close();
+          writer.Replace_File(temp_name, job.file);
+        }
+        catch (cError error) {
+          error.Print();
+        }
+      }
+      else { // Load a chunk.
+        job.level = new cLevel();
+        try {
+          job.level->Setup(this->layers, NULL);
+          job.level->Load(job.file);
+        }
+        catch (cError error) {
+          error.Print();
+          delete job.level;
+          job.level = NULL; // Reported back so the chunk is not overwritten.
+        }
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->loaded.push_back(job);
+      }
+    }
+  }
+
+}
+
+// ****************************************************************************
+// Input Queue
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates an empty input queue.
+   */
+  cInput_Queue::cInput_Queue() {
+    this->events.resize(INPUT_QUEUE_SIZE);
+    this->head = 0;
+    this->tail = 0;
+  }
+
+  /**
+   * Adds an event to the queue. Only one thread may add events.
+   * @param event The event to add.
+   * @return True if the event was added or false if the queue is full.
+   */
+  bool cInput_Queue::Push(sInput_Event event) {
+    int tail = this->tail.load(std::memory_order_relaxed);
+    int next = (tail + 1) % INPUT_QUEUE_SIZE;
+    bool added = false;
+    if (next != this->head.load(std::memory_order_acquire)) {
+      this->events[tail] = event;
+      this->tail.store(next, std::memory_order_release);
+      added = true;
+    }
+    return added;
+  }
+
+  /**
+   * Takes the oldest event from the queue. Only one thread may take events.
+   * @param event The event that was taken.
+   * @return True if an event was taken or false if the queue is empty.
+   */
+  bool cInput_Queue::Pop(sInput_Event& event) {
+    int head = this->head.load(std::memory_order_relaxed);
+    bool taken = false;
+    if (head != this->tail.load(std::memory_order_acquire)) {
+      event = this->events[head];
+      this->head.store((head + 1) % INPUT_QUEUE_SIZE, std::memory_order_release);
+      taken = true;
+    }
+    return taken;
+  }
+
+  /**
+   * Gets the time that input events are stamped with.
+   * @return The time in milliseconds.
+   */
+  double cInput_Queue::Get_Time() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /**
+   * Starts sending keyboard and mouse events to an input queue from a thread
+   * of their own, so no press is lost between frames.
+   * @param queue The queue to send events to.
+   */
+  void cAllegro_Tiled_IO::Start_Input(cInput_Queue* queue) {
+    this->Stop_Input();
+    this->input_queue = queue;
+    this->input_events = al_create_event_queue();
+    if (this->input_events) {
+      al_register_event_source(this->input_events, al_get_keyboard_event_source());
+      al_register_event_source(this->input_events, al_get_mouse_event_source());
+      this->stop_input = false;
+      this->input_thread = std::thread(&cAllegro_Tiled_IO::Run_Input, this);
+    }
+  }
+
+  /**
+   * Stops sending events to the input queue.
+   */
+  void cAllegro_Tiled_IO::Stop_Input() {
+    this->stop_input = true;
+    if (this->input_thread.joinable()) {
+      this->input_thread.join();
+    }
+    if (this->input_events) {
+      al_destroy_event_queue(this->input_events);
+      this->input_events = NULL;
+    }
+    this->input_queue = NULL;
+  }
+
+  /**
+   * Waits on keyboard and mouse events and puts them in the input queue.
+   * Events that do not fit in a full queue are dropped.
+   */
+  void cAllegro_Tiled_IO::Run_Input() {
+    while (!this->stop_input) {
+      ALLEGRO_EVENT allegro_event;
+      if (al_wait_for_event_timed(this->input_events, &allegro_event, 0.05)) { // Wake up to check for a stop.
+        sInput_Event event;
+        event.time = this->input_queue->Get_Time();
+        event.signal.code = NO_VALUE_FOUND;
+        event.signal.button = this->mouse_button;
+        if ((allegro_event.type == ALLEGRO_EVENT_KEY_DOWN) || (allegro_event.type == ALLEGRO_EVENT_KEY_UP)) {
+          event.type = (allegro_event.type == ALLEGRO_EVENT_KEY_DOWN) ? eINPUT_KEY_DOWN : eINPUT_KEY_UP;
+          event.signal.code = this->Map_Key(allegro_event.keyboard.keycode);
+          event.signal.coords.x = 0;
+          event.signal.coords.y = 0;
+        }
+        else if ((allegro_event.type == ALLEGRO_EVENT_MOUSE_AXES) || (allegro_event.type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN) || (allegro_event.type == ALLEGRO_EVENT_MOUSE_BUTTON_UP)) {
+          if (allegro_event.type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN) {
+            this->mouse_button = (allegro_event.mouse.button == 2) ? eBUTTON_RIGHT : eBUTTON_LEFT;
+          }
+          else if (allegro_event.type == ALLEGRO_EVENT_MOUSE_BUTTON_UP) {
+            this->mouse_button = NO_VALUE_FOUND;
+          }
+          event.type = eINPUT_MOUSE;
+          event.signal.code = eSIGNAL_MOUSE;
+          event.signal.button = this->mouse_button;
+          event.signal.coords.x = allegro_event.mouse.x / this->scale;
+          event.signal.coords.y = allegro_event.mouse.y / this->scale;
+        }
+        if (event.signal.code != NO_VALUE_FOUND) {
+          this->input_queue->Push(event);
+        }
+      }
+    }
+  }
+
+  /**
+   * Turns an Allegro key code into the key code the editor uses.
+   * @param keycode The Allegro key code.
+   * @return The editor key code or NO_VALUE_FOUND if the editor does not use the key.
+   */
+  int cAllegro_Tiled_IO::Map_Key(int keycode) {
+    int code = NO_VALUE_FOUND;
+    if ((keycode >= ALLEGRO_KEY_A) && (keycode <= ALLEGRO_KEY_Z)) {
+      code = 'a' + (keycode - ALLEGRO_KEY_A);
+    }
+    else if (keycode == ALLEGRO_KEY_COMMA) {
+      code = ',';
+    }
+    else if (keycode == ALLEGRO_KEY_LEFT) {
+      code = eSIGNAL_LEFT;
+    }
+    else if (keycode == ALLEGRO_KEY_RIGHT) {
+      code = eSIGNAL_RIGHT;
+    }
+    else if (keycode == ALLEGRO_KEY_UP) {
+      code = eSIGNAL_UP;
+    }
+    else if (keycode == ALLEGRO_KEY_DOWN) {
+      code = eSIGNAL_DOWN;
+    }
+    else if (keycode == ALLEGRO_KEY_DELETE) {
+      code = eSIGNAL_DELETE;
+    }
+    return code;
+  }
+
+}
+
+// ****************************************************************************
+// Profiler
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates a profiler with no phases. It is off until enabled.
+   */
+  cProfiler::cProfiler() {
+    this->enabled = false;
+    this->tracing = false;
+    this->frame_count = 0;
+  }
+
+  /**
+   * Adds a phase to time.
+   * @param name The name of the phase.
+   * @return The index of the phase.
+   */
+  int cProfiler::Add_Phase(std::string name) {
+    sProfile_Phase phase;
+    phase.name = name;
+    phase.start = 0;
+    phase.frame.time = 0;
+    phase.frame.draw_count = 0;
+    phase.frame.visit_count = 0;
+    phase.frame.cull_count = 0;
+    phase.span = phase.frame;
+    phase.total = phase.frame;
+    phase.history.resize(PROFILE_HISTORY, phase.frame);
+    this->phases.push_back(phase);
+    return this->phases.size() - 1;
+  }
+
+  /**
+   * Starts timing a phase.
+   * @param phase The index of the phase.
+   */
+  void cProfiler::Begin(int phase) {
+    if (this->enabled) {
+      sProfile_Phase& profile_phase = this->phases[phase];
+      profile_phase.span.draw_count = 0;
+      profile_phase.span.visit_count = 0;
+      profile_phase.span.cull_count = 0;
+      profile_phase.start = this->Get_Time();
+    }
+  }
+
+  /**
+   * Stops timing a phase. A phase may be timed more than once in a frame and
+   * the times add up. Each timing is a trace event while tracing.
+   * @param phase The index of the phase.
+   */
+  void cProfiler::End(int phase) {
+    if (this->enabled) {
+      sProfile_Phase& profile_phase = this->phases[phase];
+      double time = this->Get_Time() - profile_phase.start;
+      profile_phase.frame.time += time;
+      if (this->tracing && (this->trace.size() < PROFILE_TRACE_LIMIT)) {
+        sTrace_Event event;
+        event.phase = phase;
+        event.start = profile_phase.start;
+        event.sample = profile_phase.span;
+        event.sample.time = time;
+        this->trace.push_back(event);
+      }
+    }
+  }
+
+  /**
+   * Adds to the counts of a phase. Counts taken while the phase is timed also
+   * go on its trace event.
+   * @param phase The index of the phase.
+   * @param draw_count The number of draw calls.
+   * @param visit_count The number of sprites looked at.
+   * @param cull_count The number of sprites skipped for being out of view.
+   */
+  void cProfiler::Count(int phase, int draw_count, int visit_count, int cull_count) {
+    if (this->enabled) {
+      sProfile_Phase& profile_phase = this->phases[phase];
+      profile_phase.frame.draw_count += draw_count;
+      profile_phase.frame.visit_count += visit_count;
+      profile_phase.frame.cull_count += cull_count;
+      profile_phase.span.draw_count += draw_count;
+      profile_phase.span.visit_count += visit_count;
+      profile_phase.span.cull_count += cull_count;
+    }
+  }
+
+  /**
+   * Ends a frame. The times and counts of each phase go into the rolling
+   * history and are cleared for the next frame.
+   */
+  void cProfiler::End_Frame() {
+    if (this->enabled) {
+      int slot = this->frame_count % PROFILE_HISTORY;
+      int phase_count = this->phases.size();
+      for (int phase_index = 0; phase_index < phase_count; phase_index++) {
+        sProfile_Phase& phase = this->phases[phase_index];
+        sProfile_Sample& old_sample = phase.history[slot];
+        phase.total.time += phase.frame.time - old_sample.time;
+        phase.total.draw_count += phase.frame.draw_count - old_sample.draw_count;
+        phase.total.visit_count += phase.frame.visit_count - old_sample.visit_count;
+        phase.total.cull_count += phase.frame.cull_count - old_sample.cull_count;
+        old_sample = phase.frame;
+        phase.frame.time = 0;
+        phase.frame.draw_count = 0;
+        phase.frame.visit_count = 0;
+        phase.frame.cull_count = 0;
+      }
+      this->frame_count++;
+    }
+  }
+
+  /**
+   * Gets the average of a phase over the last frames.
+   * @param phase The index of the phase.
+   * @return The average time and counts per frame.
+   */
+  sProfile_Sample cProfiler::Get_Average(int phase) {
+    sProfile_Sample& total = this->phases[phase].total;
+    int sample_count = std::max(std::min(this->frame_count, PROFILE_HISTORY), 1);
+    sProfile_Sample average;
+    average.time = total.time / sample_count;
+    average.draw_count = total.draw_count / sample_count;
+    average.visit_count = total.visit_count / sample_count;
+    average.cull_count = total.cull_count / sample_count;
+    return average;
+  }
+
+  /**
+   * Starts recording trace events. The profiler is turned on if it is off.
+   */
+  void cProfiler::Start_Trace() {
+    this->trace.clear();
+    this->enabled = true;
+    this->tracing = true;
+  }
+
+  /**
+   * Stops recording and saves the trace events in the Chrome trace event
+   * format. The file can be opened in chrome://tracing or Perfetto.
+   * @param name The name of the trace file.
+   * @throws An error if the file could not be written.
+   */
+  void cProfiler::Save_Trace(std::string name) {
+    this->tracing = false;
+    std::ofstream trace_file(name.c_str());
+    Check_Condition(trace_file.is_open(), "Could not write trace " + name + ".");
+    int event_count = this->trace.size();
+    double start = (event_count > 0) ? this->trace[0].start : 0;
+    for (int event_index = 0; event_index < event_count; event_index++) {
+      start = std::min(start, this->trace[event_index].start); // Events are stored when they end.
+    }
+    trace_file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+    for (int event_index = 0; event_index < event_count; event_index++) {
+      sTrace_Event& event = this->trace[event_index];
+      trace_file << ((event_index > 0) ? ",\n" : "\n");
+      trace_file << "{\"name\":\"" << this->phases[event.phase].name << "\",\"cat\":\"editor\",\"ph\":\"X\",\"pid\":1,\"tid\":1";
+      trace_file << ",\"ts\":" << ((event.start - start) * 1000) << ",\"dur\":" << (event.sample.time * 1000); // Milliseconds to microseconds.
+      trace_file << ",\"args\":{\"draws\":" << event.sample.draw_count << ",\"sprites\":" << event.sample.visit_count << ",\"culled\":" << event.sample.cull_count << "}}";
+    }
+    trace_file << "\n]}\n";
+    this->trace.clear();
+  }
+
+  /**
+   * Gets the time from a steady clock.
+   * @return The time in milliseconds.
+   */
+  double cProfiler::Get_Time() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /**
+   * Starts timing a phase until the scope ends.
+   * @param profiler The profiler.
+   * @param phase The index of the phase.
+   */
+  cProfile_Scope::cProfile_Scope(cProfiler& profiler, int phase) {
+    this->profiler = &profiler;
+    this->phase = phase;
+    this->profiler->Begin(phase);
+  }
+
+  /**
+   * Stops timing the phase.
+   */
+  cProfile_Scope::~cProfile_Scope() {
+    this->profiler->End(this->phase);
+  }
+
+}
+
+// ****************************************************************************
+// Level Baker
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Creates a level baker.
+   */
+  cLevel_Baker::cLevel_Baker() {
+    this->tile_size = 16;
+    this->folder = ".";
+  }
+
+  /**
+   * Sets up the baker from the config. The layers named by bake-static
+   * become tile grids and bake-tile is the size of a grid cell.
+   * @param config The config parser.
+   * @param folder The folder holding the levels.
+   */
+  void cLevel_Baker::Setup(cConfig& config, std::string folder) {
+    this->layers = Parse_Sausage_Text(config.Get_Text_Property("layers"), ",");
+    cArray<std::string> static_layers = Parse_Sausage_Text(config.Get_Text_Property("bake-static"), ",");
+    this->static_layers.clear();
+    for (int layer_index = 0; layer_index < static_layers.Count(); layer_index++) {
+      this->static_layers.push_back(static_layers[layer_index]);
+    }
+    this->tile_size = std::max((int)config.Get_Property("bake-tile"), 1);
+    this->folder = folder;
+    this->palette = config.Get_Text_Property("palette");
+    this->entries.clear();
+  }
+
+  /**
+   * Loads a level from the folder and bakes it.
+   * @param name The name of the level.
+   * @throws An error if the level could not be loaded or baked.
+   */
+  void cLevel_Baker::Bake(std::string name) {
+    cLevel level;
+    level.Setup(this->layers, NULL);
+    level.Load_Templates(this->palette);
+    level.Load(this->folder + "/" + name + ".map");
+    this->Bake_Level(level, name);
+  }
+
+  /**
+   * Bakes a level into the runtime format the game loads with one read. The
+   * file is a header followed by these blocks, each aligned to eight bytes:
+   *
+   * - String offsets and the strings they point to, each ending in a zero.
+   * - Images with their sizes.
+   * - Tiles, each a tile sized piece of an image. Tile 0 is empty and is not stored.
+   * - Grids, one for each static layer, in tile units.
+   * - Runs of the same tile in the grids, row by row.
+   * - Sprite columns, one array after another: x, y, size x, size y, width,
+   *   height, image, type, layer, and link. Each array is padded to eight bytes.
+   * - Links with the level, type, and code they point to and the sprite they
+   *   land on in the other level.
+   *
+   * Sprites on static layers that line up with the grid go into the grids.
+   * All other sprites, and any sprite with a pointer, go into the sprite
+   * columns.
+   * @param level The level to bake.
+   * @param name The name of the level.
+   * @throws An error if the file could not be written.
+   */
+  void cLevel_Baker::Bake_Level(cLevel& level, std::string name) {
+    this->strings = cString_Table();
+    this->images.clear();
+    this->image_ids.clear();
+    std::vector<sBake_Tile> tiles;
+    std::unordered_map<long long, int> tile_ids;
+    std::vector<sBake_Grid> grids;
+    std::vector<sBake_Run> runs;
+    int layer_count = level.layers.size();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      cSprite_Store& store = level.layers[layer_index];
+      if (std::find(this->static_layers.begin(), this->static_layers.end(), store.layer) != this->static_layers.end()) {
+        this->Bake_Grid(store, tiles, tile_ids, grids, runs);
+      }
+    }
+    // Put everything else in the sprite columns.
+    std::vector<sBake_Sprite> sprites;
+    this->Get_Sprites(level, sprites);
+    int sprite_count = sprites.size();
+    std::vector<std::vector<int32_t> > columns(10, std::vector<int32_t>(sprite_count, 0));
+    std::vector<sBake_Link> links;
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+      cSprite_Store& store = level.layers[sprites[sprite_index].layer];
+      int sprite = sprites[sprite_index].sprite;
+      sImage& image = this->Get_Image(store, sprite);
+      columns[0][sprite_index] = store.x[sprite];
+      columns[1][sprite_index] = store.y[sprite];
+      columns[2][sprite_index] = store.size_x[sprite];
+      columns[3][sprite_index] = store.size_y[sprite];
+      columns[4][sprite_index] = image.width;
+      columns[5][sprite_index] = image.height;
+      columns[6][sprite_index] = this->Add_Image(image);
+      columns[7][sprite_index] = this->strings.Intern(level.strings.Get(store.names[sprite]));
+      columns[8][sprite_index] = this->strings.Intern(store.layer);
+      columns[9][sprite_index] = NO_VALUE_FOUND;
+      if (store.Has_Property(sprite, "pointer-level") && (level.Format_Value(store.Get_Property(sprite, "pointer-level")) != "None")) {
+        std::string target = level.Format_Value(store.Get_Property(sprite, "pointer-level"));
+        std::string type = store.Has_Property(sprite, "pointer-type") ? level.Format_Value(store.Get_Property(sprite, "pointer-type")) : "";
+        std::string code = store.Has_Property(sprite, "pointer-code") ? level.Format_Value(store.Get_Property(sprite, "pointer-code")) : "";
+        sBake_Link link;
+        link.level = this->strings.Intern(target);
+        link.type = this->strings.Intern(type);
+        link.code = this->strings.Intern(code);
+        link.sprite = (type.length() > 0) ? this->Find_Entry(target, type, code) : NO_VALUE_FOUND;
+        columns[9][sprite_index] = links.size();
+        links.push_back(link);
+      }
+    }
+    // Write the blocks.
+    sBake_Header header;
+    std::memcpy(header.magic, BAKE_MAGIC, 4);
+    header.version = BAKE_VERSION;
+    header.tile_size = this->tile_size;
+    header.background = this->strings.Intern(level.background);
+    header.music_track = this->strings.Intern(level.music_track);
+    std::string buffer(sizeof(sBake_Header), '\0');
+    level.Pad_Block(buffer);
+    header.string_count = this->strings.Count();
+    header.string_offset = buffer.size();
+    uint32_t string_offset = header.string_count * sizeof(uint32_t);
+    for (int string_index = 0; string_index < this->strings.Count(); string_index++) {
+      level.Write_Block(buffer, &string_offset, sizeof(uint32_t));
+      string_offset += this->strings.Get(string_index).length() + 1;
+    }
+    for (int string_index = 0; string_index < this->strings.Count(); string_index++) {
+      std::string& text = this->strings.Get(string_index);
+      level.Write_Block(buffer, text.c_str(), text.length() + 1);
+    }
+    header.string_size = buffer.size() - header.string_offset;
+    level.Pad_Block(buffer);
+    header.image_count = this->images.size();
+    header.image_offset = buffer.size();
+    if (this->images.size() > 0) {
+      level.Write_Block(buffer, &this->images[0], this->images.size() * sizeof(sBake_Image));
+    }
+    header.tile_count = tiles.size();
+    header.tile_offset = buffer.size();
+    if (tiles.size() > 0) {
+      level.Write_Block(buffer, &tiles[0], tiles.size() * sizeof(sBake_Tile));
+    }
+    header.grid_count = grids.size();
+    header.grid_offset = buffer.size();
+    header.run_count = runs.size();
+    header.run_offset = header.grid_offset + (grids.size() * sizeof(sBake_Grid));
+    for (int grid_index = 0; grid_index < (int)grids.size(); grid_index++) {
+      grids[grid_index].run_offset = header.run_offset + (grids[grid_index].run_offset * sizeof(sBake_Run));
+      level.Write_Block(buffer, &grids[grid_index], sizeof(sBake_Grid));
+    }
+    if (runs.size() > 0) {
+      level.Write_Block(buffer, &runs[0], runs.size() * sizeof(sBake_Run));
+    }
+    header.sprite_count = sprite_count;
+    header.sprite_offset = buffer.size();
+    int column_count = columns.size();
+    for (int column_index = 0; column_index < column_count; column_index++) {
+      if (sprite_count > 0) {
+        level.Write_Block(buffer, &columns[column_index][0], sprite_count * sizeof(int32_t));
+      }
+      level.Pad_Block(buffer);
+    }
+    header.link_count = links.size();
+    header.link_offset = buffer.size();
+    if (links.size() > 0) {
+      level.Write_Block(buffer, &links[0], links.size() * sizeof(sBake_Link));
+    }
+    std::memcpy(&buffer[0], &header, sizeof(sBake_Header));
+    std::string file_name = this->folder + "/" + name + ".bake";
+    std::string temp_name = file_name + ".tmp";
+    std::ofstream bake_file(temp_name.c_str(), std::ios::binary | std::ios::trunc);
+    Check_Condition(bake_file.is_open(), "Could not write " + file_name + ".");
+    bake_file.write(buffer.data(), buffer.size());
+    bake_file.close();
+    Check_Condition(!bake_file.fail(), "Could not write " + file_name + ".");
+    level.Replace_File(temp_name, file_name);
+  }
+
+  /**
+   * Bakes the sprites of a static layer that line up with the grid into a
+   * tile grid. Each image is cut into tiles once and the cells are packed
+   * into runs of the same tile. Layers with nothing on the grid add no grid.
+   * @param store The sprites on the layer.
+   * @param tiles The tiles found so far.
+   * @param tile_ids The tile for each image piece found so far.
+   * @param grids The grids baked so far.
+   * @param runs The runs of all grids baked so far.
+   */
+  void cLevel_Baker::Bake_Grid(cSprite_Store& store, std::vector<sBake_Tile>& tiles, std::unordered_map<long long, int>& tile_ids, std::vector<sBake_Grid>& grids, std::vector<sBake_Run>& runs) {
+    // Find the tiles the layer covers.
+    int left = INT_MAX;
+    int top = INT_MAX;
+    int right = INT_MIN;
+    int bottom = INT_MIN;
+    int sprite_count = store.Count();
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+      if (this->Is_Tiled(store, sprite_index)) {
+        sImage& image = this->Get_Image(store, sprite_index);
+        left = std::min(left, store.x[sprite_index] / this->tile_size);
+        top = std::min(top, store.y[sprite_index] / this->tile_size);
+        right = std::max(right, (store.x[sprite_index] + (store.size_x[sprite_index] * image.width)) / this->tile_size);
+        bottom = std::max(bottom, (store.y[sprite_index] + (store.size_y[sprite_index] * image.height)) / this->tile_size);
+      }
+    }
+    if (left <= right) { // Something on the grid.
+      sBake_Grid grid;
+      grid.layer = this->strings.Intern(store.layer);
+      grid.left = left * this->tile_size;
+      grid.top = top * this->tile_size;
+      grid.width = right - left;
+      grid.height = bottom - top;
+      grid.run_offset = runs.size(); // In runs until the offsets are known.
+      grid.reserved = 0;
+      // Lay the sprites down in drawing order so later sprites cover earlier ones.
+      std::vector<uint32_t> cells((size_t)grid.width * grid.height, 0);
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        if (this->Is_Tiled(store, sprite_index)) {
+          sImage& image = this->Get_Image(store, sprite_index);
+          int image_id = this->Add_Image(image);
+          int pieces_x = image.width / this->tile_size;
+          int pieces_y = image.height / this->tile_size;
+          int cell_x = (store.x[sprite_index] / this->tile_size) - left;
+          int cell_y = (store.y[sprite_index] / this->tile_size) - top;
+          for (int piece_y = 0; piece_y < pieces_y; piece_y++) {
+            for (int piece_x = 0; piece_x < pieces_x; piece_x++) {
+              long long tile_key = ((long long)image_id << 32) | (piece_y << 16) | piece_x;
+              std::unordered_map<long long, int>::iterator match = tile_ids.find(tile_key);
+              int tile = 0;
+              if (match == tile_ids.end()) {
+                sBake_Tile baked_tile;
+                baked_tile.image = image_id;
+                baked_tile.source_x = piece_x * this->tile_size;
+                baked_tile.source_y = piece_y * this->tile_size;
+                baked_tile.reserved = 0;
+                tiles.push_back(baked_tile);
+                tile = tiles.size(); // Tile 0 is empty.
+                tile_ids[tile_key] = tile;
+              }
+              else {
+                tile = match->second;
+              }
+              for (int repeat_y = 0; repeat_y < store.size_y[sprite_index]; repeat_y++) {
+                for (int repeat_x = 0; repeat_x < store.size_x[sprite_index]; repeat_x++) {
+                  int x = cell_x + (repeat_x * pieces_x) + piece_x;
+                  int y = cell_y + (repeat_y * pieces_y) + piece_y;
+                  cells[((size_t)y * grid.width) + x] = tile;
+                }
+              }
+            }
+          }
+        }
+      }
+      // Pack the cells into runs.
+      size_t cell_count = cells.size();
+      size_t cell_index = 0;
+      while (cell_index < cell_count) {
+        sBake_Run run;
+        run.tile = cells[cell_index];
+        run.count = 0;
+        while ((cell_index < cell_count) && (cells[cell_index] == run.tile)) {
+          run.count++;
+          cell_index++;
+        }
+        runs.push_back(run);
+      }
+      grid.run_count = runs.size() - grid.run_offset;
+      grids.push_back(grid);
+    }
+  }
+
+  /**
+   * Adds an image to the image table of the level being baked.
+   * @param image The image.
+   * @return The index of the image in the table.
+   */
+  int cLevel_Baker::Add_Image(sImage& image) {
+    int image_id = NO_VALUE_FOUND;
+    std::unordered_map<std::string, int>::iterator match = this->image_ids.find(image.name);
+    if (match != this->image_ids.end()) {
+      image_id = match->second;
+    }
+    else {
+      sBake_Image baked_image;
+      baked_image.name = this->strings.Intern(image.name);
+      baked_image.width = image.width;
+      baked_image.height = image.height;
+      baked_image.reserved = 0;
+      image_id = this->images.size();
+      this->image_ids[image.name] = image_id;
+      this->images.push_back(baked_image);
+    }
+    return image_id;
+  }
+
+  /**
+   * Gets the sprites that go in the sprite columns in the order they are
+   * written. Linked levels are searched in the same order.
+   * @param level The level.
+   * @param sprites The layer and index of each sprite.
+   */
+  void cLevel_Baker::Get_Sprites(cLevel& level, std::vector<sBake_Sprite>& sprites) {
+    int layer_count = level.layers.size();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      cSprite_Store& store = level.layers[layer_index];
+      bool is_static = (std::find(this->static_layers.begin(), this->static_layers.end(), store.layer) != this->static_layers.end());
+      int sprite_count = store.Count();
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        if (!is_static || !this->Is_Tiled(store, sprite_index)) {
+          sBake_Sprite sprite;
+          sprite.layer = layer_index;
+          sprite.sprite = sprite_index;
+          sprites.push_back(sprite);
+        }
+      }
+    }
+  }
+
+  /**
+   * Determines if a sprite can go into a tile grid. It has to sit on the grid,
+   * its image has to be whole tiles, and it cannot point anywhere.
+   * @param store The sprites on the layer.
+   * @param sprite The index of the sprite.
+   * @return True if the sprite can be tiled, false otherwise.
+   */
+  bool cLevel_Baker::Is_Tiled(cSprite_Store& store, int sprite) {
+    sImage& image = this->Get_Image(store, sprite);
+    return (image.width > 0) && (image.height > 0) &&
+      ((image.width % this->tile_size) == 0) && ((image.height % this->tile_size) == 0) &&
+      ((store.x[sprite] % this->tile_size) == 0) && ((store.y[sprite] % this->tile_size) == 0) &&
+      (store.size_x[sprite] > 0) && (store.size_y[sprite] > 0) &&
+      !store.Has_Property(sprite, "pointer-level") && !store.Has_Property(sprite, "pointer-type");
+  }
+
+  /**
+   * Gets the image of a sprite with its size. Levels loaded without a display
+   * have no image sizes, so those are read from the image files.
+   * @param store The sprites on the layer.
+   * @param sprite The index of the sprite.
+   * @return The image.
+   */
+  sImage& cLevel_Baker::Get_Image(cSprite_Store& store, int sprite) {
+    sImage* image = &store.images->Get(store.icons[sprite]);
+    if ((image->width <= 0) || (image->height <= 0)) {
+      image = &Get_File_Image(this->image_sizes, image->name);
+    }
+    return *image;
+  }
+
+  /**
+   * Finds the sprite a typed link lands on in another level.
+   * @param level The name of the level.
+   * @param type The pointer type of the link.
+   * @param code The pointer code of the link.
+   * @return The index of the sprite in the sprite columns of the level or NO_VALUE_FOUND if there is no match.
+   */
+  int cLevel_Baker::Find_Entry(std::string level, std::string type, std::string code) {
+    if (this->entries.find(level) == this->entries.end()) {
+      std::unordered_map<std::string, int>& level_entries = this->entries[level];
+      try {
+        cLevel target;
+        target.Setup(this->layers, NULL);
+        target.Load_Templates(this->palette);
+        target.Load(this->folder + "/" + level + ".map");
+        std::vector<sBake_Sprite> sprites;
+        this->Get_Sprites(target, sprites);
+        int sprite_count = sprites.size();
+        for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+          std::string key = this->Get_Entry_Key(target, target.layers[sprites[sprite_index].layer], sprites[sprite_index].sprite);
+          if ((key.length() > 0) && (level_entries.find(key) == level_entries.end())) {
+            level_entries[key] = sprite_index;
+          }
+        }
+      }
+      catch (cError error) {
+        level_entries.clear(); // The validator reports levels that do not load.
+      }
+    }
+    std::unordered_map<std::string, int>& level_entries = this->entries[level];
+    std::unordered_map<std::string, int>::iterator match = level_entries.find(type + ":" + code);
+    return (match == level_entries.end()) ? NO_VALUE_FOUND : match->second;
+  }
+
+  /**
+   * Gets the key a typed link uses to find a sprite.
+   * @param level The level the sprite is in.
+   * @param store The sprites on the layer.
+   * @param sprite The index of the sprite.
+   * @return The pointer type and code of the sprite or an empty string if it has no type.
+   */
+  std::string cLevel_Baker::Get_Entry_Key(cLevel& level, cSprite_Store& store, int sprite) {
+    std::string key;
+    if (store.Has_Property(sprite, "pointer-type")) {
+      std::string code = store.Has_Property(sprite, "pointer-code") ? level.Format_Value(store.Get_Property(sprite, "pointer-code")) : "";
+      key = level.Format_Value(store.Get_Property(sprite, "pointer-type")) + ":" + code;
+    }
+    return key;
+  }
+
+}
+
+// ****************************************************************************
+// Level Linter
+// ****************************************************************************
+
+namespace Codeloader {
+
+  /**
+   * Sets up the linter from the config. The layers named by lint-overlap
+   * report sprites that overlap on the same layer, and each layer pair in
+   * lint-conflict reports sprites of the first layer that overlap sprites of
+   * the second.
+   * @param config The config parser.
+   * @throws An error if a conflict is not a pair of layers.
+   */
+  void cLevel_Linter::Setup(cConfig& config) {
+    cArray<std::string> overlap_layers = Parse_Sausage_Text(config.Get_Text_Property("lint-overlap"), ",");
+    this->overlap_layers.clear();
+    for (int layer_index = 0; layer_index < overlap_layers.Count(); layer_index++) {
+      this->overlap_layers.push_back(overlap_layers[layer_index]);
+    }
+    cArray<std::string> conflicts = Parse_Sausage_Text(config.Get_Text_Property("lint-conflict"), ",");
+    this->conflicts.clear();
+    for (int conflict_index = 0; conflict_index < conflicts.Count(); conflict_index++) {
+      cArray<std::string> pair = Parse_Sausage_Text(conflicts[conflict_index], ":");
+      Check_Condition((pair.Count() == 2), "Lint conflict " + conflicts[conflict_index] + " is not of the form layer:layer.");
+      sLint_Conflict conflict;
+      conflict.layer = pair[0];
+      conflict.other_layer = pair[1];
+      this->conflicts.push_back(conflict);
+    }
+  }
+
+  /**
+   * Lints a level. The sprites of each layer are cut into bands of rows and
+   * kept sorted by band and then by left edge, so that only sprites that
+   * share a band and whose edges come within reach of each other are
+   * compared. The order is reused between runs since most edits move few
+   * sprites.
+   * @param level The level to lint.
+   * @return The number of problems found.
+   */
+  int cLevel_Linter::Lint(cLevel& level) {
+    int layer_count = level.layers.size();
+    this->sweeps.resize(layer_count);
+    this->flags.resize(layer_count);
+    this->issues.clear();
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      this->Sort_Layer(level.layers[layer_index], this->sweeps[layer_index]);
+      this->flags[layer_index].assign(level.layers[layer_index].Count(), 0);
+    }
+    for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+      bool overlaps = (std::find(this->overlap_layers.begin(), this->overlap_layers.end(), level.layers[layer_index].layer) != this->overlap_layers.end());
+      this->Sweep_Layer(level, layer_index, overlaps);
+    }
+    int conflict_count = this->conflicts.size();
+    for (int conflict_index = 0; conflict_index < conflict_count; conflict_index++) {
+      int layer = level.Find_Layer(this->conflicts[conflict_index].layer);
+      int other_layer = level.Find_Layer(this->conflicts[conflict_index].other_layer);
+      if ((layer != NO_VALUE_FOUND) && (other_layer != NO_VALUE_FOUND) && (layer != other_layer)) {
+        this->Sweep_Layers(level, layer, other_layer);
+      }
+    }
+    return this->issues.size();
+  }
+
+  /**
+   * Sorts the sprites of a layer by band and left edge. A sprite has an entry
+   * for each band it covers. When every sprite still covers as many bands as
+   * the last time only the entries are refreshed and the old order is fixed
+   * up, which is quick after a few sprites moved.
+   * @param store The sprites on the layer.
+   * @param sweep The sorted entries of the layer from the last run.
+   */
+  void cLevel_Linter::Sort_Layer(cSprite_Store& store, std::vector<sLint_Entry>& sweep) {
+    int sprite_count = store.Count();
+    long long band_count = 0;
+    for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+      sRectangle bounds = store.Get_Bounds(sprite_index);
+      band_count += this->Get_Band(bounds.bottom) - this->Get_Band(bounds.top) + 1;
+    }
+    bool coherent = ((long long)sweep.size() == band_count);
+    int entry_count = sweep.size();
+    for (int entry_index = 0; coherent && (entry_index < entry_count); entry_index++) {
+      sLint_Entry& entry = sweep[entry_index];
+      if (entry.sprite >= sprite_count) { // Sprites were removed so the indices moved.
+        coherent = false;
+      }
+      else {
+        entry.bounds = store.Get_Bounds(entry.sprite);
+        entry.band = this->Get_Band(entry.bounds.top) + entry.row;
+        coherent = (entry.band <= this->Get_Band(entry.bounds.bottom));
+      }
+    }
+    if (!coherent) {
+      sweep.clear();
+      sweep.reserve(band_count);
+      for (int sprite_index = 0; sprite_index < sprite_count; sprite_index++) {
+        sLint_Entry entry;
+        entry.sprite = sprite_index;
+        entry.bounds = store.Get_Bounds(sprite_index);
+        entry.row = 0;
+        int last_band = this->Get_Band(entry.bounds.bottom);
+        for (entry.band = this->Get_Band(entry.bounds.top); entry.band <= last_band; entry.band++) {
+          sweep.push_back(entry);
+          entry.row++;
+        }
+      }
+      std::sort(sweep.begin(), sweep.end(), Is_Lint_Entry_Before);
+    }
+    else {
+      long long move_count = 0;
+      for (int entry_index = 1; entry_index < entry_count; entry_index++) {
+        sLint_Entry entry = sweep[entry_index];
+        int slot = entry_index;
+        while ((slot > 0) && Is_Lint_Entry_Before(entry, sweep[slot - 1])) {
+          sweep[slot] = sweep[slot - 1];
+          slot--;
+        }
+        sweep[slot] = entry;
+        move_count += entry_index - slot;
+        if (move_count > entry_count) { // Too far out of order to fix up one at a time.
+          std::sort(sweep.begin(), sweep.end(), Is_Lint_Entry_Before);
+          break;
+        }
+      }
+    }
+  }
+
+  /**
+   * Finds the duplicate and overlapping sprites on a layer. Sprites that
+   * share more than one band are only reported in the first band where they
+   * overlap.
+   * @param level The level.
+   * @param layer The index of the layer.
+   * @param overlaps Whether overlaps are problems on this layer or only exact duplicates are.
+   */
+  void cLevel_Linter::Sweep_Layer(cLevel& level, int layer, bool overlaps) {
+    cSprite_Store& store = level.layers[layer];
+    std::vector<sLint_Entry>& sweep = this->sweeps[layer];
+    int entry_count = sweep.size();
+    for (int entry_index = 0; entry_index < entry_count; entry_index++) {
+      sLint_Entry& entry = sweep[entry_index];
+      for (int other_index = entry_index + 1; (other_index < entry_count) && (sweep[other_index].band == entry.band) && (sweep[other_index].bounds.left <= entry.bounds.right); other_index++) {
+        sLint_Entry& other = sweep[other_index];
+        if (this->Is_Overlap(entry, other)) {
+          if (this->Is_Duplicate(store, entry.sprite, other.sprite)) {
+            this->Add_Issue(eLINT_DUPLICATE, layer, entry.sprite, layer, other.sprite);
+          }
+          else if (overlaps) {
+            this->Add_Issue(eLINT_OVERLAP, layer, entry.sprite, layer, other.sprite);
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * Finds the sprites on one layer that overlap sprites on another. Both
+   * layers are walked together in order, and each entry is compared with the
+   * entries of the other layer in the same band that start after it and
+   * before it ends.
+   * @param level The level.
+   * @param layer The index of the layer whose sprites are in conflict.
+   * @param other_layer The index of the layer they must not overlap.
+   */
+  void cLevel_Linter::Sweep_Layers(cLevel& level, int layer, int other_layer) {
+    std::vector<sLint_Entry>& sweep = this->sweeps[layer];
+    std::vector<sLint_Entry>& other_sweep = this->sweeps[other_layer];
+    int entry_count = sweep.size();
+    int other_count = other_sweep.size();
+    int entry_index = 0;
+    int other_index = 0;
+    while ((entry_index < entry_count) && (other_index < other_count)) {
+      sLint_Entry& entry = sweep[entry_index];
+      sLint_Entry& other = other_sweep[other_index];
+      if ((entry.band < other.band) || ((entry.band == other.band) && (entry.bounds.left <= other.bounds.left))) {
+        for (int next_index = other_index; (next_index < other_count) && (other_sweep[next_index].band == entry.band) && (other_sweep[next_index].bounds.left <= entry.bounds.right); next_index++) {
+          if (this->Is_Overlap(entry, other_sweep[next_index])) {
+            this->Add_Issue(eLINT_CONFLICT, layer, entry.sprite, other_layer, other_sweep[next_index].sprite);
+          }
+        }
+        entry_index++;
+      }
+      else {
+        for (int next_index = entry_index; (next_index < entry_count) && (sweep[next_index].band == other.band) && (sweep[next_index].bounds.left <= other.bounds.right); next_index++) {
+          if (this->Is_Overlap(sweep[next_index], other)) {
+            this->Add_Issue(eLINT_CONFLICT, layer, sweep[next_index].sprite, other_layer, other.sprite);
+          }
+        }
+        other_index++;
+      }
+    }
+  }
+
+  /**
+   * Determines if two entries in the same band overlap, and if this band is
+   * the first one they overlap in so the pair is only found once.
+   * @param entry The first entry.
+   * @param other The second entry.
+   * @return True if the entries overlap first in their band, false otherwise.
+   */
+  bool cLevel_Linter::Is_Overlap(sLint_Entry& entry, sLint_Entry& other) {
+    return ((other.bounds.top <= entry.bounds.bottom) && (other.bounds.bottom >= entry.bounds.top) && (this->Get_Band(std::max(entry.bounds.top, other.bounds.top)) == entry.band));
+  }
+
+  /**
+   * Gets the band a coordinate falls in.
+   * @param coord The y coordinate.
+   * @return The band.
+   */
+  int cLevel_Linter::Get_Band(int coord) {
+    return (coord >= 0) ? (coord / LINT_BAND_SIZE) : (((coord + 1) / LINT_BAND_SIZE) - 1);
+  }
+
+  /**
+   * Determines if two sprites on a layer are exact copies. Equal extra
+   * properties share a slot so the slots are compared.
+   * @param store The sprites on the layer.
+   * @param sprite The index of the first sprite.
+   * @param other The index of the second sprite.
+   * @return True if the sprites are the same, false otherwise.
+   */
+  bool cLevel_Linter::Is_Duplicate(cSprite_Store& store, int sprite, int other) {
+    return ((store.x[sprite] == store.x[other]) && (store.y[sprite] == store.y[other]) && (store.size_x[sprite] == store.size_x[other]) && (store.size_y[sprite] == store.size_y[other]) &&
+            (store.names[sprite] == store.names[other]) && (store.icons[sprite] == store.icons[other]) && (store.extras[sprite] == store.extras[other]));
+  }
+
+  /**
+   * Records a problem and flags both sprites.
+   * @param kind The kind of problem.
+   * @param layer The index of the layer of the first sprite.
+   * @param sprite The index of the first sprite.
+   * @param other_layer The index of the layer of the second sprite.
+   * @param other_sprite The index of the second sprite.
+   */
+  void cLevel_Linter::Add_Issue(int kind, int layer, int sprite, int other_layer, int other_sprite) {
+    sLint_Issue issue;
+    issue.kind = kind;
+    issue.layer = layer;
+    issue.sprite = sprite;
+    issue.other_layer = other_layer;
+    issue.other_sprite = other_sprite;
+    if ((layer == other_layer) && (other_sprite < sprite)) { // Pairs on one layer list the first sprite first.
+      issue.sprite = other_sprite;
+      issue.other_sprite = sprite;
+    }
+    this->issues.push_back(issue);
+    this->flags[layer][sprite] = 1;
+    this->flags[other_layer][other_sprite] = 1;
+  }
+
+  /**
+   * Describes a problem.
+   * @param level The level that was linted.
+   * @param issue The problem.
+   * @return The description of the problem.
+   */
+  std::string cLevel_Linter::Describe(cLevel& level, sLint_Issue& issue) {
+    cSprite_Store& store = level.layers[issue.layer];
+    cSprite_Store& other_store = level.layers[issue.other_layer];
+    std::string sprite = level.strings.Get(store.names[issue.sprite]) + " at " + Number_To_Text(store.x[issue.sprite]) + "," + Number_To_Text(store.y[issue.sprite]) + " on " + store.layer;
+    std::string other = level.strings.Get(other_store.names[issue.other_sprite]) + " at " + Number_To_Text(other_store.x[issue.other_sprite]) + "," + Number_To_Text(other_store.y[issue.other_sprite]) + " on " + other_store.layer;
+    std::string text;
+    if (issue.kind == eLINT_DUPLICATE) {
+      text = "Duplicate " + sprite + ".";
+    }
+    else if (issue.kind == eLINT_OVERLAP) {
+      text = "Overlap of " + sprite + " with " + other + ".";
+    }
+    else {
+      text = "Conflict of " + sprite + " with " + other + ".";
+    }
+    return text;
+  }
+
+  /**
+   * Orders lint entries by band, then by left edge, and then by sprite so
+   * that the problems come out in the same order every time.
+   * @param entry_a The first entry.
+   * @param entry_b The second entry.
+   * @return True if the first entry comes before the second.
+   */
+  bool Is_Lint_Entry_Before(const sLint_Entry& entry_a, const sLint_Entry& entry_b) {
+    bool before = (entry_a.sprite < entry_b.sprite);
+    if (entry_a.band != entry_b.band) {
+      before = (entry_a.band < entry_b.band);
+    }
+    else if (entry_a.bounds.left != entry_b.bounds.left) {
+      before = (entry_a.bounds.left < entry_b.bounds.left);
+    }
+    return before;
+  }
+
+}
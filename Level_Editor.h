@@ -1,61 +1,1127 @@
-// ============================================================================
-// 2D Level Editor (Definitions)
-// Programmed by Francois Lamini
-// ============================================================================
-
-#include "..\Code_Helper\Codeloader.hpp"
-#include "..\Code_Helper\Allegro.hpp"
-
-namespace Codeloader {
-
-  struct sDebug_Entry {
-    std::string text;
-    int x;
-    int y;
-  };
-
-  class cLevel_Editor {
-
-    public:
-      cHash<std::string, tObject_List> layers;
-      std::string sel_layer;
-      int sel_sprite;
-      std::string music_track;
-      std::string background;
-      cHash<std::string, tObject> sprite_palette;
-      std::string sel_sprite_type;
-      int sel_level;
-      std::string level_name;
-      int scroll_x;
-      int scroll_y;
-      int timer;
-      cIO_Control* io;
-      cArray<std::string> backgrounds;
-      cArray<std::string> music_tracks;
-      cArray<sDebug_Entry> debug_log;
-
-      cLevel_Editor(std::string name, cConfig& config, cIO_Control* io, cArray<std::string> backgrounds, cArray<std::string> music_tracks);
-      ~cLevel_Editor();
-      void Load_Sprite_Palette(std::string name);
-      void Load_Level(std::string name);
-      void Save_Level(std::string name);
-      void Process_Keys();
-      void Process_Mouse();
-      void Set_Timer();
-      void Select_Layer(int direction);
-      int Select_Sprite(sPoint coords);
-      int Create_Sprite(sPoint coords);
-      void Select_Sprite_Type(int direction);
-      void Select_Background(int direction);
-      void Select_Music_Track(int direction);
-      void Render();
-      void Process();
-      void Destar_Sprite(tObject& sprite);
-      void Print_Object(tObject& object);
-      void Debug(std::string text, int x, int y);
-      cArray<std::string> Get_Level_List();
-      int Find_Selected_Level_Index(std::string name);
-  
-  };
-
+// ============================================================================
+// 2D Level Editor (Definitions)
+// Programmed by Francois Lamini
+// ============================================================================
+
+#include "..\Code_Helper\Codeloader.hpp"
+#include "..\Code_Helper\Allegro.hpp"
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <stdint.h>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <ctime>
+#include <climits>
+
+#define GRID_CELL_SIZE 128
+#define LAYER_CACHE_MARGIN 128
+#define STREAM_CHUNK_SIZE 1024
+#define INPUT_QUEUE_SIZE 256
+#define PROFILE_HISTORY 60
+#define PROFILE_TRACE_LIMIT 1000000
+#define BAKE_MAGIC "LVLR"
+#define BAKE_VERSION 1
+#define ATLAS_NAME "Atlas"
+#define ATLAS_SIZE 1024
+#define ATLAS_PADDING 1
+#define LEVEL_MAGIC "LVLB"
+#define LEVEL_VERSION 1
+#define LEVEL_PROP_VERSION 1
+#define LEVEL_NO_PROPS 0xFFFFFFFF
+#define TEXT_PARSE_MIN 65536
+#define TEXT_SLICE_SIZE 4096
+#define BENCHMARK_FRAMES 600
+#define BENCHMARK_SEED 12345
+#define GENERATOR_SPACING 64
+#define GENERATOR_CLUSTER_SIZE 500
+#define LINT_BAND_SIZE 128
+
+namespace Codeloader {
+
+  struct sDebug_Entry {
+    std::string text;
+    int x;
+    int y;
+  };
+
+  enum eLevel_Format {
+    eLEVEL_TEXT,
+    eLEVEL_BINARY
+  };
+
+  enum eUndo_Op {
+    eUNDO_MOVE,
+    eUNDO_RESIZE,
+    eUNDO_ADD,
+    eUNDO_REMOVE,
+    eUNDO_PROPERTY,
+    eUNDO_BACKGROUND,
+    eUNDO_MUSIC_TRACK,
+    eUNDO_SHIFT,
+    eUNDO_GROW,
+    eUNDO_RELAYER
+  };
+
+  enum eInput_Event {
+    eINPUT_KEY_DOWN,
+    eINPUT_KEY_UP,
+    eINPUT_MOUSE
+  };
+
+  enum eProfile_Phase {
+    ePHASE_FRAME,
+    ePHASE_INPUT,
+    ePHASE_KEYS,
+    ePHASE_MOUSE,
+    ePHASE_HUD,
+    ePHASE_DEBUG_LOG,
+    ePHASE_REFRESH,
+    ePHASE_LINT,
+    ePHASE_LAYER
+  };
+
+  enum eSelect_Mode {
+    eSELECT_NONE,
+    eSELECT_BOX,
+    eSELECT_LASSO
+  };
+
+  struct sLevel_Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t string_count;
+    uint32_t string_offset;
+    uint32_t layout_count;
+    uint32_t layout_offset;
+    uint32_t layer_count;
+    uint32_t layer_offset;
+    uint32_t prop_offset;
+    uint32_t prop_size;
+    uint32_t background;
+    uint32_t music_track;
+  };
+
+  struct sLevel_Layer {
+    uint32_t name;
+    uint32_t sprite_count;
+    uint32_t sprite_offset;
+  };
+
+  struct sLevel_Sprite {
+    int32_t x;
+    int32_t y;
+    int32_t size_x;
+    int32_t size_y;
+    uint32_t name;
+    uint32_t icon;
+    uint32_t layout;
+    uint32_t props;
+  };
+
+  struct sLevel_Prop {
+    uint32_t key;
+    uint32_t type;
+    uint32_t text;
+    uint32_t reserved;
+    double number;
+  };
+
+  struct sSprite_Record {
+    int name;
+    int icon;
+    int x;
+    int y;
+    int size_x;
+    int size_y;
+    int layout;
+    tObject extra;
+  };
+
+  struct sText_Sprite {
+    int layer;
+    std::string name;
+    std::string icon;
+    int x;
+    int y;
+    int size_x;
+    int size_y;
+    std::vector<std::string> keys;
+    tObject extra;
+  };
+
+  struct sText_Chunk {
+    int start;
+    int end;
+    std::vector<sText_Sprite> sprites;
+    std::string error;
+  };
+
+  struct sText_Slice {
+    int layer;
+    int first;
+    int count;
+    std::string text;
+  };
+
+  struct sImage {
+    std::string name;
+    int width;
+    int height;
+  };
+
+  bool Read_Image_Size(std::string file, sImage& image);
+  sImage& Get_File_Image(std::unordered_map<std::string, sImage>& image_sizes, std::string name);
+  void Destar_Sprite(tObject& sprite);
+
+  class cString_Table {
+
+    public:
+      std::vector<std::string> strings;
+      std::unordered_map<std::string, int> ids;
+
+      int Intern(std::string text);
+      int Find(std::string text);
+      void Index();
+      std::string& Get(int id);
+      int Count();
+
+  };
+
+  class cImage_Table {
+
+    public:
+      cIO_Control* io;
+      cString_Table names;
+      std::vector<sImage> images;
+      std::unordered_map<std::string, sImage>* file_sizes;
+
+      cImage_Table();
+      cImage_Table(cIO_Control* io);
+      int Resolve(std::string name);
+      sImage& Get(int handle);
+      int Count();
+
+  };
+
+  class cSpatial_Grid {
+
+    public:
+      int cell_size;
+      std::unordered_map<long long, std::vector<int> > cells;
+      std::vector<sRectangle> bounds;
+      std::vector<int> marks;
+      int mark;
+      sRectangle dirty;
+      bool is_dirty;
+      std::vector<sRectangle> changes;
+      bool track_changes;
+
+      cSpatial_Grid();
+      cSpatial_Grid(int cell_size);
+      void Insert(int sprite, sRectangle bounds);
+      void Update(int sprite, sRectangle bounds);
+      void Remove(int sprite);
+      void Remove_Sprites(std::vector<int>& sprites);
+      void Insert_Sprites(std::vector<int>& sprites, std::vector<sRectangle>& bounds);
+      void Query(sRectangle area, std::vector<int>& sprites);
+      int Pick(sPoint point);
+      void Clear();
+      int Count();
+      void Add_To_Cells(int sprite, sRectangle bounds);
+      void Remove_From_Cells(int sprite, sRectangle bounds);
+      int Get_Cell(int coord);
+      void Mark_Dirty(sRectangle area);
+      void Mark_All_Dirty();
+      bool Take_Dirty(sRectangle& area);
+      long long Get_Cell_Key(int cell_x, int cell_y);
+
+  };
+
+  class cSprite_Store {
+
+    public:
+      std::string layer;
+      cString_Table* strings;
+      cImage_Table* images;
+      std::vector<int> x;
+      std::vector<int> y;
+      std::vector<int> size_x;
+      std::vector<int> size_y;
+      std::vector<int> width;
+      std::vector<int> height;
+      std::vector<int> names;
+      std::vector<int> icons;
+      std::vector<int> layouts;
+      std::vector<int> extras;
+      std::vector<std::vector<std::string> > layout_table;
+      std::vector<std::shared_ptr<tObject> > extra_table;
+      std::vector<int> extra_refs;
+      std::vector<int> free_extras;
+      std::unordered_map<std::string, int> extra_ids;
+      cSpatial_Grid grid;
+
+      cSprite_Store();
+      cSprite_Store(std::string layer, cString_Table* strings, cImage_Table* images);
+      int Add(tObject& sprite);
+      int Append(int name, int icon, int x, int y, int size_x, int size_y, int layout, tObject* extra);
+      void Copy_Sprites(cSprite_Store& other);
+      void Remove(int index);
+      void Remove_Sprites(std::vector<int>& indices);
+      void Insert_Records(std::vector<int>& indices, std::vector<sSprite_Record>& records, cSprite_Store& source);
+      sSprite_Record Get_Record(int index);
+      sSprite_Record Make_Record(tObject& sprite);
+      int Store_Extra(tObject* extra);
+      void Release_Extra(int slot);
+      std::string Get_Extra_Key(tObject& extra);
+      tObject Get_Object(int index);
+      sRectangle Get_Bounds(int index);
+      void Update_Bounds(int index);
+      bool Has_Property(int index, std::string key);
+      cValue& Get_Property(int index, std::string key);
+      void Set_Property(int index, std::string key, cValue value);
+      void Remove_Property(int index, std::string key);
+      int Count();
+      void Clear();
+      void Reserve(int count);
+      bool Is_Typed_Key(std::string key);
+      int Find_Layout(std::vector<std::string>& keys);
+
+  };
+
+  class cMapped_File {
+
+    public:
+      const char* data;
+      int size;
+      void* file_handle;
+      void* map_handle;
+
+      cMapped_File(std::string name);
+      ~cMapped_File();
+
+    private:
+      cMapped_File(const cMapped_File& other);
+      cMapped_File& operator=(const cMapped_File& other);
+
+  };
+
+  class cLevel;
+
+  class cLevel_Journal {
+
+    public:
+      std::string name;
+      std::string base_name;
+      bool base_exists;
+      std::vector<std::string> pending;
+      std::string last_op;
+      int entry_count;
+      int limit;
+
+      cLevel_Journal();
+      void Open(std::string name, std::string base_name, cLevel& level);
+      void Record(std::string op, std::string line);
+      std::string Flush();
+      bool Needs_Compaction();
+      int Replay(cLevel& level, std::vector<std::string>& lines, int& line_index);
+      bool Read_Sprite(std::vector<std::string>& lines, int& line_index, tObject& sprite);
+      std::string Get_Header(std::string base_name);
+      void Append_File(std::string name, std::string text);
+      unsigned long long Hash_File(std::string name);
+
+  };
+
+  struct sUndo_Entry {
+    int op;
+    int layer;
+    int new_layer;
+    int sprite;
+    int old_x;
+    int old_y;
+    int new_x;
+    int new_y;
+    std::vector<int> sprites;
+    std::vector<int> moved;
+    std::vector<int> clamped;
+    std::vector<sSprite_Record> records;
+    std::string key;
+    bool had_value;
+    bool has_value;
+    cValue old_value;
+    cValue new_value;
+    std::string old_text;
+    std::string new_text;
+  };
+
+  class cUndo_History {
+
+    public:
+      std::deque<sUndo_Entry> undo_entries;
+      std::deque<sUndo_Entry> redo_entries;
+      long long memory;
+      long long limit;
+      bool sealed;
+
+      cUndo_History();
+      sUndo_Entry Make_Entry(int op, int layer, int sprite);
+      void Record(sUndo_Entry& entry);
+      bool Undo(cLevel& level);
+      bool Redo(cLevel& level);
+      void Seal();
+      void Clear();
+      bool Coalesce(sUndo_Entry& entry);
+      void Apply(cLevel& level, sUndo_Entry& entry, bool undo);
+      long long Get_Size(sUndo_Entry& entry);
+      void Trim();
+      void Drop_Sprites(std::vector<std::vector<int> >& dropped);
+      bool Drop_From_Entry(sUndo_Entry& entry, std::vector<std::vector<int> >& gone, bool after);
+      int Shift_Sprite(std::vector<int>& gone, int sprite);
+      bool Shift_Sprites(std::vector<int>& gone, std::vector<int>& sprites, int step);
+      void Remove_Sprites(std::vector<int>& gone, std::vector<int>& sprites);
+      void Insert_Sprites(std::vector<int>& gone, std::vector<int>& sprites);
+
+  };
+
+  class cLevel {
+
+    public:
+      std::string background;
+      std::string music_track;
+      std::vector<cSprite_Store> layers;
+      cString_Table layer_names;
+      cString_Table strings;
+      cImage_Table images;
+      std::vector<sText_Sprite> templates;
+      std::unordered_map<std::string, int> template_ids;
+      int format;
+      int generation;
+      cLevel_Journal* journal;
+      cUndo_History* history;
+
+      cLevel();
+      void Setup(cArray<std::string> layers, cIO_Control* io);
+      int Find_Layer(std::string name);
+      void Check_Sprite(tObject& sprite);
+      void Load_Templates(std::string palette);
+      void Add_Template(tObject& sprite);
+      int Find_Template(std::string name);
+      void Load(std::string name);
+      void Save(std::string name);
+      void Load_Text(std::string name);
+      void Save_Text(std::string name);
+      int Find_Object_Line(const char* data, int size, int offset);
+      void Parse_Text_Chunk(const char* data, sText_Chunk* chunk);
+      bool Parse_Text_Object(const char* data, int end, int& offset, tObject& object);
+      void Apply_Text_Property(sText_Sprite& sprite, std::string& layer, int& found, std::string& key, cValue& value);
+      bool Read_Text_Line(const char* data, int end, int& offset, std::string& line);
+      void Parse_Text_Property(std::string& line, std::string& key, cValue& value);
+      void Format_Text_Worker(std::vector<sText_Slice>* slices, std::atomic<int>* next_slice, std::vector<int>* name_templates);
+      bool Is_Template_Value(sText_Sprite& sprite, cSprite_Store& store, int index, std::string& key);
+      void Load_Binary(std::string name);
+      void Save_Binary(std::string name);
+      bool Is_Binary(std::string name);
+      void Clear();
+      void Snapshot(cLevel& snapshot);
+      void Index_Snapshot();
+      void Replace_File(std::string temp_name, std::string name);
+      int Add_Sprite(int layer, tObject& sprite);
+      void Move_Sprite(int layer, int sprite, int x, int y);
+      void Resize_Sprite(int layer, int sprite, int size_x, int size_y);
+      void Remove_Sprite(int layer, int sprite);
+      void Move_Sprites(int layer, std::vector<int>& sprites, int offset_x, int offset_y);
+      void Resize_Sprites(int layer, std::vector<int>& sprites, int offset_x, int offset_y);
+      void Remove_Sprites(int layer, std::vector<int>& sprites);
+      void Change_Layer(int layer, std::vector<int>& sprites, int new_layer);
+      void Insert_Sprites(int layer, std::vector<int>& sprites, std::vector<sSprite_Record>& records, cSprite_Store& source);
+      void Set_Sprite_Property(int layer, int sprite, std::string key, cValue value);
+      void Remove_Sprite_Property(int layer, int sprite, std::string key);
+      void Set_Background(std::string background);
+      void Set_Music_Track(std::string music_track);
+      std::string Format_Value(cValue& value);
+      std::string Format_Sprites(std::vector<int>& sprites);
+      std::string Format_Sprite(cSprite_Store& store, int sprite);
+      void Write_Block(std::string& buffer, const void* data, int size);
+      void Pad_Block(std::string& buffer);
+      void Read_Block(cMapped_File& file, int offset, void* data, int size);
+
+    private:
+      cLevel(const cLevel& other);
+      cLevel& operator=(const cLevel& other);
+
+  };
+
+  struct sSave_Job {
+    cLevel* snapshot;
+    std::string name;
+    std::string journal;
+    std::string text;
+  };
+
+  class cAutosaver {
+
+    public:
+      std::thread worker;
+      std::mutex lock;
+      std::condition_variable signal;
+      std::deque<sSave_Job> jobs;
+      bool running;
+
+      cAutosaver();
+      ~cAutosaver();
+      void Start();
+      void Stop();
+      void Save(cLevel* snapshot, std::string name, std::string journal);
+      void Append(std::string journal, std::string text);
+      void Run();
+
+  };
+
+  class cLevel_Generator {
+
+    public:
+      int sprite_count;
+      std::string pattern;
+      int max_size;
+      double link_rate;
+      unsigned int seed;
+      std::string background;
+      std::string music_track;
+      int screen_width;
+      int screen_height;
+      cArray<std::string> layers;
+      std::vector<double> layer_weights;
+      std::vector<tObject> types;
+      std::vector<std::vector<tObject> > layer_types;
+      std::discrete_distribution<int> layer_picker;
+      std::mt19937 random;
+      int world_width;
+      int world_height;
+      std::vector<sPoint> clusters;
+
+      cLevel_Generator(cConfig& config);
+      void Load_Palette(std::string name);
+      void Set_Mix(std::string mix);
+      void Generate(cLevel& level, std::vector<std::string>& level_names, int level_index);
+      void Setup_World(int layer_count);
+      sPoint Place_Sprite();
+      int Pick_Size();
+      int Pick_Layer();
+      tObject& Pick_Type(int layer);
+
+  };
+
+  struct sChunk {
+    int x;
+    int y;
+    bool exists;
+    bool loaded;
+    bool loading;
+    bool dirty;
+    bool broken;
+  };
+
+  struct sStream_Job {
+    long long key;
+    std::string file;
+    cLevel* level;
+    std::string text;
+  };
+
+  class cLevel_Stream {
+
+    public:
+      std::string name;
+      int chunk_size;
+      int radius;
+      cArray<std::string> layers;
+      std::unordered_map<long long, sChunk> chunks;
+      std::thread worker;
+      std::mutex lock;
+      std::condition_variable signal;
+      std::deque<sStream_Job> jobs;
+      std::deque<sStream_Job> loaded;
+      bool running;
+
+      cLevel_Stream();
+      ~cLevel_Stream();
+      void Open(std::string name, cLevel& level, int radius);
+      void Close();
+      bool Update(cLevel& level, sRectangle view, std::vector<std::vector<int> >& dropped);
+      void Flush(cLevel& level);
+      void Write_World(cLevel& level, std::string name, int chunk_size);
+      void Track_Changes(cLevel& level, bool keep);
+      void Mark_Dirty(int x, int y);
+      void Request_Load(sChunk& chunk);
+      void Merge_Chunk(cLevel& level, cLevel& chunk_level);
+      int Evict_Chunk(cLevel& level, sChunk& chunk, std::vector<std::vector<int> >& dropped);
+      void Save_Chunk(cLevel& level, sChunk& chunk, std::vector<std::vector<int> >& indices);
+      void Find_Chunk_Sprites(cLevel& level, sChunk& chunk, std::vector<std::vector<int> >& indices);
+      cLevel* Extract_Chunk(cLevel& level, std::vector<std::vector<int> >& indices);
+      std::string Get_Manifest(cLevel& level);
+      void Read_Manifest(cLevel& level);
+      sChunk& Get_Chunk(int chunk_x, int chunk_y);
+      long long Get_Chunk_Key(int chunk_x, int chunk_y);
+      std::string Get_Chunk_File(sChunk& chunk);
+      int Get_Chunk_Coord(int coord);
+      void Queue(sStream_Job job);
+      void Run();
+
+  };
+
+  class cLevel_Index {
+
+    public:
+      cIO_Control* io;
+      std::string folder;
+      std::vector<std::string> names;
+      cArray<std::string> levels;
+      long long folder_time;
+      int poll_interval;
+      int poll_timer;
+
+      cLevel_Index();
+      void Setup(cIO_Control* io, int poll_interval);
+      void Refresh();
+      void Poll();
+      int Find(std::string name);
+      long long Get_Folder_Time();
+
+  };
+
+  struct sLevel_Link {
+    std::string layer;
+    int x;
+    int y;
+    std::string level;
+    std::string type;
+    std::string code;
+  };
+
+  struct sLevel_Report {
+    std::string name;
+    std::string error;
+    std::vector<sLevel_Link> links;
+    std::vector<std::string> entries;
+  };
+
+  class cProject_Validator {
+
+    public:
+      std::string folder;
+      std::string palette;
+      cArray<std::string> layers;
+      std::vector<sLevel_Report> reports;
+      std::unordered_map<std::string, int> ids;
+      std::atomic<int> next_level;
+      int thread_count;
+      int problem_count;
+
+      cProject_Validator(cConfig& config, std::string folder);
+      void List_Levels();
+      void Load_Levels();
+      void Load_Worker();
+      void Scan_Level(sLevel_Report& report);
+      int Validate(std::vector<std::string>& starts);
+      void Check_Links();
+      void Check_Reachable(std::vector<std::string>& starts);
+      void Report(std::string problem);
+
+  };
+
+  struct sBake_Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t tile_size;
+    uint32_t string_count;
+    uint32_t string_offset;
+    uint32_t string_size;
+    uint32_t image_count;
+    uint32_t image_offset;
+    uint32_t tile_count;
+    uint32_t tile_offset;
+    uint32_t grid_count;
+    uint32_t grid_offset;
+    uint32_t run_count;
+    uint32_t run_offset;
+    uint32_t sprite_count;
+    uint32_t sprite_offset;
+    uint32_t link_count;
+    uint32_t link_offset;
+    uint32_t background;
+    uint32_t music_track;
+  };
+
+  struct sBake_Image {
+    uint32_t name;
+    uint32_t width;
+    uint32_t height;
+    uint32_t reserved;
+  };
+
+  struct sBake_Tile {
+    uint32_t image;
+    uint32_t source_x;
+    uint32_t source_y;
+    uint32_t reserved;
+  };
+
+  struct sBake_Grid {
+    uint32_t layer;
+    int32_t left;
+    int32_t top;
+    uint32_t width;
+    uint32_t height;
+    uint32_t run_count;
+    uint32_t run_offset;
+    uint32_t reserved;
+  };
+
+  struct sBake_Run {
+    uint32_t count;
+    uint32_t tile;
+  };
+
+  struct sBake_Link {
+    uint32_t level;
+    uint32_t type;
+    uint32_t code;
+    int32_t sprite;
+  };
+
+  struct sBake_Sprite {
+    int layer;
+    int sprite;
+  };
+
+  class cLevel_Baker {
+
+    public:
+      cArray<std::string> layers;
+      std::vector<std::string> static_layers;
+      int tile_size;
+      std::string folder;
+      std::string palette;
+      std::unordered_map<std::string, sImage> image_sizes;
+      std::unordered_map<std::string, std::unordered_map<std::string, int> > entries;
+      cString_Table strings;
+      std::vector<sBake_Image> images;
+      std::unordered_map<std::string, int> image_ids;
+
+      cLevel_Baker();
+      void Setup(cConfig& config, std::string folder);
+      void Bake(std::string name);
+      void Bake_Level(cLevel& level, std::string name);
+      void Bake_Grid(cSprite_Store& store, std::vector<sBake_Tile>& tiles, std::unordered_map<long long, int>& tile_ids, std::vector<sBake_Grid>& grids, std::vector<sBake_Run>& runs);
+      int Add_Image(sImage& image);
+      void Get_Sprites(cLevel& level, std::vector<sBake_Sprite>& sprites);
+      bool Is_Tiled(cSprite_Store& store, int sprite);
+      sImage& Get_Image(cSprite_Store& store, int sprite);
+      int Find_Entry(std::string level, std::string type, std::string code);
+      std::string Get_Entry_Key(cLevel& level, cSprite_Store& store, int sprite);
+
+  };
+
+  enum eLint_Kind {
+    eLINT_DUPLICATE,
+    eLINT_OVERLAP,
+    eLINT_CONFLICT
+  };
+
+  struct sLint_Entry {
+    sRectangle bounds;
+    int band;
+    int row;
+    int sprite;
+  };
+
+  struct sLint_Issue {
+    int kind;
+    int layer;
+    int sprite;
+    int other_layer;
+    int other_sprite;
+  };
+
+  struct sLint_Conflict {
+    std::string layer;
+    std::string other_layer;
+  };
+
+  class cLevel_Linter {
+
+    public:
+      std::vector<std::string> overlap_layers;
+      std::vector<sLint_Conflict> conflicts;
+      std::vector<std::vector<sLint_Entry> > sweeps;
+      std::vector<std::vector<char> > flags;
+      std::vector<sLint_Issue> issues;
+
+      void Setup(cConfig& config);
+      int Lint(cLevel& level);
+      void Sort_Layer(cSprite_Store& store, std::vector<sLint_Entry>& sweep);
+      void Sweep_Layer(cLevel& level, int layer, bool overlaps);
+      void Sweep_Layers(cLevel& level, int layer, int other_layer);
+      bool Is_Overlap(sLint_Entry& entry, sLint_Entry& other);
+      bool Is_Duplicate(cSprite_Store& store, int sprite, int other);
+      int Get_Band(int coord);
+      void Add_Issue(int kind, int layer, int sprite, int other_layer, int other_sprite);
+      std::string Describe(cLevel& level, sLint_Issue& issue);
+
+  };
+
+  bool Is_Lint_Entry_Before(const sLint_Entry& entry_a, const sLint_Entry& entry_b);
+
+  struct sTile {
+    int image;
+    int x;
+    int y;
+    int width;
+    int height;
+    int count_x;
+    int count_y;
+  };
+
+  class cTiled_IO {
+
+    public:
+      virtual ~cTiled_IO() {}
+      virtual void Draw_Image_Tiled(std::string name, int x, int y, int width, int height, int count_x, int count_y) = 0;
+
+  };
+
+  struct sInput_Event {
+    int type;
+    sSignal signal;
+    double time;
+  };
+
+  class cInput_Queue {
+
+    public:
+      std::vector<sInput_Event> events;
+      std::atomic<int> head;
+      std::atomic<int> tail;
+
+      cInput_Queue();
+      bool Push(sInput_Event event);
+      bool Pop(sInput_Event& event);
+      double Get_Time();
+
+  };
+
+  class cInput_Source {
+
+    public:
+      virtual ~cInput_Source() {}
+      virtual void Start_Input(cInput_Queue* queue) = 0;
+      virtual void Stop_Input() = 0;
+
+  };
+
+  struct sAtlas_Entry {
+    std::string name;
+    int page;
+    int x;
+    int y;
+    int width;
+    int height;
+  };
+
+  class cAtlas_Packer {
+
+    public:
+      int page_size;
+      int padding;
+      int page_count;
+      std::vector<sAtlas_Entry> entries;
+
+      cAtlas_Packer(int page_size, int padding);
+      void Add(std::string name, int width, int height);
+      void Pack();
+
+  };
+
+  bool Is_Atlas_Entry_Before(const sAtlas_Entry& entry_a, const sAtlas_Entry& entry_b);
+
+  struct sLoaded_Image {
+    std::string name;
+    ALLEGRO_BITMAP* bitmap;
+  };
+
+  class cAllegro_Tiled_IO : public cAllegro_IO, public cTiled_IO, public cInput_Source {
+
+    public:
+      std::vector<ALLEGRO_BITMAP*> atlas_pages;
+      std::unordered_map<std::string, sImage> image_files;
+      std::deque<std::string> pending_images;
+      std::deque<sLoaded_Image> loaded_images;
+      std::vector<std::thread> loaders;
+      std::mutex load_lock;
+      bool stop_loading;
+      int scale;
+      ALLEGRO_EVENT_QUEUE* input_events;
+      cInput_Queue* input_queue;
+      std::thread input_thread;
+      std::atomic<bool> stop_input;
+      int mouse_button;
+
+      cAllegro_Tiled_IO(std::string title, int width, int height, int scale, std::string font);
+      ~cAllegro_Tiled_IO();
+      void Start_Input(cInput_Queue* queue);
+      void Stop_Input();
+      void Run_Input();
+      int Map_Key(int keycode);
+      void Draw_Image(std::string name, int x, int y, int width, int height, int angle, bool flip_x, bool flip_y);
+      void Draw_Image_Tiled(std::string name, int x, int y, int width, int height, int count_x, int count_y);
+      int Get_Image_Width(std::string name);
+      int Get_Image_Height(std::string name);
+      void Play_Music(std::string name);
+      void Refresh();
+      void Scan_Resources();
+      void Start_Loading(std::vector<std::string>& first_images);
+      void Load_Worker();
+      void Upload_Images();
+      void Prioritize_Image(std::string name);
+      ALLEGRO_BITMAP* Load_Image_Now(std::string name);
+      void Load_Atlas(cArray<std::string> names, std::string atlas_name, bool rebuild);
+      std::vector<std::string> Get_Atlas_Sources(cArray<std::string>& names);
+      bool Read_Atlas(std::string atlas_name, std::vector<std::string>& sources, std::vector<sAtlas_Entry>& entries);
+      void Build_Atlas(cArray<std::string>& names, std::string atlas_name, std::vector<std::string>& sources, std::vector<sAtlas_Entry>& entries);
+      void Use_Atlas(std::vector<sAtlas_Entry>& entries);
+      long long Get_File_Time(std::string name);
+
+  };
+
+  class cLayer_Cache {
+
+    public:
+      sRectangle area;
+      bool valid;
+      std::vector<sTile> tiles;
+      std::vector<int> sprites;
+      int draw_count;
+      int visit_count;
+      int cull_count;
+
+      cLayer_Cache();
+      void Update(cSprite_Store& store, sRectangle view);
+      void Build(cSprite_Store& store, sRectangle view);
+      void Draw(cIO_Control* io, cTiled_IO* tiled_io, cImage_Table& images, sRectangle view);
+
+  };
+
+  struct sProfile_Sample {
+    double time;
+    int draw_count;
+    int visit_count;
+    int cull_count;
+  };
+
+  struct sProfile_Phase {
+    std::string name;
+    double start;
+    sProfile_Sample span;
+    sProfile_Sample frame;
+    sProfile_Sample total;
+    std::vector<sProfile_Sample> history;
+  };
+
+  struct sTrace_Event {
+    int phase;
+    double start;
+    sProfile_Sample sample;
+  };
+
+  class cProfiler {
+
+    public:
+      bool enabled;
+      bool tracing;
+      std::vector<sProfile_Phase> phases;
+      std::vector<sTrace_Event> trace;
+      int frame_count;
+
+      cProfiler();
+      int Add_Phase(std::string name);
+      void Begin(int phase);
+      void End(int phase);
+      void Count(int phase, int draw_count, int visit_count, int cull_count);
+      void End_Frame();
+      sProfile_Sample Get_Average(int phase);
+      void Start_Trace();
+      void Save_Trace(std::string name);
+      double Get_Time();
+
+  };
+
+  class cProfile_Scope {
+
+    public:
+      cProfiler* profiler;
+      int phase;
+
+      cProfile_Scope(cProfiler& profiler, int phase);
+      ~cProfile_Scope();
+
+  };
+
+  class cHeadless_IO : public cIO_Control, public cTiled_IO {
+
+    public:
+      int width;
+      int height;
+      int image_size;
+      bool rasterize;
+      std::vector<unsigned int> buffer;
+      unsigned int color;
+      std::unordered_map<std::string, sImage> images;
+      std::deque<sSignal> keys;
+      std::deque<sSignal> signals;
+      cArray<std::string> files;
+      long long draw_count;
+      long long text_count;
+      long long pixel_count;
+      long long frame_count;
+
+      cHeadless_IO(int width, int height, int image_size, bool rasterize);
+      void Draw_Image(std::string name, int x, int y, int width, int height, int angle, bool flip_x, bool flip_y);
+      void Draw_Image_Tiled(std::string name, int x, int y, int width, int height, int count_x, int count_y);
+      int Get_Image_Width(std::string name);
+      int Get_Image_Height(std::string name);
+      void Color(int red, int green, int blue);
+      void Box(int x, int y, int width, int height, int red, int green, int blue);
+      void Output_Text(std::string text, int x, int y, int red, int green, int blue);
+      int Get_Text_Width(std::string text);
+      int Get_Text_Height(std::string text);
+      sSignal Read_Key();
+      sSignal Read_Signal();
+      void Play_Music(std::string name);
+      void Silence();
+      void Refresh();
+      cArray<std::string> Get_File_List(std::string folder);
+      std::string Get_Current_Folder();
+      std::string Get_File_Extension(std::string file);
+      std::string Get_File_Title(std::string file);
+      void Add_Image(std::string name, int width, int height);
+      void Add_Key(int code);
+      void Add_Signal(int button, int x, int y);
+      void Reset_Counts();
+      void Fill(int x, int y, int width, int height, unsigned int color);
+
+  };
+
+  class cLevel_Editor {
+
+    public:
+      cLevel level;
+      int sel_layer;
+      bool pick_all_layers;
+      int sel_sprite;
+      int background_image;
+      cHash<std::string, tObject> sprite_palette;
+      std::string sel_sprite_type;
+      int sel_sprite_icon;
+      std::string sel_sprite_layer;
+      std::string layer_label;
+      int layer_label_width;
+      int layer_label_height;
+      std::string pointer_label;
+      cValue pointer_level;
+      std::string selection_label;
+      int selection_label_count;
+      std::string problem_label;
+      int problem_label_count;
+      int sel_level;
+      std::string level_name;
+      int scroll_x;
+      int scroll_y;
+      int screen_width;
+      int screen_height;
+      cInput_Queue input;
+      cInput_Source* input_source;
+      int held_key;
+      double repeat_time;
+      double repeat_delay;
+      double repeat_interval;
+      int autosave_interval;
+      int autosave_timer;
+      cAutosaver autosaver;
+      cLevel_Journal journal;
+      cUndo_History history;
+      cLevel_Stream stream;
+      bool streaming;
+      int stream_radius;
+      cLevel_Index level_index;
+      cIO_Control* io;
+      cTiled_IO* tiled_io;
+      cArray<std::string> backgrounds;
+      cArray<std::string> music_tracks;
+      cArray<sDebug_Entry> debug_log;
+      std::vector<int> visible_sprites;
+      std::vector<cLayer_Cache> layer_caches;
+      cProfiler profiler;
+      bool show_profile;
+      cLevel_Baker baker;
+      cLevel_Linter linter;
+      bool show_lint;
+      int lint_generation;
+      std::vector<int> selection;
+      int select_mode;
+      sPoint select_anchor;
+      std::vector<sPoint> lasso;
+      sPoint mouse_coords;
+
+      cLevel_Editor(std::string name, cConfig& config, cIO_Control* io, cArray<std::string> backgrounds, cArray<std::string> music_tracks);
+      ~cLevel_Editor();
+      void Load_Sprite_Palette(std::string name);
+      void Load_Level(std::string name);
+      void Save_Level(std::string name);
+      void Autosave();
+      void Compact_Level();
+      void Poll_Input();
+      void Process_Input();
+      void Process_Key(sSignal key);
+      void Process_Mouse(sSignal mouse);
+      void Select_Layer(int direction);
+      int Select_Sprite(sPoint coords);
+      int Create_Sprite(sPoint coords);
+      void Select_Sprite_Type(int direction);
+      void Select_Background(int direction);
+      void Select_Music_Track(int direction);
+      void Render();
+      void Render_Profile();
+      int Render_Lint(sRectangle view);
+      void Process();
+      void Print_Object(tObject& object);
+      void Debug(std::string text, int x, int y);
+      cArray<std::string>& Get_Level_List();
+      int Find_Selected_Level_Index(std::string name);
+      void Set_Layer(int layer);
+      void Set_Sprite_Type(std::string sprite_type);
+      void Set_Background(std::string background);
+      void Process_Selection_Keys(sSignal key);
+      void Select_Box(sRectangle area);
+      void Select_Lasso();
+      bool Is_Point_In_Lasso(sPoint point);
+      void Clear_Selection();
+      void Drop_Sprites(std::vector<std::vector<int> >& dropped);
+      sPoint Get_Level_Coords(sPoint coords);
+      void Undo(bool undo);
+      void Bake_Level();
+  
+  };
+
 }
\ No newline at end of file